@@ -0,0 +1,34 @@
+#include <benchmark/benchmark.h>
+
+#include <string>
+
+#include "op_args.h"
+
+namespace bench
+{
+
+/// One benchmark per operator, the arguments are the number of operands and the operand size in bytes
+int RegisterOpBenchmarks()
+{
+    for (auto const& op_case : OpCases()) {
+        auto b = benchmark::RegisterBenchmark(
+            (std::string("BM_Op_") + op_case.name).c_str(), [&op_case](benchmark::State& state) {
+                auto args
+                    = op_case.make_args(static_cast<int>(state.range(0)), static_cast<int>(state.range(1)));
+                for (auto _ : state) {
+                    benchmark::DoNotOptimize(op_case.op(args));
+                }
+            });
+        b->ArgNames({ "args", "size" });
+        for (int num_args : op_case.arg_counts) {
+            for (int size : op_case.sizes) {
+                b->Args({ num_args, size });
+            }
+        }
+    }
+    return 0;
+}
+
+int const OP_BENCHMARKS = RegisterOpBenchmarks();
+
+} // namespace bench
@@ -0,0 +1,128 @@
+#include <benchmark/benchmark.h>
+
+#include "clvm/clvm_utils.h"
+#include "clvm/condition_opcode.h"
+#include "clvm/key.h"
+#include "clvm/puzzle.h"
+#include "clvm/sexp_prog.h"
+
+namespace bench
+{
+
+char const* SZ_PUBLIC_KEY = "aea444ca6508d64855735a89491679daec4303e104d62b83d0e4d4c5280edd2b2480740031f68b374e4cd5d4aa6544e7";
+
+chia::PublicKey GetPublicKey()
+{
+    return chia::utils::bytes_cast<chia::wallet::Key::PUB_KEY_LEN>(chia::utils::BytesFromHex(SZ_PUBLIC_KEY));
+}
+
+/// A list of `count` CREATE_COIN conditions
+chia::CLVMObjectPtr MakeConditions(int count)
+{
+    chia::ListBuilder conditions;
+    for (int i = 0; i < count; ++i) {
+        chia::Bytes32 puzzle_hash;
+        puzzle_hash.fill(static_cast<uint8_t>(i));
+        conditions.Add(chia::puzzle::make_create_coin_condition(puzzle_hash, 1000 + i, {}));
+    }
+    return conditions.GetRoot();
+}
+
+chia::Program GetProgram(int size)
+{
+    if (size == 0) {
+        return chia::puzzle::PredefinedPrograms::GetInstance()[chia::puzzle::PredefinedPrograms::Names::MOD];
+    }
+    return chia::Program(MakeConditions(size));
+}
+
+} // namespace bench
+
+/// The argument is the number of conditions in the program, 0 is the standard MOD puzzle
+static void BM_Program_ImportFromBytes(benchmark::State& state)
+{
+    auto bytes = bench::GetProgram(static_cast<int>(state.range(0))).Serialize();
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(chia::Program::ImportFromBytes(bytes));
+    }
+    state.SetBytesProcessed(state.iterations() * bytes.size());
+}
+BENCHMARK(BM_Program_ImportFromBytes)->Arg(0)->Arg(16)->Arg(256)->Arg(4096);
+
+static void BM_Program_Serialize(benchmark::State& state)
+{
+    auto prog = bench::GetProgram(static_cast<int>(state.range(0)));
+    std::size_t size { 0 };
+    for (auto _ : state) {
+        auto bytes = prog.Serialize();
+        size = bytes.size();
+        benchmark::DoNotOptimize(bytes);
+    }
+    state.SetBytesProcessed(state.iterations() * size);
+}
+BENCHMARK(BM_Program_Serialize)->Arg(0)->Arg(16)->Arg(256)->Arg(4096);
+
+static void BM_Program_GetTreeHash(benchmark::State& state)
+{
+    auto prog = bench::GetProgram(static_cast<int>(state.range(0)));
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(prog.GetTreeHash());
+    }
+}
+BENCHMARK(BM_Program_GetTreeHash)->Arg(0)->Arg(16)->Arg(256)->Arg(4096);
+
+/// Run the standard puzzle with a delegated puzzle which creates `range(0)` coins
+static void BM_Program_RunStandardPuzzle(benchmark::State& state)
+{
+    auto puzzle = chia::puzzle::puzzle_for_synthetic_public_key(bench::GetPublicKey());
+    auto solution = chia::puzzle::solution_for_conditions(bench::MakeConditions(static_cast<int>(state.range(0))));
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(puzzle.Run(solution.GetSExp()));
+    }
+}
+BENCHMARK(BM_Program_RunStandardPuzzle)->Arg(1)->Arg(16)->Arg(256);
+
+static void BM_Program_Curry(benchmark::State& state)
+{
+    auto mod = chia::puzzle::PredefinedPrograms::GetInstance()[chia::puzzle::PredefinedPrograms::Names::MOD];
+    auto public_key = chia::ToSExp(bench::GetPublicKey());
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(mod.Curry(public_key));
+    }
+}
+BENCHMARK(BM_Program_Curry);
+
+static void BM_Utils_BytesToHex(benchmark::State& state)
+{
+    chia::Bytes bytes(state.range(0), 0x5a);
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(chia::utils::BytesToHex(bytes));
+    }
+    state.SetBytesProcessed(state.iterations() * bytes.size());
+}
+BENCHMARK(BM_Utils_BytesToHex)->Arg(32)->Arg(1 << 20);
+
+static void BM_Utils_BytesFromHex(benchmark::State& state)
+{
+    auto hex = chia::utils::BytesToHex(chia::Bytes(state.range(0), 0x5a));
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(chia::utils::BytesFromHex(hex));
+    }
+    state.SetBytesProcessed(state.iterations() * hex.size() / 2);
+}
+BENCHMARK(BM_Utils_BytesFromHex)->Arg(32)->Arg(1 << 20);
+
+/// The puzzle hash check of an incoming spend, `range(1)` is 1 to parse the program and hash the nodes
+static void BM_Program_TreeHashFromBytes(benchmark::State& state)
+{
+    auto bytes = bench::GetProgram(static_cast<int>(state.range(0))).Serialize();
+    for (auto _ : state) {
+        if (state.range(1)) {
+            benchmark::DoNotOptimize(chia::Program::ImportFromBytes(bytes).GetTreeHash());
+        } else {
+            benchmark::DoNotOptimize(chia::TreeHashFromBytes(bytes.data(), bytes.size()));
+        }
+    }
+    state.SetBytesProcessed(state.iterations() * bytes.size());
+}
+BENCHMARK(BM_Program_TreeHashFromBytes)->ArgNames({ "conditions", "nodes" })->ArgsProduct({ { 0, 256 }, { 0, 1 } });
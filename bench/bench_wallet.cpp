@@ -0,0 +1,308 @@
+#include <benchmark/benchmark.h>
+
+#include <filesystem>
+#include <map>
+#include <vector>
+
+#include "clvm/bech32.h"
+#include "clvm/clvm_utils.h"
+#include "clvm/coin.h"
+#include "clvm/coin_store.h"
+#include "clvm/condition_opcode.h"
+#include "clvm/key.h"
+#include "clvm/mempool.h"
+
+namespace bench
+{
+
+chia::Bytes32 MakeHash(int n)
+{
+    chia::Bytes32 hash;
+    for (std::size_t i = 0; i < hash.size(); ++i) {
+        hash[i] = static_cast<uint8_t>(n * 131 + i * 17);
+    }
+    return hash;
+}
+
+/// A hash which is different for every `n`
+chia::Bytes32 MakeUniqueHash(uint64_t n)
+{
+    chia::Bytes32 hash = MakeHash(0);
+    memcpy(hash.data(), &n, sizeof(n));
+    return hash;
+}
+
+std::vector<chia::Coin> MakeCoins(int count)
+{
+    std::vector<chia::Coin> coins;
+    for (int i = 0; i < count; ++i) {
+        coins.emplace_back(MakeHash(i), MakeHash(i + 1), 1000000 + i);
+    }
+    return coins;
+}
+
+/// Coin spends with the puzzle `1`, each solution asks for one AGG_SIG_ME signature from its own key
+struct SpendsToSign {
+    explicit SpendsToSign(int count)
+    {
+        chia::Bytes32 seed;
+        seed.fill(1);
+        chia::wallet::Key master(chia::utils::bytes_cast<32>(seed));
+        auto coins = MakeCoins(count);
+        for (int i = 0; i < count; ++i) {
+            auto key = master.GetWalletKey(i);
+            keys[key.GetPublicKey()] = key.GetPrivateKey();
+            auto solution = chia::ToSExpList(chia::ToSExpList(
+                chia::ConditionOpcode::ToBytes(chia::ConditionOpcode::AGG_SIG_ME), key.GetPublicKey(), "message"));
+            spends.emplace_back(coins[i], chia::Program(chia::ToSExp(1)), chia::Program(solution));
+        }
+    }
+
+    std::map<chia::PublicKey, chia::PrivateKey> keys;
+    std::vector<chia::CoinSpend> spends;
+};
+
+} // namespace bench
+
+static void BM_Coin_GetName(benchmark::State& state)
+{
+    chia::Coin coin(bench::MakeHash(1), bench::MakeHash(2), 1750000000000);
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(coin.GetName());
+    }
+}
+BENCHMARK(BM_Coin_GetName);
+
+static void BM_Coin_HashCoinList(benchmark::State& state)
+{
+    auto coins = bench::MakeCoins(static_cast<int>(state.range(0)));
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(chia::Coin::HashCoinList(coins));
+    }
+    state.SetItemsProcessed(state.iterations() * coins.size());
+}
+BENCHMARK(BM_Coin_HashCoinList)->Arg(1)->Arg(64)->Arg(1024);
+
+static void BM_SignCoinSpends(benchmark::State& state)
+{
+    bench::SpendsToSign to_sign(static_cast<int>(state.range(0)));
+    auto additional_data = chia::utils::BytesFromHex("ccd5bb71183532bff220ba46c268991a3ff07eb358e8255a65c30a2dce0e5fbb");
+    auto sk_for_pk = [&to_sign](chia::PublicKey const& public_key) -> std::optional<chia::PrivateKey> {
+        auto i = to_sign.keys.find(public_key);
+        if (i == std::end(to_sign.keys)) {
+            return {};
+        }
+        return i->second;
+    };
+    auto sk_for_ph = [](chia::Bytes32 const&) -> std::optional<chia::PrivateKey> { return {}; };
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(
+            chia::puzzle::sign_coin_spends(to_sign.spends, sk_for_pk, sk_for_ph, additional_data, 1000000000));
+    }
+    state.SetItemsProcessed(state.iterations() * to_sign.spends.size());
+}
+BENCHMARK(BM_SignCoinSpends)->Arg(1)->Arg(16)->Unit(benchmark::kMillisecond);
+
+/// Bundles of 64 spends with the signing solutions, the network format is parsed and the name is hashed from it
+static void BM_SpendBundle_FromBytes(benchmark::State& state)
+{
+    bench::SpendsToSign to_sign(64);
+    auto bytes = chia::SpendBundle(to_sign.spends, chia::Signature()).Serialize();
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(chia::SpendBundle::FromBytes(bytes.data(), bytes.size()).Name());
+    }
+    state.SetBytesProcessed(state.iterations() * bytes.size());
+}
+BENCHMARK(BM_SpendBundle_FromBytes);
+
+static void BM_SpendBundle_Serialize(benchmark::State& state)
+{
+    bench::SpendsToSign to_sign(64);
+    chia::SpendBundle bundle(to_sign.spends, chia::Signature());
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(bundle.Serialize());
+    }
+}
+BENCHMARK(BM_SpendBundle_Serialize);
+
+static void BM_Bech32_EncodePuzzleHash(benchmark::State& state)
+{
+    auto puzzle_hash = bench::MakeHash(7);
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(chia::bech32::EncodePuzzleHash(puzzle_hash, "xch"));
+    }
+}
+BENCHMARK(BM_Bech32_EncodePuzzleHash);
+
+static void BM_Bech32_DecodePuzzleHash(benchmark::State& state)
+{
+    auto address = chia::bech32::EncodePuzzleHash(bench::MakeHash(7), "xch");
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(chia::bech32::DecodePuzzleHash(address));
+    }
+}
+BENCHMARK(BM_Bech32_DecodePuzzleHash);
+
+static void BM_Bech32_EncodeMany(benchmark::State& state)
+{
+    std::vector<chia::Bytes32> puzzle_hashes;
+    for (int i = 0; i < state.range(0); ++i) {
+        puzzle_hashes.push_back(bench::MakeHash(i));
+    }
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(chia::bech32::EncodeMany(puzzle_hashes, "xch"));
+    }
+    state.SetItemsProcessed(state.iterations() * puzzle_hashes.size());
+}
+BENCHMARK(BM_Bech32_EncodeMany)->Arg(1024);
+
+/// Admission of bundles which spend one coin each and create one coin, the signature isn't verified so the number is
+/// the cost of the validation and the conflict index, every thread adds its own coins to the same mempool. The target
+/// of 10k adds per second is for this path, see `BM_Mempool_AddVerified` for the cost with the BLS verification
+static void BM_Mempool_Add(benchmark::State& state)
+{
+    static std::unique_ptr<chia::Mempool> mempool;
+    if (state.thread_index() == 0) {
+        chia::MempoolOptions options;
+        options.verify_signature = false;
+        mempool.reset(new chia::Mempool(options));
+    }
+    auto condition = chia::ToSExpList(chia::ConditionOpcode::ToBytes(chia::ConditionOpcode::CREATE_COIN),
+        chia::utils::HashToBytes(bench::MakeHash(0)), chia::Int(1000));
+    chia::Program puzzle(chia::ToSExpPair(chia::utils::ByteToBytes(1), chia::ToSExpList(condition)));
+    auto puzzle_hash = puzzle.GetTreeHash();
+    chia::Program solution(chia::MakeNull());
+    uint64_t n { 0 };
+    for (auto _ : state) {
+        chia::Coin coin(bench::MakeUniqueHash((static_cast<uint64_t>(state.thread_index()) << 32) + n++), puzzle_hash, 1100);
+        auto result = mempool->Add(chia::SpendBundle({ chia::CoinSpend(coin, puzzle, solution) }, chia::Signature()));
+        if (result.status != chia::Mempool::Status::ADDED) {
+            state.SkipWithError(result.error.c_str());
+            break;
+        }
+    }
+    state.SetItemsProcessed(state.iterations());
+    if (state.thread_index() == 0) {
+        state.counters["mempool_size"] = static_cast<double>(mempool->GetSize());
+    }
+}
+BENCHMARK(BM_Mempool_Add)->Threads(1)->Threads(4)->UseRealTime();
+
+/// Admission of bundles which are signed for one AGG_SIG_ME each, the pairings of the verification take most of the
+/// time. The bundles are signed before the timing, the mempool is replaced without timing once all of them are added
+static void BM_Mempool_AddVerified(benchmark::State& state)
+{
+    auto additional_data = chia::utils::BytesFromHex("ccd5bb71183532bff220ba46c268991a3ff07eb358e8255a65c30a2dce0e5fbb");
+    bench::SpendsToSign to_sign(static_cast<int>(state.range(0)));
+    auto sk_for_pk = [&to_sign](chia::PublicKey const& public_key) -> std::optional<chia::PrivateKey> {
+        auto i = to_sign.keys.find(public_key);
+        if (i == std::end(to_sign.keys)) {
+            return {};
+        }
+        return i->second;
+    };
+    auto sk_for_ph = [](chia::Bytes32 const&) -> std::optional<chia::PrivateKey> { return {}; };
+    std::vector<chia::SpendBundle> bundles;
+    for (auto const& spend : to_sign.spends) {
+        bundles.push_back(chia::puzzle::sign_coin_spends({ spend }, sk_for_pk, sk_for_ph, additional_data, 1000000000));
+    }
+    chia::MempoolOptions options;
+    options.additional_data = additional_data;
+    std::unique_ptr<chia::Mempool> mempool;
+    std::size_t n { bundles.size() };
+    for (auto _ : state) {
+        if (n == bundles.size()) {
+            state.PauseTiming();
+            mempool.reset(new chia::Mempool(options));
+            n = 0;
+            state.ResumeTiming();
+        }
+        auto result = mempool->Add(bundles[n++]);
+        if (result.status != chia::Mempool::Status::ADDED) {
+            state.SkipWithError(result.error.c_str());
+            break;
+        }
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_Mempool_AddVerified)->Arg(256);
+
+static void BM_Mempool_CreateBlockCandidate(benchmark::State& state)
+{
+    chia::MempoolOptions options;
+    options.verify_signature = false;
+    chia::Mempool mempool(options);
+    for (int i = 0; i < state.range(0); ++i) {
+        auto condition = chia::ToSExpList(chia::ConditionOpcode::ToBytes(chia::ConditionOpcode::CREATE_COIN),
+            chia::utils::HashToBytes(bench::MakeHash(0)), chia::Int(1000 - i % 100));
+        chia::Program puzzle(chia::ToSExpPair(chia::utils::ByteToBytes(1), chia::ToSExpList(condition)));
+        chia::Coin coin(bench::MakeUniqueHash(i), puzzle.GetTreeHash(), 1100);
+        mempool.Add(chia::SpendBundle({ chia::CoinSpend(coin, puzzle, chia::Program(chia::MakeNull())) }, chia::Signature()));
+    }
+    chia::Cost max_cost = mempool.GetTotalCost() / 2;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(mempool.CreateBlockCandidate(max_cost));
+    }
+}
+BENCHMARK(BM_Mempool_CreateBlockCandidate)->Arg(10000);
+
+static void BM_CoinStore_ApplyBlockAndRollback(benchmark::State& state)
+{
+    chia::CoinStore store(state.range(0));
+    std::vector<chia::Coin> coins;
+    coins.reserve(state.range(0));
+    for (int i = 0; i < state.range(0); ++i) {
+        coins.emplace_back(bench::MakeUniqueHash(i), bench::MakeHash(i % 16), 1000);
+    }
+    store.ApplyBlock(1, coins, {});
+    std::vector<chia::Coin> additions;
+    std::vector<chia::Bytes32> removals;
+    for (int i = 0; i < 1000; ++i) {
+        additions.emplace_back(bench::MakeUniqueHash(state.range(0) + i), bench::MakeHash(i % 16), 1000);
+        removals.push_back(coins[i].GetName());
+    }
+    for (auto _ : state) {
+        store.ApplyBlock(2, additions, removals);
+        store.Rollback(1);
+    }
+    state.counters["bytes_per_coin"] = static_cast<double>(store.GetMemoryUsage()) / store.GetSize();
+}
+BENCHMARK(BM_CoinStore_ApplyBlockAndRollback)->Arg(1 << 20)->Unit(benchmark::kMillisecond);
+
+static void BM_CoinStore_SnapshotAndWrite(benchmark::State& state)
+{
+    chia::CoinStore store(state.range(0));
+    std::vector<chia::Coin> coins;
+    coins.reserve(state.range(0));
+    for (int i = 0; i < state.range(0); ++i) {
+        coins.emplace_back(bench::MakeUniqueHash(i), bench::MakeHash(i % 16), 1000);
+    }
+    store.ApplyBlock(1, coins, {});
+    for (auto _ : state) {
+        auto snapshot = store.Snapshot();
+        snapshot.ApplyBlock(2, {}, { coins[0].GetName() });
+    }
+}
+BENCHMARK(BM_CoinStore_SnapshotAndWrite)->Arg(1 << 20);
+
+static void BM_CoinStore_Open(benchmark::State& state)
+{
+    std::string dir_path = (std::filesystem::temp_directory_path() / "clvm_bench_coin_store").string();
+    std::filesystem::remove_all(dir_path);
+    std::vector<chia::Coin> coins;
+    coins.reserve(state.range(0));
+    for (int i = 0; i < state.range(0); ++i) {
+        coins.emplace_back(bench::MakeUniqueHash(i), bench::MakeHash(i % 16), 1000);
+    }
+    {
+        auto store = chia::CoinStore::Open(dir_path);
+        store.ApplyBlock(1, coins, {});
+        store.Checkpoint();
+    }
+    for (auto _ : state) {
+        auto store = chia::CoinStore::Open(dir_path);
+        benchmark::DoNotOptimize(store.Get(coins[0].GetName()));
+    }
+    std::filesystem::remove_all(dir_path);
+}
+BENCHMARK(BM_CoinStore_Open)->Arg(1 << 20)->Unit(benchmark::kMillisecond);
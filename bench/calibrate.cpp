@@ -0,0 +1,211 @@
+/*
+ * clvm_calibrate, measure the time of each operator against the cost it charges
+ *
+ * Every operator of more_opts is swept across its argument counts and operand sizes, the time of each sample is fitted
+ * to the cost with a least squares line through the origin, which gives the nanoseconds per cost unit of the operator.
+ * An operator is flagged when its worst sample is more than `--threshold` times the median fit of all operators,
+ * those are the operators which are cheap to call and expensive to run.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "op_args.h"
+
+namespace calibrate
+{
+
+using Clock = std::chrono::steady_clock;
+
+struct Options {
+    double min_time_ms { 20 };
+    double threshold { 4 };
+    std::string filter;
+    std::string json_path;
+    bool fail_on_outlier { false };
+};
+
+struct Sample {
+    int num_args;
+    int size;
+    chia::Cost cost;
+    double ns;
+};
+
+struct OpFit {
+    std::string name;
+    std::vector<Sample> samples;
+    double ns_per_cost { 0 };
+    double worst_ns_per_cost { 0 };
+    bool outlier { false };
+};
+
+/// Run the operator until `min_time_ms` is spent, the time of one call is returned in nanoseconds
+double TimeOp(bench::OpPtr op, chia::CLVMObjectPtr args, double min_time_ms)
+{
+    double const min_time_ns = min_time_ms * 1000000;
+    long iterations { 1 };
+    while (true) {
+        auto start = Clock::now();
+        for (long i = 0; i < iterations; ++i) {
+            op(args);
+        }
+        double elapsed = std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+        if (elapsed >= min_time_ns) {
+            return elapsed / iterations;
+        }
+        // Guess the number of iterations to reach the time, grow at most 10 times per round
+        double scale = elapsed > 0 ? min_time_ns * 1.2 / elapsed : 10;
+        iterations = static_cast<long>(iterations * std::min(std::max(scale, 2.0), 10.0));
+    }
+}
+
+OpFit Calibrate(bench::OpCase const& op_case, Options const& options)
+{
+    OpFit fit;
+    fit.name = op_case.name;
+    double sum_ct { 0 }, sum_cc { 0 };
+    for (int num_args : op_case.arg_counts) {
+        for (int size : op_case.sizes) {
+            auto args = op_case.make_args(num_args, size);
+            auto [cost, r] = op_case.op(args);
+            double ns = TimeOp(op_case.op, args, options.min_time_ms);
+            fit.samples.push_back({ num_args, size, cost, ns });
+            sum_ct += static_cast<double>(cost) * ns;
+            sum_cc += static_cast<double>(cost) * cost;
+            if (cost > 0) {
+                fit.worst_ns_per_cost = std::max(fit.worst_ns_per_cost, ns / cost);
+            }
+        }
+    }
+    fit.ns_per_cost = sum_cc > 0 ? sum_ct / sum_cc : 0;
+    return fit;
+}
+
+double Median(std::vector<double> values)
+{
+    if (values.empty()) {
+        return 0;
+    }
+    std::sort(std::begin(values), std::end(values));
+    return values[values.size() / 2];
+}
+
+void PrintFits(std::vector<OpFit> const& fits, double median, std::ostream& out)
+{
+    char line[160];
+    snprintf(line, sizeof(line), "%-16s %6s %6s %12s %14s %12s", "operator", "args", "size", "cost", "ns", "ns/cost");
+    out << line << std::endl;
+    for (auto const& fit : fits) {
+        for (auto const& sample : fit.samples) {
+            snprintf(line, sizeof(line), "%-16s %6d %6d %12llu %14.1f %12.4f", fit.name.c_str(), sample.num_args,
+                sample.size, static_cast<unsigned long long>(sample.cost), sample.ns,
+                sample.cost > 0 ? sample.ns / sample.cost : 0);
+            out << line << std::endl;
+        }
+    }
+    out << std::endl;
+    snprintf(line, sizeof(line), "%-16s %12s %12s %10s", "operator", "ns/cost", "worst", "x median");
+    out << line << std::endl;
+    for (auto const& fit : fits) {
+        snprintf(line, sizeof(line), "%-16s %12.4f %12.4f %10.2f%s", fit.name.c_str(), fit.ns_per_cost,
+            fit.worst_ns_per_cost, median > 0 ? fit.worst_ns_per_cost / median : 0, fit.outlier ? "  OUTLIER" : "");
+        out << line << std::endl;
+    }
+    out << std::endl << "median ns/cost: " << median << std::endl;
+}
+
+void WriteJson(std::vector<OpFit> const& fits, double median, std::string const& path)
+{
+    std::ofstream out(path);
+    if (!out.is_open()) {
+        throw std::runtime_error("cannot open file: " + path + " to write");
+    }
+    out << "{" << std::endl << "  \"median_ns_per_cost\": " << median << "," << std::endl;
+    out << "  \"operators\": [" << std::endl;
+    for (std::size_t i = 0; i < fits.size(); ++i) {
+        auto const& fit = fits[i];
+        out << "    { \"name\": \"" << fit.name << "\", \"ns_per_cost\": " << fit.ns_per_cost
+            << ", \"worst_ns_per_cost\": " << fit.worst_ns_per_cost
+            << ", \"outlier\": " << (fit.outlier ? "true" : "false") << ", \"samples\": [";
+        for (std::size_t j = 0; j < fit.samples.size(); ++j) {
+            auto const& sample = fit.samples[j];
+            out << (j ? ", " : "") << "{ \"args\": " << sample.num_args << ", \"size\": " << sample.size
+                << ", \"cost\": " << sample.cost << ", \"ns\": " << sample.ns << " }";
+        }
+        out << "] }" << (i + 1 < fits.size() ? "," : "") << std::endl;
+    }
+    out << "  ]" << std::endl << "}" << std::endl;
+}
+
+void PrintUsage()
+{
+    std::cerr << "usage: clvm_calibrate [--filter NAME] [--min-time MS] [--threshold X] [--json FILE] "
+                 "[--fail-on-outlier]"
+              << std::endl;
+}
+
+bool ParseOptions(int argc, char const* argv[], Options& options)
+{
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        bool has_value = i + 1 < argc;
+        if (arg == "--filter" && has_value) {
+            options.filter = argv[++i];
+        } else if (arg == "--min-time" && has_value) {
+            options.min_time_ms = std::stod(argv[++i]);
+        } else if (arg == "--threshold" && has_value) {
+            options.threshold = std::stod(argv[++i]);
+        } else if (arg == "--json" && has_value) {
+            options.json_path = argv[++i];
+        } else if (arg == "--fail-on-outlier") {
+            options.fail_on_outlier = true;
+        } else {
+            return false;
+        }
+    }
+    return options.min_time_ms > 0 && options.threshold > 1;
+}
+
+} // namespace calibrate
+
+int main(int argc, char const* argv[])
+{
+    calibrate::Options options;
+    if (!calibrate::ParseOptions(argc, argv, options)) {
+        calibrate::PrintUsage();
+        return 1;
+    }
+    std::vector<calibrate::OpFit> fits;
+    try {
+        for (auto const& op_case : bench::OpCases()) {
+            if (!options.filter.empty() && std::string(op_case.name).find(options.filter) == std::string::npos) {
+                continue;
+            }
+            fits.push_back(calibrate::Calibrate(op_case, options));
+        }
+    } catch (std::exception const& e) {
+        std::cerr << "error: " << e.what() << std::endl;
+        return 1;
+    }
+    std::vector<double> ratios;
+    for (auto const& fit : fits) {
+        ratios.push_back(fit.ns_per_cost);
+    }
+    double median = calibrate::Median(ratios);
+    bool has_outlier { false };
+    for (auto& fit : fits) {
+        fit.outlier = fit.worst_ns_per_cost > median * options.threshold;
+        has_outlier = has_outlier || fit.outlier;
+    }
+    calibrate::PrintFits(fits, median, std::cout);
+    if (!options.json_path.empty()) {
+        calibrate::WriteJson(fits, median, options.json_path);
+    }
+    return options.fail_on_outlier && has_outlier ? 2 : 0;
+}
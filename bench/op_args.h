@@ -0,0 +1,119 @@
+#ifndef CHIA_BENCH_OP_ARGS_H
+#define CHIA_BENCH_OP_ARGS_H
+
+#include <functional>
+#include <vector>
+
+#include "clvm/clvm_utils.h"
+#include "clvm/int.h"
+#include "clvm/key.h"
+#include "clvm/more_opts.h"
+#include "clvm/sexp_prog.h"
+
+namespace bench
+{
+
+using OpPtr = chia::OpResult (*)(chia::CLVMObjectPtr);
+
+/// Make the arguments of an operator from the number of arguments and the size of each operand in bytes
+using MakeArgsFunc = std::function<chia::CLVMObjectPtr(int num_args, int size)>;
+
+/// Bytes of the size with no leading zero and the top bit clear, so they are a positive int of exactly that size
+inline chia::Bytes MakeBytes(int size, uint8_t seed = 0x5a)
+{
+    chia::Bytes bytes(size);
+    for (int i = 0; i < size; ++i) {
+        bytes[i] = static_cast<uint8_t>(seed + i * 31);
+    }
+    bytes[0] = 0x40 | (seed & 0x3f);
+    return bytes;
+}
+
+inline chia::CLVMObjectPtr MakeInt(int size, uint8_t seed = 0x5a)
+{
+    return chia::ToSExp(chia::Int(MakeBytes(size, seed)));
+}
+
+inline chia::CLVMObjectPtr MakeAtom(int size, uint8_t seed = 0x5a) { return chia::ToSExp(MakeBytes(size, seed)); }
+
+inline chia::CLVMObjectPtr Ints(int num_args, int size)
+{
+    chia::ListBuilder args;
+    for (int i = 0; i < num_args; ++i) {
+        args.Add(MakeInt(size, static_cast<uint8_t>(0x5a + i * 0x29)));
+    }
+    return args.GetRoot();
+}
+
+inline chia::CLVMObjectPtr Atoms(int num_args, int size)
+{
+    chia::ListBuilder args;
+    for (int i = 0; i < num_args; ++i) {
+        args.Add(MakeAtom(size, static_cast<uint8_t>(0x5a + i * 0x29)));
+    }
+    return args.GetRoot();
+}
+
+inline chia::CLVMObjectPtr IntAndShift(int, int size) { return chia::ToSExpList(MakeInt(size), chia::ToSExp(chia::Int(17))); }
+
+inline chia::CLVMObjectPtr Substr(int, int size)
+{
+    return chia::ToSExpList(MakeAtom(size), chia::ToSExp(chia::Int(size / 4)), chia::ToSExp(chia::Int(size / 2)));
+}
+
+/// `num_args` points of G1, the size is ignored
+inline chia::CLVMObjectPtr Points(int num_args, int)
+{
+    chia::ListBuilder points;
+    for (int i = 0; i < num_args; ++i) {
+        chia::Bytes32 seed;
+        seed.fill(static_cast<uint8_t>(i + 1));
+        points.Add(chia::ToSExp(chia::wallet::Key(chia::utils::bytes_cast<32>(seed)).GetPublicKey()));
+    }
+    return points.GetRoot();
+}
+
+struct OpCase {
+    char const* name;
+    OpPtr op;
+    MakeArgsFunc make_args;
+    std::vector<int> arg_counts;
+    std::vector<int> sizes;
+};
+
+/// Every operator of more_opts with the argument counts and operand sizes to sweep
+inline std::vector<OpCase> const& OpCases()
+{
+    static std::vector<int> const SIZES = { 1, 32, 256, 1024 };
+    static std::vector<int> const VAR_ARGS = { 1, 2, 4, 8 };
+    static std::vector<OpCase> const cases = {
+        { "sha256", chia::op_sha256, Atoms, VAR_ARGS, SIZES },
+        { "add", chia::op_add, Ints, VAR_ARGS, SIZES },
+        { "subtract", chia::op_subtract, Ints, VAR_ARGS, SIZES },
+        { "multiply", chia::op_multiply, Ints, { 2, 4 }, SIZES },
+        { "divmod", chia::op_divmod, Ints, { 2 }, SIZES },
+        { "div", chia::op_div, Ints, { 2 }, SIZES },
+        { "gr", chia::op_gr, Ints, { 2 }, SIZES },
+        { "gr_bytes", chia::op_gr_bytes, Atoms, { 2 }, SIZES },
+        { "pubkey_for_exp", chia::op_pubkey_for_exp, Ints, { 1 }, { 1, 32 } },
+        { "point_add", chia::op_point_add, Points, { 1, 2, 8, 32 }, { 48 } },
+        { "strlen", chia::op_strlen, Atoms, { 1 }, SIZES },
+        { "substr", chia::op_substr, Substr, { 3 }, SIZES },
+        { "concat", chia::op_concat, Atoms, VAR_ARGS, SIZES },
+        { "ash", chia::op_ash, IntAndShift, { 2 }, SIZES },
+        { "lsh", chia::op_lsh, IntAndShift, { 2 }, SIZES },
+        { "logand", chia::op_logand, Ints, VAR_ARGS, SIZES },
+        { "logior", chia::op_logior, Ints, VAR_ARGS, SIZES },
+        { "logxor", chia::op_logxor, Ints, VAR_ARGS, SIZES },
+        { "lognot", chia::op_lognot, Ints, { 1 }, SIZES },
+        { "not", chia::op_not, Atoms, { 1 }, SIZES },
+        { "any", chia::op_any, Atoms, VAR_ARGS, SIZES },
+        { "all", chia::op_all, Atoms, VAR_ARGS, SIZES },
+        { "softfork", chia::op_softfork, Ints, { 1 }, { 1, 4 } },
+    };
+    return cases;
+}
+
+} // namespace bench
+
+#endif
@@ -0,0 +1,407 @@
+/*
+ * clvm_replay, replay a corpus of captured block generators and coin spends
+ *
+ * The corpus is a directory, every regular file in it is one record and the kind of the record is taken from its name:
+ *
+ *   *.gen.hex, *.gen.bin       a serialized block generator which may have back references, the generator is run
+ *                              without arguments and the first item of its result is the list of spends
+ *                              `((parent puzzle amount solution ...) ...)`
+ *   *.spend.hex, *.spend.bin   a streamable `CoinSpend`: parent coin info (32 bytes), puzzle hash (32 bytes), amount
+ *                              (8 bytes, big endian), the serialized puzzle reveal and the serialized solution
+ *
+ * `.bin` files hold the raw bytes, `.hex` files hold the hex string of them, white spaces and a leading `0x` are
+ * ignored. Files with other names are skipped, the records are replayed in the order of their file names.
+ *
+ * Every spend goes through deserialize, run with condition parsing and the AGG_SIG pair extraction, the time of each
+ * stage is measured per spend.
+ */
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "clvm/clvm_utils.h"
+#include "clvm/coin.h"
+#include "clvm/sexp_prog.h"
+
+namespace replay
+{
+
+using Clock = std::chrono::steady_clock;
+
+char const* SZ_MAINNET_GENESIS_CHALLENGE = "ccd5bb71183532bff220ba46c268991a3ff07eb358e8255a65c30a2dce0e5fbb";
+
+enum class RecordType { GENERATOR, COIN_SPEND };
+
+struct Record {
+    std::string name;
+    RecordType type;
+    chia::Bytes bytes;
+};
+
+/// The time of each stage is in microseconds, the spends of a generator are deserialized by running the generator
+struct SpendResult {
+    bool from_generator { false };
+    double deserialize_us { 0 };
+    double run_us { 0 };
+    double pairs_us { 0 };
+    chia::Cost cost { 0 };
+    std::size_t num_pairs { 0 };
+};
+
+struct Options {
+    std::string corpus_dir;
+    std::string json_path;
+    chia::Bytes additional_data;
+    int repeat { 1 };
+};
+
+bool EndsWith(std::string const& str, std::string const& suffix)
+{
+    return str.size() >= suffix.size() && str.compare(str.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+double MicrosecondsSince(Clock::time_point start)
+{
+    return std::chrono::duration<double, std::micro>(Clock::now() - start).count();
+}
+
+chia::Bytes ReadFile(std::filesystem::path const& path)
+{
+    std::ifstream in(path, std::ios::binary);
+    if (!in.is_open()) {
+        throw std::runtime_error("cannot open file: " + path.string());
+    }
+    return chia::Bytes(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+}
+
+chia::Bytes BytesFromHexFile(std::filesystem::path const& path)
+{
+    auto content = ReadFile(path);
+    std::string hex;
+    hex.reserve(content.size());
+    for (uint8_t ch : content) {
+        if (!std::isspace(ch)) {
+            hex.push_back(static_cast<char>(ch));
+        }
+    }
+    if (hex.size() >= 2 && hex[0] == '0' && (hex[1] == 'x' || hex[1] == 'X')) {
+        hex.erase(0, 2);
+    }
+    return chia::utils::BytesFromHex(hex);
+}
+
+std::vector<Record> LoadCorpus(std::string const& dir)
+{
+    std::vector<std::filesystem::path> paths;
+    for (auto const& entry : std::filesystem::directory_iterator(dir)) {
+        if (entry.is_regular_file()) {
+            paths.push_back(entry.path());
+        }
+    }
+    std::sort(std::begin(paths), std::end(paths));
+    std::vector<Record> records;
+    for (auto const& path : paths) {
+        auto name = path.filename().string();
+        Record record;
+        record.name = name;
+        if (EndsWith(name, ".gen.hex") || EndsWith(name, ".gen.bin")) {
+            record.type = RecordType::GENERATOR;
+        } else if (EndsWith(name, ".spend.hex") || EndsWith(name, ".spend.bin")) {
+            record.type = RecordType::COIN_SPEND;
+        } else {
+            continue;
+        }
+        record.bytes = EndsWith(name, ".hex") ? BytesFromHexFile(path) : ReadFile(path);
+        records.push_back(std::move(record));
+    }
+    return records;
+}
+
+chia::CoinSpend CoinSpendFromBytes(chia::Bytes const& bytes)
+{
+    std::size_t pos { 0 };
+    chia::ReadStreamFunc read = [&bytes, &pos](int size) -> chia::Bytes {
+        if (pos + size > bytes.size()) {
+            throw std::runtime_error("the coin spend record is truncated");
+        }
+        chia::Bytes res(std::begin(bytes) + pos, std::begin(bytes) + pos + size);
+        pos += size;
+        return res;
+    };
+    auto parent_coin_info = read(chia::utils::HASH256_LEN);
+    auto puzzle_hash = read(chia::utils::HASH256_LEN);
+    auto amount = chia::utils::IntFromBEBytes<uint64_t>(read(sizeof(uint64_t)));
+    chia::Program puzzle_reveal(chia::SExpFromStream(read));
+    chia::Program solution(chia::SExpFromStream(read));
+    if (pos != bytes.size()) {
+        throw std::runtime_error("extra bytes after the coin spend record");
+    }
+    return chia::CoinSpend(chia::Coin(parent_coin_info, puzzle_hash, amount), puzzle_reveal, solution);
+}
+
+/// Run the generator and collect the spends from its result, the time and cost of the generator are returned as well
+std::vector<chia::CoinSpend> CoinSpendsFromGenerator(chia::Bytes const& bytes, double* pout_us, chia::Cost* pout_cost)
+{
+    auto start = Clock::now();
+    auto generator = chia::Program::ImportFromBytesWithBackrefs(bytes);
+    auto [cost, result] = generator.Run();
+    std::vector<chia::CoinSpend> coin_spends;
+    chia::ArgsIter i(chia::First(result));
+    while (!i.IsEof()) {
+        chia::ArgsIter spend(i.NextCLVMObj());
+        auto parent_coin_info = spend.Next();
+        chia::Program puzzle_reveal(spend.NextCLVMObj());
+        auto amount = chia::Int(spend.Next()).ToUInt();
+        chia::Program solution(spend.NextCLVMObj());
+        auto puzzle_hash = puzzle_reveal.GetTreeHash();
+        coin_spends.emplace_back(chia::Coin(chia::utils::bytes_cast<chia::utils::HASH256_LEN>(parent_coin_info), puzzle_hash, amount),
+            puzzle_reveal, solution);
+    }
+    *pout_us = MicrosecondsSince(start);
+    *pout_cost = cost;
+    return coin_spends;
+}
+
+SpendResult ReplaySpend(chia::CoinSpend const& coin_spend, Options const& options)
+{
+    SpendResult result;
+    auto start = Clock::now();
+    auto [conditions_dict, cost] = chia::puzzle::conditions_dict_for_solution(
+        *coin_spend.puzzle_reveal, *coin_spend.solution, std::numeric_limits<chia::Cost>::max());
+    result.run_us = MicrosecondsSince(start);
+    result.cost = cost;
+
+    start = Clock::now();
+    auto pairs = chia::puzzle::pkm_pairs_for_conditions_dict(
+        conditions_dict, coin_spend.coin.GetName(), options.additional_data);
+    result.pairs_us = MicrosecondsSince(start);
+    result.num_pairs = pairs.size();
+    return result;
+}
+
+/// The value at `p` (0..1) of the sorted samples
+double Percentile(std::vector<double> samples, double p)
+{
+    if (samples.empty()) {
+        return 0;
+    }
+    std::sort(std::begin(samples), std::end(samples));
+    return samples[static_cast<std::size_t>(p * (samples.size() - 1) + 0.5)];
+}
+
+struct Report {
+    int num_records { 0 };
+    int num_generators { 0 };
+    int num_failures { 0 };
+    std::vector<SpendResult> spends;
+    std::vector<double> generator_us;
+    chia::Cost generator_cost { 0 };
+    double wall_us { 0 };
+
+    std::vector<double> Stage(double SpendResult::*field) const
+    {
+        std::vector<double> res;
+        res.reserve(spends.size());
+        for (auto const& spend : spends) {
+            res.push_back(spend.*field);
+        }
+        return res;
+    }
+
+    std::vector<double> Deserialize() const
+    {
+        std::vector<double> res;
+        for (auto const& spend : spends) {
+            if (!spend.from_generator) {
+                res.push_back(spend.deserialize_us);
+            }
+        }
+        return res;
+    }
+
+    std::vector<double> Total() const
+    {
+        std::vector<double> res;
+        res.reserve(spends.size());
+        for (auto const& spend : spends) {
+            res.push_back(spend.deserialize_us + spend.run_us + spend.pairs_us);
+        }
+        return res;
+    }
+};
+
+Report Replay(std::vector<Record> const& records, Options const& options)
+{
+    Report report;
+    auto start = Clock::now();
+    for (int n = 0; n < options.repeat; ++n) {
+        for (auto const& record : records) {
+            ++report.num_records;
+            try {
+                if (record.type == RecordType::COIN_SPEND) {
+                    auto deserialize_start = Clock::now();
+                    auto coin_spend = CoinSpendFromBytes(record.bytes);
+                    double deserialize_us = MicrosecondsSince(deserialize_start);
+                    auto result = ReplaySpend(coin_spend, options);
+                    result.deserialize_us = deserialize_us;
+                    report.spends.push_back(result);
+                    continue;
+                }
+                ++report.num_generators;
+                double generator_us;
+                chia::Cost generator_cost;
+                auto coin_spends = CoinSpendsFromGenerator(record.bytes, &generator_us, &generator_cost);
+                report.generator_us.push_back(generator_us);
+                report.generator_cost += generator_cost;
+                for (auto const& coin_spend : coin_spends) {
+                    auto result = ReplaySpend(coin_spend, options);
+                    result.from_generator = true;
+                    report.spends.push_back(result);
+                }
+            } catch (std::exception const& e) {
+                if (report.num_failures++ < 10) {
+                    std::cerr << record.name << ": " << e.what() << std::endl;
+                }
+            }
+        }
+    }
+    report.wall_us = MicrosecondsSince(start);
+    return report;
+}
+
+void PrintReport(Report const& report, std::ostream& out)
+{
+    chia::Cost total_cost { 0 };
+    std::size_t total_pairs { 0 };
+    for (auto const& spend : report.spends) {
+        total_cost += spend.cost;
+        total_pairs += spend.num_pairs;
+    }
+    auto run_us = report.Stage(&SpendResult::run_us);
+    double total_run_us { 0 };
+    for (double us : run_us) {
+        total_run_us += us;
+    }
+    double seconds = report.wall_us / 1000000;
+
+    out << "records:         " << report.num_records << " (" << report.num_generators << " generators, "
+        << report.num_failures << " failed)" << std::endl;
+    out << "spends:          " << report.spends.size() << ", agg_sig pairs: " << total_pairs << std::endl;
+    out << "wall time:       " << seconds << " s" << std::endl;
+    out << "throughput:      " << (seconds > 0 ? report.spends.size() / seconds : 0) << " spends/s" << std::endl;
+    out << "total cost:      " << total_cost << ", generators: " << report.generator_cost << std::endl;
+    out << "cost per us:     " << (total_run_us > 0 ? total_cost / total_run_us : 0) << std::endl;
+
+    auto print_stage = [&out](char const* name, std::vector<double> const& samples) {
+        char line[128];
+        snprintf(line, sizeof(line), "%-16s p50 %10.2f us   p99 %10.2f us", name, Percentile(samples, 0.5),
+            Percentile(samples, 0.99));
+        out << line << std::endl;
+    };
+    print_stage("deserialize:", report.Deserialize());
+    print_stage("run+conditions:", run_us);
+    print_stage("agg_sig pairs:", report.Stage(&SpendResult::pairs_us));
+    print_stage("spend total:", report.Total());
+    print_stage("generator:", report.generator_us);
+}
+
+void WriteJson(Report const& report, std::string const& path)
+{
+    std::ofstream out(path);
+    if (!out.is_open()) {
+        throw std::runtime_error("cannot open file: " + path + " to write");
+    }
+    chia::Cost total_cost { 0 };
+    double total_run_us { 0 };
+    for (auto const& spend : report.spends) {
+        total_cost += spend.cost;
+        total_run_us += spend.run_us;
+    }
+    double seconds = report.wall_us / 1000000;
+    auto write_stage = [&out](char const* name, std::vector<double> const& samples) {
+        out << "    \"" << name << "\": { \"p50_us\": " << Percentile(samples, 0.5)
+            << ", \"p99_us\": " << Percentile(samples, 0.99) << " }";
+    };
+    out << "{" << std::endl;
+    out << "  \"records\": " << report.num_records << "," << std::endl;
+    out << "  \"generators\": " << report.num_generators << "," << std::endl;
+    out << "  \"failures\": " << report.num_failures << "," << std::endl;
+    out << "  \"spends\": " << report.spends.size() << "," << std::endl;
+    out << "  \"wall_us\": " << report.wall_us << "," << std::endl;
+    out << "  \"spends_per_second\": " << (seconds > 0 ? report.spends.size() / seconds : 0) << "," << std::endl;
+    out << "  \"total_cost\": " << total_cost << "," << std::endl;
+    out << "  \"cost_per_us\": " << (total_run_us > 0 ? total_cost / total_run_us : 0) << "," << std::endl;
+    out << "  \"stages\": {" << std::endl;
+    write_stage("deserialize", report.Deserialize());
+    out << "," << std::endl;
+    write_stage("run", report.Stage(&SpendResult::run_us));
+    out << "," << std::endl;
+    write_stage("pairs", report.Stage(&SpendResult::pairs_us));
+    out << "," << std::endl;
+    write_stage("spend", report.Total());
+    out << "," << std::endl;
+    write_stage("generator", report.generator_us);
+    out << std::endl << "  }" << std::endl << "}" << std::endl;
+}
+
+void PrintUsage()
+{
+    std::cerr << "usage: clvm_replay <corpus_dir> [--repeat N] [--additional-data HEX] [--json FILE]" << std::endl;
+}
+
+bool ParseOptions(int argc, char const* argv[], Options& options)
+{
+    options.additional_data = chia::utils::BytesFromHex(SZ_MAINNET_GENESIS_CHALLENGE);
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        bool has_value = i + 1 < argc;
+        if (arg == "--repeat" && has_value) {
+            options.repeat = std::max(1, std::stoi(argv[++i]));
+        } else if (arg == "--additional-data" && has_value) {
+            options.additional_data = chia::utils::BytesFromHex(argv[++i]);
+        } else if (arg == "--json" && has_value) {
+            options.json_path = argv[++i];
+        } else if (options.corpus_dir.empty() && arg.compare(0, 2, "--") != 0) {
+            options.corpus_dir = arg;
+        } else {
+            return false;
+        }
+    }
+    return !options.corpus_dir.empty();
+}
+
+} // namespace replay
+
+int main(int argc, char const* argv[])
+{
+    replay::Options options;
+    if (!replay::ParseOptions(argc, argv, options)) {
+        replay::PrintUsage();
+        return 1;
+    }
+    try {
+        auto records = replay::LoadCorpus(options.corpus_dir);
+        if (records.empty()) {
+            std::cerr << "no record is found in " << options.corpus_dir << std::endl;
+            return 1;
+        }
+        auto report = replay::Replay(records, options);
+        replay::PrintReport(report, std::cout);
+        if (!options.json_path.empty()) {
+            replay::WriteJson(report, options.json_path);
+        }
+    } catch (std::exception const& e) {
+        std::cerr << "error: " << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
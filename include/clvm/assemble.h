@@ -1,14 +1,25 @@
 #ifndef CHIA_ASSEMBLE_H
 #define CHIA_ASSEMBLE_H
 
+#include <ostream>
 #include <string>
+#include <string_view>
 
 #include "sexp_prog.h"
 
 namespace chia
 {
 
-CLVMObjectPtr Assemble(std::string str);
+/// Assemble the source of a clvm program, the source is tokenized in a single pass and nested lists are read without
+/// recursion
+CLVMObjectPtr Assemble(std::string_view str);
+
+/// Write the program as clvm assembly, the output follows `opd` and the tree is walked without recursion
+void Disassemble(CLVMObjectPtr sexp, std::ostream& out);
+
+void Disassemble(Program const& program, std::ostream& out);
+
+std::string Disassemble(Program const& program);
 
 } // namespace chia
 
@@ -0,0 +1,65 @@
+#ifndef CHIA_BATCH_VERIFIER_H
+#define CHIA_BATCH_VERIFIER_H
+
+#include <cstddef>
+#include <vector>
+
+#include "types.h"
+
+namespace chia
+{
+
+class ThreadPool;
+
+namespace wallet
+{
+
+/// The public keys, messages and aggregated signature of one `AggregateVerifySignature` call
+struct SignatureSet {
+    std::vector<PublicKey> public_keys;
+    std::vector<Bytes> messages;
+    Signature signature;
+};
+
+/**
+ * Verify many signature sets together
+ *
+ * Every set is weighted by a random 128-bit scalar and the weighted sets are checked with one multi-pairing, so the
+ * final exponentiation is shared. The sets are split into one chunk per thread, a chunk which doesn't pass is
+ * checked again set by set to find out the invalid ones.
+ */
+class BatchVerifier
+{
+public:
+    explicit BatchVerifier(int max_threads = 0);
+
+    explicit BatchVerifier(ThreadPool& pool, int max_threads = 0);
+
+    /// Add a set, returns the index of its result
+    std::size_t Add(SignatureSet set);
+
+    std::size_t Add(std::vector<PublicKey> public_keys, std::vector<Bytes> messages, Signature const& signature);
+
+    std::size_t GetCount() const { return sets_.size(); }
+
+    void Clear() { sets_.clear(); }
+
+    /// Verify all sets, the result of each set is returned in the order they were added
+    std::vector<bool> Verify() const;
+
+    /// Return `true` when all sets are valid, it doesn't look for the invalid ones
+    bool VerifyAll() const;
+
+private:
+    std::vector<bool> Verify(bool find_invalid) const;
+
+private:
+    ThreadPool& pool_;
+    int max_threads_;
+    std::vector<SignatureSet> sets_;
+};
+
+} // namespace wallet
+} // namespace chia
+
+#endif
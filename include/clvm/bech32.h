@@ -1,10 +1,12 @@
 #ifndef CHIA_BECH32_H
 #define CHIA_BECH32_H
 
+#include <cstdint>
+
 #include <string>
+#include <string_view>
 #include <vector>
 
-#include "int.h"
 #include "types.h"
 
 namespace chia
@@ -12,25 +14,41 @@ namespace chia
 namespace bech32
 {
 
-Int Polymod(std::vector<Int> const& values);
+/// The data of bech32 strings are 5-bit symbols, one per byte
+using Symbols = std::vector<uint8_t>;
+
+enum class Encoding { BECH32, BECH32M };
+
+uint32_t Polymod(uint8_t const* values, std::size_t num_values, uint32_t chk = 1);
+
+uint32_t Polymod(Symbols const& values);
 
-std::vector<Int> HRPExpand(std::string_view hrp);
+Symbols HRPExpand(std::string_view hrp);
 
-bool VerifyChecksum(std::string_view hrp, std::vector<Int> const& data);
+bool VerifyChecksum(std::string_view hrp, Symbols const& data, Encoding encoding = Encoding::BECH32M);
 
-std::vector<Int> CreateChecksum(std::string_view hrp, std::vector<Int> const& data);
+Symbols CreateChecksum(std::string_view hrp, Symbols const& data, Encoding encoding = Encoding::BECH32M);
 
 std::string Strip(std::string_view str, char strip_ch = ' ');
 
-std::string Encode(std::string_view hrp, std::vector<Int> const& data);
+std::string Encode(std::string_view hrp, Symbols const& data, Encoding encoding = Encoding::BECH32M);
+
+/// Decode a bech32 string, the data is returned without the checksum, the hrp is empty when the string is invalid
+std::pair<std::string, Symbols> Decode(std::string_view bech_in, int max_length = 90, Encoding encoding = Encoding::BECH32M);
+
+Bytes ConvertBits(uint8_t const* data, std::size_t size, int frombits, int tobits, bool pad = true);
+
+Bytes ConvertBits(Bytes const& data, int frombits, int tobits, bool pad = true);
 
-std::pair<std::string, std::vector<Int>> Decode(std::string_view bech_in, int max_length = 90);
+std::string EncodePuzzleHash(Bytes32 const& puzzle_hash, std::string_view prefix);
 
-std::vector<Int> ConvertBits(std::vector<Int> const& data, int frombits, int tobits, bool pad = true);
+Bytes32 DecodePuzzleHash(std::string_view address);
 
-std::string EncodePuzzleHash(std::vector<Int> const& puzzle_hash, std::string_view prefix);
+/// Encode many puzzle-hashes with the same prefix, large batches are encoded on the thread pool
+std::vector<std::string> EncodeMany(std::vector<Bytes32> const& puzzle_hashes, std::string_view prefix);
 
-std::vector<Int> DecodePuzzleHash(std::string_view address);
+/// Decode many addresses, an exception is thrown when any of them is invalid
+std::vector<Bytes32> DecodeMany(std::vector<std::string> const& addresses);
 
 } // namespace bech32
 } // namespace chia
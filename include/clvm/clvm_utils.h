@@ -3,6 +3,7 @@
 
 #include <cassert>
 #include <cstring>
+#include <stdexcept>
 
 #include <string>
 #include <vector>
@@ -15,6 +16,17 @@ namespace chia::utils
 
 const int HASH256_LEN = 32;
 
+/// Hash function for unordered containers keyed by `Bytes32`, the keys are sha256 values so the bytes are uniformly
+/// distributed already
+struct Bytes32Hash {
+    std::size_t operator()(Bytes32 const& hash) const
+    {
+        std::size_t res;
+        memcpy(&res, hash.data(), sizeof(res));
+        return res;
+    }
+};
+
 template <int LEN> Bytes bytes_cast(std::array<uint8_t, LEN> const& rhs)
 {
     Bytes bytes(LEN, '\0');
@@ -78,6 +90,27 @@ uint8_t HexCharToByte4b(char ch);
  */
 std::string BytesToHex(Bytes const& bytes);
 
+/**
+ * Convert bytes into hex string, the SSE2/AVX2 kernel is used when the target
+ * supports it
+ *
+ * @param data The bytes
+ * @param size The number of bytes
+ *
+ * @return Hex string without prefix
+ */
+std::string BytesToHex(uint8_t const* data, std::size_t size);
+
+/**
+ * Write the hex string of bytes into a buffer
+ *
+ * @param data The bytes
+ * @param size The number of bytes
+ * @param out The buffer takes exactly `size * 2` characters, no terminator is
+ * written
+ */
+void BytesToHex(uint8_t const* data, std::size_t size, char* out);
+
 /**
  * Convert a hex string into a byte array
  *
@@ -87,6 +120,14 @@ std::string BytesToHex(Bytes const& bytes);
  */
 Bytes BytesFromHex(std::string_view hex);
 
+/**
+ * Convert a hex string into a buffer
+ *
+ * @param hex The hex string contains hex bytes
+ * @param out The buffer takes `(hex.size() + 1) / 2` bytes
+ */
+void BytesFromHex(std::string_view hex, uint8_t* out);
+
 /**
  * Convert byte array list to the string represents the arguments to a chialisp
  * function call
@@ -106,6 +147,45 @@ std::string ArgsToStr(std::vector<Bytes> const& args);
  */
 std::string LoadHexFromFile(std::string file_path);
 
+/**
+ * Convert a hex text into a byte array, white spaces between the hex
+ * characters are ignored
+ *
+ * @param hex The hex text, for example the content of a hex file
+ *
+ * @return The converted byte array
+ */
+Bytes BytesFromHexText(std::string_view hex);
+
+/**
+ * A read-only view of the whole content of a file, the file is memory-mapped
+ * when it is possible, otherwise it is read into a buffer. Pass false to
+ * `sequential` when the file is read at random places
+ */
+class MappedFile
+{
+public:
+    explicit MappedFile(std::string const& file_path, bool use_mmap = true, bool sequential = true);
+
+    ~MappedFile();
+
+    MappedFile(MappedFile const&) = delete;
+
+    MappedFile& operator=(MappedFile const&) = delete;
+
+    uint8_t const* GetData() const { return data_; }
+
+    std::size_t GetSize() const { return size_; }
+
+    bool IsMapped() const { return mapped_; }
+
+private:
+    uint8_t const* data_ { nullptr };
+    std::size_t size_ { 0 };
+    bool mapped_ { false };
+    Bytes buffer_;
+};
+
 /**
  * Convert a byte to an byte vector which contains 1 byte
  *
@@ -195,12 +275,33 @@ template <typename T> Bytes IntToBEBytes(T const& val)
     return b;
 }
 
+/// Read the big-endian bytes of an unsigned integer, `std::runtime_error` is thrown when there are more bytes than `T`
 template <typename T> T IntFromBEBytes(Bytes const& bytes)
 {
+    if (bytes.size() > sizeof(T)) {
+        throw std::runtime_error("the integer is wider than its type");
+    }
     Bytes r = RevertBytes(bytes);
-    int num_bytes_to_copy = std::max(sizeof(T), r.size());
     T result { 0 };
-    memcpy(&result, r.data(), num_bytes_to_copy);
+    memcpy(&result, r.data(), r.size());
+    return result;
+}
+
+/// The unsigned integer of a CLVM atom, `std::runtime_error` is thrown when the atom is negative or wider than `T`, a
+/// single leading zero which keeps a value with the top bit set positive is the only byte allowed past the size of `T`
+template <typename T> T UIntFromAtom(Bytes const& atom)
+{
+    if (!atom.empty() && (atom[0] & 0x80)) {
+        throw std::runtime_error("the integer is negative");
+    }
+    std::size_t begin = atom.size() == sizeof(T) + 1 && atom[0] == 0 ? 1 : 0;
+    if (atom.size() - begin > sizeof(T)) {
+        throw std::runtime_error("the integer is wider than its type");
+    }
+    T result { 0 };
+    for (std::size_t i = begin; i < atom.size(); ++i) {
+        result = static_cast<T>((result << 8) | atom[i]);
+    }
     return result;
 }
 
@@ -4,7 +4,9 @@
 #include <vector>
 #include <set>
 #include <map>
+#include <memory>
 
+#include "condition_opcode.h"
 #include "sexp_prog.h"
 #include "types.h"
 
@@ -16,11 +18,19 @@ namespace bls {
 namespace chia
 {
 
+namespace wallet {
+class PairingCache;
+} // namespace wallet
+
 class Coin
 {
 public:
     static Bytes32 HashCoinList(std::vector<Coin> coin_list);
 
+    /// Read a coin in the streamable format from the start of the buffer, the number of bytes it takes is written to
+    /// `consumed`
+    static Coin FromBytes(uint8_t const* data, std::size_t size, std::size_t* consumed = nullptr);
+
     Coin() = default;
 
     Coin(Bytes parent_coin_info, Bytes puzzle_hash, uint64_t amount);
@@ -31,8 +41,17 @@ public:
 
     std::string GetNameStr() const;
 
+    Bytes32 GetParentCoinInfo() const;
+
+    Bytes32 GetPuzzleHash() const;
+
     Cost GetAmount() const { return amount_; }
 
+    /// Write the coin in the streamable format of the full node, the parent, the puzzle hash and 8 bytes of amount
+    void Stream(WriteStreamFunc const& f) const;
+
+    Bytes Serialize() const;
+
 private:
     Bytes32 GetHash() const;
 
@@ -51,6 +70,10 @@ struct Payment
 class CoinSpend
 {
 public:
+    /// Read a coin spend in the streamable format, the puzzle reveal and the solution are parsed in place by
+    /// `SExpFromBuffer`
+    static CoinSpend FromBytes(uint8_t const* data, std::size_t size, std::size_t* consumed = nullptr);
+
     Coin coin;
     std::optional<Program> puzzle_reveal;
     std::optional<Program> solution;
@@ -65,6 +88,12 @@ public:
     std::vector<Coin> Additions() const;
 
     Cost ReservedFee();
+
+    /// Write the coin and the serialized puzzle reveal and solution, `std::runtime_error` is thrown when either of
+    /// them is missing
+    void Stream(WriteStreamFunc const& f) const;
+
+    Bytes Serialize() const;
 };
 
 class SpendBundle
@@ -72,6 +101,10 @@ class SpendBundle
 public:
     static SpendBundle Aggregate(std::vector<SpendBundle> const& spend_bundles);
 
+    /// Read a bundle in the streamable format as it comes from the network, `std::runtime_error` is thrown when the
+    /// buffer ends before the bundle
+    static SpendBundle FromBytes(uint8_t const* data, std::size_t size, std::size_t* consumed = nullptr);
+
     SpendBundle(std::vector<CoinSpend> coin_spends, Signature sig);
 
     std::vector<CoinSpend> const& CoinSolutions() const { return coin_spends_; }
@@ -82,15 +115,30 @@ public:
 
     uint64_t Fees() const;
 
+    /// The hash of the bundle in the streamable format of the full node, it is calculated once and shared by the
+    /// copies of the bundle
     Bytes32 Name() const;
 
+    /// The additions which aren't spent by the same bundle
     std::vector<Coin> NotEphemeralAdditions() const;
 
+    /// The removals which aren't created by the same bundle, they are the coins which must exist before the bundle
+    std::vector<Coin> NotEphemeralRemovals() const;
+
     Signature const& GetAggregatedSignature() const { return aggregated_signature_; }
 
+    /// Write the number of spends in 4 bytes, the spends and the signature, the programs are written as they are
+    /// serialized so a `crypto_utils::SHA256` can be fed without a buffer of the bundle
+    void Stream(WriteStreamFunc const& f) const;
+
+    Bytes Serialize() const;
+
 private:
+    struct NameCache;
+
     std::vector<CoinSpend> coin_spends_;
     Signature aggregated_signature_;
+    std::shared_ptr<NameCache> name_cache_;
 };
 
 namespace puzzle {
@@ -99,7 +147,35 @@ using SecretKeyForPublicKeyFunc = std::function<std::optional<chia::PrivateKey>(
 using SecretKeyForPuzzleHashFunc = std::function<std::optional<chia::PrivateKey>(chia::Bytes32 const& puzzle_hash)>;
 using DeriveFunc = std::function<Bytes32(chia::PublicKey const& public_key)>;
 
-SpendBundle sign_coin_spends(std::vector<CoinSpend> coin_spends, SecretKeyForPublicKeyFunc secret_key_for_public_key_f, SecretKeyForPuzzleHashFunc secret_key_for_puzzle_hash_f, Bytes const& additional_data = {}, Cost max_cost = 0, std::vector<DeriveFunc> const& derive_f_list = {});
+struct SignOptions
+{
+    /// Verify every signature right after it is made, each check is a full pairing
+    bool verify_each_signature { false };
+
+    /// Verify the aggregated signature of the whole bundle before returning it
+    bool verify_aggregated_signature { true };
+
+    /// Make the signatures on `ThreadPool::GetInstance()`, the key lookup functions are always called from the
+    /// calling thread
+    bool parallel { true };
+};
+
+SpendBundle sign_coin_spends(std::vector<CoinSpend> coin_spends, SecretKeyForPublicKeyFunc secret_key_for_public_key_f, SecretKeyForPuzzleHashFunc secret_key_for_puzzle_hash_f, Bytes const& additional_data = {}, Cost max_cost = 0, std::vector<DeriveFunc> const& derive_f_list = {}, SignOptions const& options = SignOptions());
+
+std::tuple<std::map<ConditionOpcode, std::vector<ConditionWithArgs>>, Cost> conditions_dict_for_solution(Program const& puzzle_reveal, Program const& solution, Cost max_cost);
+
+std::vector<Coin> created_outputs_for_conditions_dict(std::map<ConditionOpcode, std::vector<ConditionWithArgs>> const& conditions_dict, Bytes32 const& input_coin_name);
+
+std::vector<std::tuple<Bytes48, Bytes>> pkm_pairs_for_conditions_dict(std::map<ConditionOpcode, std::vector<ConditionWithArgs>> const& conditions_dict, Bytes32 const& coin_name, Bytes const& additional_data);
+
+/// Collect the (public key, message) pairs of the AGG_SIG conditions from all spends of a bundle
+std::vector<std::tuple<Bytes48, Bytes>> pkm_pairs_for_spend_bundle(SpendBundle const& spend_bundle, Bytes const& additional_data, Cost max_cost = 0);
+
+/// Verify the aggregated signatures of many spend bundles with one batch, the result of each bundle is returned in order
+std::vector<bool> verify_spend_bundles(std::vector<SpendBundle> const& spend_bundles, Bytes const& additional_data, Cost max_cost = 0);
+
+/// Verify the aggregated signature of a spend bundle, the pairings of AGG_SIG pairs seen before are taken from the cache
+bool validate_spend_bundle_signature(SpendBundle const& spend_bundle, Bytes const& additional_data, wallet::PairingCache& cache, Cost max_cost = 0);
 
 Program make_solution(std::vector<Payment> const& primaries, std::set<Bytes> const& coin_announcements = {}, std::set<Bytes32> const& coin_announcements_to_assert = {}, std::set<Bytes> const& puzzle_announcements = {}, std::set<Bytes32> const& puzzle_announcements_to_assert = {}, CLVMObjectPtr additions = nullptr, uint64_t fee = 0);
 
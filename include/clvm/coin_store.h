@@ -0,0 +1,116 @@
+#ifndef CHIA_COIN_STORE_H
+#define CHIA_COIN_STORE_H
+
+#include <cstddef>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "coin.h"
+#include "types.h"
+
+namespace chia
+{
+
+/// A coin and the heights of the blocks which create and spend it, the size of the record is fixed
+struct CoinRecord {
+    Bytes32 coin_id;
+    Bytes32 parent_coin_info;
+    Bytes32 puzzle_hash;
+    uint64_t amount;
+    uint32_t confirmed_height;
+
+    /// 0 when the coin isn't spent
+    uint32_t spent_height;
+
+    bool IsSpent() const { return spent_height != 0; }
+
+    Coin GetCoin() const { return Coin(parent_coin_info, puzzle_hash, amount); }
+};
+
+/**
+ * The coin set in memory
+ *
+ * The records are kept in an open addressing hash table keyed by coin ID, a second table maps each puzzle hash to the
+ * last coin added with it and the coins of a puzzle hash are linked from there. The tables are split into pages, a
+ * copy of the store shares all pages and a page is copied on the first write to it, so a snapshot for speculative
+ * validation costs one pointer per page and the copy of the pages it writes. A coin takes a slot of 160 bytes and a
+ * puzzle hash 65 bytes, the tables are at most 3/4 full and double when they grow, pass the number of coins expected
+ * to the constructor to allocate the coin table once.
+ *
+ * A store which is opened from a directory keeps the coins of its last checkpoint in a file, the file is mapped and a
+ * coin is looked up in place, only the coins which change after the checkpoint are copied to memory.
+ *
+ * A store isn't thread-safe, a snapshot is a different store and it can be used on another thread.
+ */
+class CoinStore
+{
+public:
+    explicit CoinStore(std::size_t expected_coins = 0);
+
+    ~CoinStore();
+
+    /// The copy shares the pages with this store, it is in memory only
+    CoinStore(CoinStore const& rhs);
+
+    CoinStore& operator=(CoinStore const& rhs);
+
+    CoinStore(CoinStore&& rhs) noexcept;
+
+    CoinStore& operator=(CoinStore&& rhs) noexcept;
+
+    /**
+     * Open the store saved in the directory, an empty store is created when the directory has none
+     *
+     * The coins of the last checkpoint are mapped from `coins.dat`, the blocks applied after it are replayed from the
+     * write-ahead log `coins.log`. The record of each block and rollback is synced to the log before the store
+     * changes, a record torn by a crash is dropped when the store is opened again. A snapshot doesn't write the log.
+     */
+    static CoinStore Open(std::string const& dir_path);
+
+    /// Write all coins to a new `coins.dat` and begin a new log, the blocks before it can't be undone any more
+    void Checkpoint();
+
+    /// The snapshot shares the pages and the coin file with this store
+    CoinStore Snapshot() const { return *this; }
+
+    std::optional<CoinRecord> Get(Bytes32 const& coin_id) const;
+
+    std::vector<CoinRecord> GetByPuzzleHash(Bytes32 const& puzzle_hash, bool include_spent = false) const;
+
+    /**
+     * Add the coins created by the block and mark the coins spent by it
+     *
+     * A removal can be a coin of the same block. The block is checked before anything is changed, the store is left
+     * as it is and `std::runtime_error` is thrown when a coin is added twice, a removal doesn't exist or is spent
+     * already, or the height isn't above the last block.
+     *
+     * @param height The height of the block
+     * @param additions The coins created by the block
+     * @param removals The IDs of the coins spent by the block
+     */
+    void ApplyBlock(uint32_t height, std::vector<Coin> const& additions, std::vector<Bytes32> const& removals);
+
+    /// Undo the blocks above the height, the blocks which are pruned can't be undone
+    void Rollback(uint32_t height);
+
+    /// Drop the undo records of the blocks at the height and below
+    void PruneUndo(uint32_t height);
+
+    /// The height of the last block, 0 before any block
+    uint32_t GetHeight() const;
+
+    std::size_t GetSize() const;
+
+    /// The bytes taken by the tables in memory, the mapped coin file isn't included
+    std::size_t GetMemoryUsage() const;
+
+private:
+    struct Impl;
+    std::unique_ptr<Impl> m_pimpl;
+};
+
+} // namespace chia
+
+#endif
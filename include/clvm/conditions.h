@@ -0,0 +1,86 @@
+#ifndef CHIA_CONDITIONS_H
+#define CHIA_CONDITIONS_H
+
+#include <cstddef>
+#include <functional>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "coin.h"
+#include "generator.h"
+#include "types.h"
+
+namespace chia
+{
+
+/// The block which confirms a coin
+struct CoinConfirmation {
+    uint32_t height;
+    uint64_t timestamp;
+};
+
+/// The chain the conditions are checked against
+struct ChainState {
+    /// The height of the last transaction block before the block which is going to include the spends, the
+    /// ASSERT_HEIGHT_* conditions are checked against it as the consensus does
+    uint32_t prev_transaction_block_height { 0 };
+
+    /// The time in seconds the ASSERT_SECONDS_* conditions are checked against
+    uint64_t timestamp { 0 };
+
+    /// The confirmation of a spent coin for the relative timelocks, it is only called for a spend which has one. A
+    /// coin created by the same spends is confirmed at the height after `prev_transaction_block_height` and at
+    /// `timestamp`, a relative timelock of 0 or less always passes
+    std::function<std::optional<CoinConfirmation>(Bytes32 const& coin_id)> get_coin_confirmation;
+};
+
+struct ConditionFailure {
+    enum class Code {
+        INVALID_CONDITION,
+        ASSERT_ANNOUNCE_CONSUMED_FAILED,
+        ASSERT_MY_COIN_ID_FAILED,
+        ASSERT_MY_PARENT_ID_FAILED,
+        ASSERT_MY_PUZZLEHASH_FAILED,
+        ASSERT_MY_AMOUNT_FAILED,
+        ASSERT_SECONDS_RELATIVE_FAILED,
+        ASSERT_SECONDS_ABSOLUTE_FAILED,
+        ASSERT_HEIGHT_RELATIVE_FAILED,
+        ASSERT_HEIGHT_ABSOLUTE_FAILED,
+        UNKNOWN_UNSPENT,
+    };
+
+    Code code;
+
+    /// The index of the spend in the bundle or the block
+    std::size_t spend_index;
+
+    uint8_t opcode;
+
+    /// The index of the condition among the conditions of the spend with the same opcode
+    std::size_t condition_index;
+};
+
+std::string ConditionFailureCodeToString(ConditionFailure::Code code);
+
+/**
+ * Check the announcements, the self assertions and the timelocks of the spends
+ *
+ * The IDs of the created coin and puzzle announcements are collected into two hash sets first, then every assertion
+ * is checked in one pass over the conditions, so the time is linear in the number of conditions. The first failure is
+ * returned, nothing is returned when all conditions pass.
+ *
+ * The conditions of a spend are grouped by opcode and checked in the ascending order of the opcodes rather than the
+ * order the puzzle returns them, the first failure and its `condition_index` follow that order.
+ */
+std::optional<ConditionFailure> ValidateSpendConditions(
+    std::vector<SpendConditions> const& spends, ChainState const& chain_state);
+
+/// Run the puzzles of the bundle within `max_cost` and check their conditions, 0 is no limit. `std::runtime_error` is
+/// thrown when a puzzle fails to run
+std::optional<ConditionFailure> ValidateBundleConditions(
+    SpendBundle const& spend_bundle, ChainState const& chain_state, Cost max_cost = 0);
+
+} // namespace chia
+
+#endif
@@ -80,6 +80,10 @@ int const LOGNOT_COST_PER_BYTE = 3;
 int const APPLY_COST = 90;
 int const QUOTE_COST = 20;
 
+/// The costs of the conditions which are added to the cost of a block by the full node
+int const CREATE_COIN_COST = 1800000;
+int const AGG_SIG_COST = 1200000;
+
 } // namespace chia
 
 #endif
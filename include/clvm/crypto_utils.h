@@ -1,7 +1,10 @@
 #ifndef CHIA_CRYPT_UTILS_H
 #define CHIA_CRYPT_UTILS_H
 
+#include <array>
+#include <cstddef>
 #include <memory>
+#include <vector>
 
 #include "types.h"
 
@@ -10,23 +13,36 @@ namespace chia
 namespace crypto_utils
 {
 
+/// The digest contexts are reused, each thread keeps the contexts of the finished hashes for the next ones
 class SHA256
 {
     struct Impl;
-    
+
 public:
     SHA256();
 
     ~SHA256();
 
-    void Add(Bytes const& bytes);
+    void Add(uint8_t const* data, std::size_t size);
+
+    void Add(Bytes const& bytes) { Add(bytes.data(), bytes.size()); }
+
+    template <std::size_t N> void Add(std::array<uint8_t, N> const& bytes) { Add(bytes.data(), N); }
 
     Bytes32 Finish();
 
 private:
+    struct IdlePool;
+
+    /// The idle contexts of the calling thread, nullptr once the thread has destroyed them at its exit
+    static std::vector<std::unique_ptr<Impl>>* IdleContexts();
+
     std::unique_ptr<Impl> m_pimpl;
 };
 
+/// Fill the buffer with cryptographically secure random bytes
+void RandomBytes(uint8_t* out, std::size_t size);
+
 inline void WriteBytes(SHA256&) { }
 
 template <typename T, typename... Ts> void WriteBytes(SHA256& sha, T&& bytes, Ts&&... others)
@@ -0,0 +1,60 @@
+#ifndef CHIA_GENERATOR_H
+#define CHIA_GENERATOR_H
+
+#include <map>
+#include <optional>
+#include <vector>
+
+#include "coin.h"
+#include "condition_opcode.h"
+#include "sexp_prog.h"
+#include "types.h"
+
+namespace chia
+{
+
+/// The result of one spend of a block
+struct SpendConditions {
+    CoinSpend coin_spend;
+    Bytes32 coin_id;
+    Bytes32 puzzle_hash;
+    std::map<ConditionOpcode, std::vector<ConditionWithArgs>> conditions;
+    Cost cost;
+};
+
+struct BlockConditions {
+    std::vector<SpendConditions> spends;
+    Cost generator_cost { 0 };
+
+    /// The cost of the CREATE_COIN and AGG_SIG conditions of all spends
+    Cost condition_cost { 0 };
+
+    /// The cost of the generator, all puzzles and their conditions
+    Cost cost { 0 };
+};
+
+/**
+ * Run the transaction generator of a block and the puzzles of all its spends
+ *
+ * The generator returns `((parent puzzle amount solution)...)` as the first item of its result, every puzzle is run
+ * with its solution and the conditions are collected. `max_cost` is shared by the generator, all puzzles and the costs
+ * of the CREATE_COIN and AGG_SIG conditions, the run stops as soon as the block spends more, 0 is no limit. The
+ * puzzle hash of a puzzle reveal which appears more than once as the same node is calculated once, a generator which
+ * is imported by `Program::ImportFromBytesWithBackrefs` shares the node of every repeated puzzle.
+ */
+class GeneratorRunner
+{
+public:
+    /// Without a ROM the generator is run with `((refs...))`, with a ROM the ROM is run with
+    /// `(generator ((refs...)))` the same way as the bootstrap program of the full node
+    explicit GeneratorRunner(std::optional<Program> rom = {});
+
+    BlockConditions Run(Program const& generator, std::vector<Bytes> const& generator_refs, Cost max_cost) const;
+
+private:
+    std::optional<Program> rom_;
+};
+
+} // namespace chia
+
+#endif
@@ -29,10 +29,20 @@ public:
 
     explicit Int(long val);
 
+    /// Read an atom of CLVM, the bytes are the two's complement of the value
+    static Int FromSignedBytes(Bytes const& bytes);
+
+    /// The bytes of the magnitude, the sign is written to `neg`
     Bytes ToBytes(bool* neg = nullptr) const;
 
+    /// The canonical atom of CLVM, the fewest two's complement bytes which keep the sign and 0 is empty
+    Bytes ToSignedBytes() const;
+
     int NumBytes() const;
 
+    /// The digits of the value in the base, with a leading '-' for negative values
+    std::string ToString(int base = 10) const;
+
     int ToInt() const;
 
     unsigned long ToUInt() const;
@@ -1,11 +1,18 @@
 #ifndef CHIA_KEY_H
 #define CHIA_KEY_H
 
+#include <memory>
 #include <string>
 #include <string_view>
 
 #include "types.h"
 
+namespace bls
+{
+class PrivateKey;
+class G1Element;
+} // namespace bls
+
 namespace chia::wallet
 {
 
@@ -74,6 +81,71 @@ private:
     PrivateKey priv_key_;
 };
 
+/// A public key which keeps the decompressed and validated G1 point, copies share the same point
+class PublicKeyHandle
+{
+public:
+    /// Create an empty handle
+    PublicKeyHandle();
+
+    /// Parse and validate the public key, throws when the bytes are not a valid G1 point
+    explicit PublicKeyHandle(PublicKey const& public_key);
+
+    /// Wrap a G1 point which is already valid
+    explicit PublicKeyHandle(bls::G1Element const& g1);
+
+    /// Return `true` when the handle is empty
+    bool IsEmpty() const;
+
+    /// Get the serialized public key
+    PublicKey const& GetPublicKey() const;
+
+    /// Get the cached G1 point
+    bls::G1Element const& GetG1Element() const;
+
+private:
+    struct Impl;
+    std::shared_ptr<Impl const> impl_;
+};
+
+/// A variant of `Key` which keeps the parsed bls private key and computes the public key only once, copies share
+/// the same cache
+class CachedKey
+{
+public:
+    static bool VerifySignature(PublicKeyHandle const& public_key, Bytes const& message, Signature const& signature);
+
+    static PublicKeyHandle AggregatePublicKeys(std::vector<PublicKeyHandle> const& public_keys);
+
+    static bool AggregateVerifySignature(
+        std::vector<PublicKeyHandle> const& public_keys, std::vector<Bytes> const& messages, Signature const& signature);
+
+    /// Create a object by importing the private key
+    explicit CachedKey(PrivateKey const& priv_key);
+
+    /// Create a object from an existing key
+    explicit CachedKey(Key const& key);
+
+    /// Get the private key value
+    PrivateKey const& GetPrivateKey() const;
+
+    /// Get the parsed bls private key
+    bls::PrivateKey const& GetBlsPrivateKey() const;
+
+    /// Get public key, it is calculated on the first call
+    PublicKey const& GetPublicKey() const;
+
+    /// Get public key handle, it is calculated on the first call
+    PublicKeyHandle const& GetPublicKeyHandle() const;
+
+    /// Make a signature
+    Signature Sign(Bytes const& msg) const;
+
+private:
+    struct Impl;
+    std::shared_ptr<Impl> impl_;
+};
+
 } // namespace chia::wallet
 
 #endif
@@ -0,0 +1,105 @@
+#ifndef CHIA_MEMPOOL_H
+#define CHIA_MEMPOOL_H
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "coin.h"
+#include "types.h"
+
+namespace chia
+{
+
+namespace wallet
+{
+class PairingCache;
+} // namespace wallet
+
+struct MempoolOptions {
+    /// The max cost of one bundle, 0 is no limit
+    Cost max_bundle_cost { 0 };
+
+    /// Verify the aggregated signature of a bundle before it is admitted
+    bool verify_signature { true };
+
+    /// The additional data of the AGG_SIG_ME messages, it is the genesis challenge of the network
+    Bytes additional_data;
+};
+
+/// A bundle which has passed the validation
+struct MempoolItem {
+    uint64_t id;
+    SpendBundle spend_bundle;
+    Cost cost;
+    uint64_t fee;
+    std::vector<Bytes32> removals;
+    std::vector<Coin> additions;
+
+    double GetFeePerCost() const { return cost ? static_cast<double>(fee) / static_cast<double>(cost) : 0; }
+};
+
+using MempoolItemPtr = std::shared_ptr<MempoolItem const>;
+
+/**
+ * The pool of the bundles which wait for a block
+ *
+ * A bundle is validated before it is admitted: every puzzle must match the puzzle hash of its coin and run within the
+ * cost, the outputs can't be more than the inputs and the aggregated signature must be valid. The validation runs
+ * without any lock. The spent coins are indexed by coin ID in shards with a lock each, a bundle only locks the shards
+ * of its own coins to check the conflicts, so bundles which spend different coins are admitted at the same time.
+ * A bundle which spends a coin of an item in the pool is rejected. All methods are thread-safe.
+ */
+class Mempool
+{
+public:
+    enum class Status { ADDED, CONFLICT, INVALID };
+
+    struct AddResult {
+        Status status;
+        MempoolItemPtr item;
+
+        /// The IDs of the items which spend the same coins when the status is CONFLICT
+        std::vector<uint64_t> conflicts;
+
+        std::string error;
+    };
+
+    /// The signatures are verified through `cache` when it is given, the cache must live longer than the mempool
+    explicit Mempool(MempoolOptions options = MempoolOptions(), wallet::PairingCache* cache = nullptr);
+
+    ~Mempool();
+
+    Mempool(Mempool const&) = delete;
+
+    Mempool& operator=(Mempool const&) = delete;
+
+    AddResult Add(SpendBundle spend_bundle);
+
+    MempoolItemPtr Get(uint64_t id) const;
+
+    /// The item which spends the coin, nullptr when the coin isn't spent in the pool
+    MempoolItemPtr GetBySpentCoin(Bytes32 const& coin_id) const;
+
+    bool Remove(uint64_t id);
+
+    /// Remove the items which spend any of the coins, it is called when a block spends them, the number of the items
+    /// removed is returned
+    std::size_t RemoveConflicts(std::vector<Bytes32> const& coin_ids);
+
+    /// Take the items with the highest fee per cost first and skip the ones which don't fit until `max_cost` is used
+    std::vector<MempoolItemPtr> CreateBlockCandidate(Cost max_cost) const;
+
+    std::size_t GetSize() const;
+
+    Cost GetTotalCost() const;
+
+private:
+    struct Impl;
+    std::unique_ptr<Impl> m_pimpl;
+};
+
+} // namespace chia
+
+#endif
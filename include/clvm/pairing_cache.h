@@ -0,0 +1,50 @@
+#ifndef CHIA_PAIRING_CACHE_H
+#define CHIA_PAIRING_CACHE_H
+
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+#include "types.h"
+
+namespace chia::wallet
+{
+
+/**
+ * LRU cache of the pairings e(pk, H(pk || message)) of the augmented scheme
+ *
+ * The cache is keyed by sha256(pk || message). A signature which has been verified once, for example in the mempool,
+ * can be verified again when the block arrives by multiplying the cached pairings and comparing the product with
+ * e(g1, signature), only the pairings which aren't cached are calculated. All methods are thread-safe.
+ */
+class PairingCache
+{
+public:
+    static std::size_t const DEFAULT_CAPACITY = 50000;
+
+    explicit PairingCache(std::size_t capacity = DEFAULT_CAPACITY);
+
+    ~PairingCache();
+
+    PairingCache(PairingCache const&) = delete;
+
+    PairingCache& operator=(PairingCache const&) = delete;
+
+    /// Verify an aggregated signature, the pairings which aren't cached are calculated and added to the cache
+    bool AggregateVerify(
+        std::vector<PublicKey> const& public_keys, std::vector<Bytes> const& messages, Signature const& signature);
+
+    std::size_t GetSize() const;
+
+    std::size_t GetCapacity() const;
+
+    void Clear();
+
+private:
+    struct Impl;
+    std::unique_ptr<Impl> impl_;
+};
+
+} // namespace chia::wallet
+
+#endif
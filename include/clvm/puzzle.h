@@ -30,6 +30,9 @@ private:
 
 PublicKey calculate_synthetic_public_key(PublicKey const& public_key, Bytes32 const& hidden_puzzle_hash);
 
+/// Calculate the synthetic public keys of many public keys on the thread pool, the results are in the same order
+std::vector<PublicKey> calculate_synthetic_public_keys(std::vector<PublicKey> const& public_keys, Bytes32 const& hidden_puzzle_hash);
+
 PrivateKey calculate_synthetic_secret_key(PrivateKey const& private_key, Bytes32 const& hidden_puzzle_hash);
 
 Program puzzle_for_synthetic_public_key(PublicKey const& synthetic_public_key);
@@ -0,0 +1,61 @@
+#ifndef CHIA_SCALAR_H
+#define CHIA_SCALAR_H
+
+#include <cstdint>
+
+#include <array>
+
+#include "types.h"
+
+namespace chia
+{
+
+/**
+ * An element of the BLS12-381 scalar field, the integers modulo the group order r
+ *
+ * The value is kept in four 64-bit limbs and always reduced. Reduction, addition and subtraction don't branch on the
+ * value, so the arithmetic is safe to use with secret exponents.
+ */
+class Scalar
+{
+public:
+    static int const NUM_LIMBS = 4;
+
+    using Limbs = std::array<uint64_t, NUM_LIMBS>;
+
+    /// The group order r, this is the only value which is not reduced
+    static Limbs const& GroupOrder();
+
+    /// Read a 256-bit big-endian number and reduce it mod r, a signed number is negative when its top bit is set
+    static Scalar FromBytes(Bytes32 const& bytes, bool is_signed = false);
+
+    static Scalar FromPrivateKey(PrivateKey const& private_key);
+
+    Scalar();
+
+    explicit Scalar(uint64_t val);
+
+    bool IsZero() const;
+
+    /// 32 bytes big-endian, left padded with zeros
+    Bytes32 ToBytes() const;
+
+    PrivateKey ToPrivateKey() const;
+
+    Scalar operator+(Scalar const& rhs) const;
+
+    Scalar operator-(Scalar const& rhs) const;
+
+    Scalar operator-() const;
+
+    bool operator==(Scalar const& rhs) const;
+
+    bool operator!=(Scalar const& rhs) const;
+
+private:
+    Limbs limbs_;
+};
+
+} // namespace chia
+
+#endif
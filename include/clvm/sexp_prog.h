@@ -63,6 +63,11 @@ public:
 
     Bytes GetBytes() const;
 
+    /// The storage of the atom, it is valid as long as the atom lives
+    uint8_t const* GetData() const { return bytes_.data(); }
+
+    std::size_t GetSize() const { return bytes_.size(); }
+
     bool IsNeg() const { return neg_; }
 
     std::string AsString() const;
@@ -83,6 +88,9 @@ class CLVMObject_Pair : public CLVMObject
 public:
     CLVMObject_Pair(CLVMObjectPtr first, CLVMObjectPtr rest, NodeType type);
 
+    /// Long lists and deep trees are released without recursion
+    ~CLVMObject_Pair() override;
+
     CLVMObjectPtr GetFirstNode() const;
 
     CLVMObjectPtr GetRestNode() const;
@@ -206,6 +214,16 @@ public:
 
     Bytes Next() { return ToBytes(NextCLVMObj()); }
 
+    /// The next atom without copying its bytes, the atom is owned by the list passed to this iterator
+    CLVMObject_Atom const& NextAtom()
+    {
+        auto n = NextCLVMObj();
+        if (!IsAtom(n)) {
+            throw std::runtime_error("it's not an ATOM");
+        }
+        return static_cast<CLVMObject_Atom const&>(*n);
+    }
+
     CLVMObjectPtr NextCLVMObj()
     {
         CLVMObjectPtr a, n;
@@ -281,17 +299,86 @@ using ReadStreamFunc = std::function<Bytes(int size)>;
 
 CLVMObjectPtr SExpFromStream(ReadStreamFunc f);
 
+using WriteStreamFunc = std::function<void(uint8_t const* data, std::size_t size)>;
+
+/// Serialize the sexp into the stream function, the small atoms are collected into chunks of a few KB before they are
+/// written and the whole serialization is never held in memory
+void SExpToStream(CLVMObjectPtr const& sexp, WriteStreamFunc const& f);
+
+/// Parse a serialized sexp straight from the buffer, the number of bytes it takes is written to `consumed`
+CLVMObjectPtr SExpFromBuffer(uint8_t const* data, std::size_t size, std::size_t* consumed = nullptr);
+
+/// The number of bytes of the serialized sexp at the start of the buffer, the sexp is walked without making nodes
+std::size_t SerializedLength(uint8_t const* data, std::size_t size);
+
+/// The tree hash of the serialized sexp at the start of the buffer, the same as `Program::GetTreeHash` but no node is
+/// made
+Bytes32 TreeHashFromBytes(uint8_t const* data, std::size_t size, std::size_t* consumed = nullptr);
+
+/// Parse a serialized sexp which may contain back references (0xFE followed by a path atom), a node which is referenced
+/// more than once is shared
+CLVMObjectPtr SExpFromBufferWithBackrefs(uint8_t const* data, std::size_t size, std::size_t* consumed = nullptr);
+
+/// Serialize the sexp and replace the repeated subtrees with back references when it makes the result shorter
+Bytes SExpToBytesWithBackrefs(CLVMObjectPtr sexp);
+
+/**
+ * Parse a serialized sexp from chunks as they arrive
+ *
+ * The state is kept between the calls of `Feed`, an atom split across chunks is completed by the next chunk. The
+ * limits are checked while the bytes arrive, a sexp larger than `max_size` bytes or nested deeper than `max_depth`
+ * pairs is stopped without reading the rest, 0 is no limit.
+ */
+class SExpParser
+{
+public:
+    enum class Status { NEED_MORE, DONE, ERROR };
+
+    explicit SExpParser(std::size_t max_size = 0, std::size_t max_depth = 0);
+
+    ~SExpParser();
+
+    /// Parse the next chunk, the bytes after the end of the sexp are not consumed, see `GetConsumed`
+    Status Feed(uint8_t const* data, std::size_t size);
+
+    Status GetStatus() const;
+
+    /// The sexp once the status is DONE
+    CLVMObjectPtr GetResult() const;
+
+    std::string const& GetError() const;
+
+    /// The number of bytes consumed by the last call of `Feed`
+    std::size_t GetConsumed() const;
+
+    /// The number of bytes consumed since the parser is created or reset
+    std::size_t GetTotalSize() const;
+
+    void Reset();
+
+private:
+    struct Impl;
+    std::unique_ptr<Impl> m_pimpl;
+};
+
 class Program
 {
 public:
     static Program ImportFromBytes(Bytes const& bytes);
 
+    static Program ImportFromBytesWithBackrefs(Bytes const& bytes);
+
     static Program ImportFromHex(std::string hex);
 
     static Program ImportFromCompiledFile(std::string file_path);
 
     static Program ImportFromAssemble(std::string str);
 
+    enum class FileFormat { BINARY, HEX };
+
+    /// Load a serialized program from a file, the file is memory-mapped and parsed in place unless `use_mmap` is false
+    static Program ImportFromFile(std::string const& file_path, FileFormat format = FileFormat::BINARY, bool use_mmap = true);
+
     explicit Program(CLVMObjectPtr sexp);
 
     Program(Program const& rhs) = default;
@@ -308,7 +395,12 @@ public:
 
     Bytes Serialize() const;
 
-    std::tuple<Cost, CLVMObjectPtr> Run(CLVMObjectPtr args = MakeNull()) const;
+    void Serialize(WriteStreamFunc const& f) const;
+
+    Bytes SerializeWithBackrefs() const;
+
+    /// Run the program with the arguments, a `max_cost` of 0 is no limit
+    std::tuple<Cost, CLVMObjectPtr> Run(CLVMObjectPtr args = MakeNull(), Cost max_cost = 0) const;
 
     Program Curry(CLVMObjectPtr args);
 
@@ -0,0 +1,58 @@
+#ifndef CHIA_THREAD_POOL_H
+#define CHIA_THREAD_POOL_H
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace chia
+{
+
+class ThreadPool
+{
+public:
+    using Task = std::function<void()>;
+
+    /// The shared pool, it runs one thread per hardware thread
+    static ThreadPool& GetInstance();
+
+    /// Create a pool with `num_threads` workers, 0 means one per hardware thread
+    explicit ThreadPool(int num_threads = 0);
+
+    ~ThreadPool();
+
+    ThreadPool(ThreadPool const&) = delete;
+
+    ThreadPool& operator=(ThreadPool const&) = delete;
+
+    int GetNumThreads() const { return static_cast<int>(threads_.size()); }
+
+    /**
+     * Call `f(i)` for every i in [0, count) on the pool and the calling thread, returns after all calls are done
+     *
+     * @param count The number of indices
+     * @param f The function will be called for each index, the first exception thrown by it is rethrown here
+     * @param max_threads The maximum number of threads work on the indices, 0 means no limit
+     */
+    void ParallelFor(std::size_t count, std::function<void(std::size_t)> const& f, int max_threads = 0);
+
+private:
+    void Worker();
+
+    bool RunPendingTask();
+
+private:
+    std::vector<std::thread> threads_;
+    std::mutex mtx_;
+    std::condition_variable cv_;
+    std::deque<Task> tasks_;
+    bool stop_ { false };
+};
+
+} // namespace chia
+
+#endif
@@ -3,451 +3,421 @@
 #include <cctype>
 
 #include <algorithm>
-#include <optional>
+#include <array>
+#include <sstream>
 #include <string>
 #include <tuple>
+#include <unordered_map>
+#include <vector>
 
 #include "clvm_utils.h"
+#include "int.h"
 #include "operator_lookup.h"
 #include "sexp_prog.h"
 
-#define CONS chia::types::Type::GetInstance().ToType("CONS")
-#define NIL chia::types::Type::GetInstance().ToType("NULL")
-#define INT chia::types::Type::GetInstance().ToType("INT")
-#define HEX chia::types::Type::GetInstance().ToType("HEX")
-#define QUOTES chia::types::Type::GetInstance().ToType("QUOTES")
-#define DOUBLE_QUOTE chia::types::Type::GetInstance().ToType("DOUBLE_QUOTE")
-#define SINGLE_QUOTE chia::types::Type::GetInstance().ToType("SINGLE_QUOTE")
-#define SYMBOL chia::types::Type::GetInstance().ToType("SYMBOL")
-#define OPERATOR chia::types::Type::GetInstance().ToType("OPERATOR")
-#define CODE chia::types::Type::GetInstance().ToType("CODE")
-#define NODE chia::types::Type::GetInstance().ToType("NODE")
-
 namespace chia
 {
 
 namespace stream
 {
 
-bool CharIn(char ch, std::string s)
-{
-    for (char c : s) {
-        if (c == ch) {
-            return true;
-        }
-    }
-    return false;
-}
-
-std::string CharToStr(char ch)
-{
-    std::string res;
-    res.resize(1);
-    res[0] = ch;
-    return res;
-}
-
+/// Splits the source into tokens, the tokens are views into the source so nothing is copied
 class TokenStream
 {
 public:
-    explicit TokenStream(std::string s)
+    explicit TokenStream(std::string_view s)
         : str_(s)
     {
     }
 
-    std::tuple<std::string, int> Next()
+    /// Read the next token, an empty token is returned at the end of the source
+    std::string_view Next(std::size_t& offset)
     {
-        offset_ = ConsumeWhiteSpace(str_, offset_);
+        ConsumeWhiteSpace();
+        offset = offset_;
         if (offset_ >= str_.size()) {
-            return std::make_tuple("", static_cast<int>(str_.size()));
+            return {};
         }
         char c = str_[offset_];
-        if (CharIn(c, "(.)")) {
-            int off { offset_ };
-            ++offset_;
-            return std::make_tuple(CharToStr(c), off);
+        if (c == '(' || c == '.' || c == ')') {
+            return str_.substr(offset_++, 1);
         }
-        if (CharIn(c, "\"'")) {
-            int start { offset_ };
-            char initial_c = str_[start];
-            ++offset_;
-            while (offset_ < str_.size() && str_[offset_] != initial_c) {
-                ++offset_;
-            }
-            if (offset_ < str_.size()) {
-                ++offset_;
-                return std::make_tuple(std::string(str_.substr(start, offset_ - start)), start);
-            } else {
+        if (c == '"' || c == '\'') {
+            std::size_t end = str_.find(c, offset_ + 1);
+            if (end == std::string_view::npos) {
                 throw std::runtime_error("unterminated string starting");
             }
+            offset_ = end + 1;
+            return str_.substr(offset, offset_ - offset);
+        }
+        while (offset_ < str_.size() && !IsSpace(str_[offset_]) && str_[offset_] != ')') {
+            ++offset_;
         }
-        std::string token;
-        int end_offset;
-        std::tie(token, end_offset) = ConsumeUntilWhiteSpace(str_, offset_);
-        int off { offset_ };
-        offset_ = end_offset;
-        return std::make_tuple(token, off);
+        return str_.substr(offset, offset_ - offset);
     }
 
 private:
-    static int ConsumeWhiteSpace(std::string s, int offset)
+    static bool IsSpace(char ch) { return std::isspace(static_cast<unsigned char>(ch)) != 0; }
+
+    void ConsumeWhiteSpace()
     {
         while (1) {
-            while (offset < s.size() && std::isspace(s[offset])) {
-                ++offset;
+            while (offset_ < str_.size() && IsSpace(str_[offset_])) {
+                ++offset_;
             }
-            if (offset >= s.size() || s[offset] != ';') {
+            if (offset_ >= str_.size() || str_[offset_] != ';') {
                 break;
             }
-            while (offset < s.size() && !CharIn(s[offset], "\n\r")) {
-                ++offset;
+            while (offset_ < str_.size() && str_[offset_] != '\n' && str_[offset_] != '\r') {
+                ++offset_;
             }
         }
-        return offset;
-    }
-
-    static std::tuple<std::string, int> ConsumeUntilWhiteSpace(std::string s, int offset)
-    {
-        int start { offset };
-        while (offset < s.size() && !std::isspace(s[offset]) && s[offset] != ')') {
-            ++offset;
-        }
-        return std::make_tuple(std::string(s.substr(start, offset - start)), offset);
     }
 
 private:
-    int offset_ { 0 };
-    std::string str_;
+    std::size_t offset_ { 0 };
+    std::string_view str_;
 };
 
 } // namespace stream
 
-namespace types
+namespace assemble
 {
 
-class Type
-{
-public:
-    static Type& GetInstance()
-    {
-        static Type instance("CONS", "NULL", "INT", "HEX", "QUOTES", "DOUBLE_QUOTE", "SINGLE_QUOTE", "SYMBOL",
-            "OPERATOR", "CODE", "NODE");
-        return instance;
-    }
-
-    static Int ToType(std::string type_name) { return Int(utils::StrToBytes(type_name)); }
-
-    void Add(std::string type_name) { types_.push_back(ToType(type_name)); }
+enum class Type { INT, HEX, DOUBLE_QUOTE, SINGLE_QUOTE, SYMBOL };
 
-    void AddTypes() { }
-
-    template <typename T, typename... Ts> void AddTypes(T&& val, Ts&&... others)
-    {
-        types_.push_back(ToType(std::forward<T>(val)));
-        AddTypes(std::forward<Ts>(others)...);
+bool IsDigits(std::string_view s, bool hex)
+{
+    if (s.empty()) {
+        return false;
     }
-
-    template <typename... T> Type(T&&... vals) { AddTypes(std::forward<T>(vals)...); }
-
-    bool Available(Int const& type) const
-    {
-        auto i = std::find(std::begin(types_), std::end(types_), type);
-        return i != std::end(types_);
+    for (char ch : s) {
+        if (!std::isdigit(static_cast<unsigned char>(ch)) && !(hex && std::isxdigit(static_cast<unsigned char>(ch)))) {
+            return false;
+        }
     }
+    return true;
+}
 
-    Int GetType(std::string type_name) const { return ToType(type_name); }
-
-private:
-    std::vector<Int> types_;
-};
-
-} // namespace types
-
-CLVMObjectPtr ir_as_atom(CLVMObjectPtr ir_sexp);
+bool HasHexPrefix(std::string_view token) { return token.size() >= 2 && token[0] == '0' && (token[1] == 'x' || token[1] == 'X'); }
 
-template <typename Type, typename Val> CLVMObjectPtr ir_new(Type&& type, Val&& val, std::optional<int> offset = {})
+Type TypeOfToken(std::string_view token)
 {
-    CLVMObjectPtr first;
-    if (offset) {
-        first = ToSExpPair(std::forward<Type>(type), *offset);
-    } else {
-        first = ToSExp(std::forward<Type>(type));
+    std::string_view number = token;
+    if (!number.empty() && (number[0] == '+' || number[0] == '-')) {
+        number.remove_prefix(1);
     }
-    return ToSExpPair(first, std::forward<Val>(val));
-}
-
-CLVMObjectPtr ir_cons(CLVMObjectPtr first, CLVMObjectPtr rest, std::optional<int> offset)
-{
-    if (!first) {
-        throw std::runtime_error("cons null on first place");
+    if (HasHexPrefix(number) ? IsDigits(number.substr(2), true) : IsDigits(number, false)) {
+        return Type::INT;
     }
-    if (!rest) {
-        throw std::runtime_error("cons null on rest place");
+    if (HasHexPrefix(token)) {
+        return Type::HEX;
     }
-    return ir_new(CONS, ir_new(first, rest), offset);
-}
-
-CLVMObjectPtr ir_null() { return ir_new(NIL, MakeNull()); }
-
-CLVMObjectPtr ir_list() { return ir_null(); }
-
-template <typename T, typename... N> CLVMObjectPtr ir_list(T&& first, N&&... items)
-{
-    return ir_cons(std::forward<T>(first), ir_cons(std::forward<N>(items)...));
-}
-
-Int ir_type(CLVMObjectPtr ir_sexp)
-{
-    auto the_type = First(ir_sexp);
-    if (ListP(the_type)) {
-        the_type = First(the_type);
+    if (token.size() >= 2 && token[0] == '"') {
+        return Type::DOUBLE_QUOTE;
+    }
+    if (token.size() >= 2 && token[0] == '\'') {
+        return Type::SINGLE_QUOTE;
     }
-    return Int(ToBytes(the_type));
+    return Type::SYMBOL;
 }
 
-Int ir_as_int(CLVMObjectPtr ir_sexp)
+/// The keywords of the operators, the lowest atom wins when a keyword belongs to more than one atom
+std::unordered_map<std::string, uint8_t> const& Keywords()
 {
-    auto atom_p = std::static_pointer_cast<CLVMObject_Atom>(ir_as_atom(ir_sexp));
-    return atom_p->AsInt();
+    static std::unordered_map<std::string, uint8_t> const keywords = []() {
+        std::unordered_map<std::string, uint8_t> keywords;
+        OperatorLookup lookup;
+        for (int atom = 0; atom <= 0xff; ++atom) {
+            try {
+                for (auto const& keyword : lookup.AtomToKeywords(static_cast<uint8_t>(atom))) {
+                    keywords.emplace(keyword, static_cast<uint8_t>(atom));
+                }
+            } catch (std::exception const&) {
+                // No keyword for the atom
+            }
+        }
+        return keywords;
+    }();
+    return keywords;
 }
 
-Int ir_offset(CLVMObjectPtr ir_sexp)
+CLVMObjectPtr AtomFromToken(std::string_view token)
 {
-    auto the_offset = First(ir_sexp);
-    if (ListP(the_offset)) {
-        return Int(ToBytes(Rest(the_offset)));
-    } else {
-        return Int(utils::ByteToBytes('\xff'));
+    switch (TypeOfToken(token)) {
+    case Type::INT:
+        if (token[0] == '+') {
+            token.remove_prefix(1);
+        }
+        return ToSExp(Int(std::string(token), 0));
+    case Type::HEX: {
+        std::string hex;
+        hex.reserve(token.size() - 1);
+        if (token.size() % 2 == 1) {
+            hex.push_back('0');
+        }
+        hex.append(token.substr(2));
+        try {
+            return ToSExp(utils::BytesFromHex(hex));
+        } catch (std::exception const&) {
+            // The token cannot be parsed into bytes, it is a symbol
+        }
+        break;
     }
-}
-
-CLVMObjectPtr ir_val(CLVMObjectPtr ir_sexp) { return Rest(ir_sexp); }
-
-bool ir_nullp(CLVMObjectPtr ir_sexp) { return ir_type(ir_sexp) == NIL; }
-
-bool ir_listp(CLVMObjectPtr ir_sexp) { return ir_type(ir_sexp) == CONS; }
-
-CLVMObjectPtr ir_first(CLVMObjectPtr ir_sexp) { return First(Rest(ir_sexp)); }
-
-CLVMObjectPtr ir_rest(CLVMObjectPtr ir_sexp) { return Rest(Rest(ir_sexp)); }
-
-CLVMObjectPtr ir_as_sexp(CLVMObjectPtr ir_sexp)
-{
-    if (ir_nullp(ir_sexp)) {
-        return ToSExpList();
+    case Type::DOUBLE_QUOTE:
+    case Type::SINGLE_QUOTE:
+        return ToSExp(std::string(token.substr(1, token.size() - 2)));
+    case Type::SYMBOL:
+        break;
     }
-    if (ir_type(ir_sexp) == CONS) {
-        return ToSExpPair(ir_as_sexp(ir_first(ir_sexp)), ir_as_sexp(ir_rest(ir_sexp)));
+    std::string_view keyword = token;
+    if (keyword[0] == '#') {
+        keyword.remove_prefix(1);
     }
-    return Rest(ir_sexp);
-}
-
-bool ir_is_atom(CLVMObjectPtr ir_sexp) { return !ir_listp(ir_sexp); }
-
-CLVMObjectPtr ir_as_atom(CLVMObjectPtr ir_sexp)
-{
-    if (!ir_is_atom(ir_sexp)) {
-        throw std::runtime_error("ir is not an atom");
+    auto const& keywords = Keywords();
+    auto i = keywords.find(std::string(keyword));
+    if (i != std::end(keywords)) {
+        return ToSExp(utils::ByteToBytes(i->second));
     }
-    return Rest(ir_sexp);
+    return ToSExp(std::string(token));
 }
 
-CLVMObjectPtr ir_symbol(std::string symbol) { return ToSExpPair(SYMBOL, symbol); }
+/// A list which is being read, the items are linked when the closing bracket is reached
+struct Frame {
+    std::vector<CLVMObjectPtr> items;
+    CLVMObjectPtr tail;
+    bool after_dot { false };
+};
 
-std::optional<std::string> ir_as_symbol(CLVMObjectPtr ir_sexp)
+CLVMObjectPtr CloseFrame(Frame& frame)
 {
-    if (ListP(ir_sexp) && ir_type(ir_sexp) == SYMBOL) {
-        auto atom = std::static_pointer_cast<CLVMObject_Atom>(ir_as_sexp(ir_sexp));
-        return atom->AsString();
+    CLVMObjectPtr res = frame.tail ? frame.tail : MakeNull();
+    for (auto i = frame.items.rbegin(); i != frame.items.rend(); ++i) {
+        res = ToSExpPair(*i, res);
     }
-    return {};
+    return res;
 }
 
-bool is_ir(CLVMObjectPtr sexp)
+std::string_view NextConsToken(stream::TokenStream& stream)
 {
-    if (IsAtom(sexp)) {
-        return false;
+    std::size_t offset;
+    auto token = stream.Next(offset);
+    if (token.empty()) {
+        throw std::runtime_error("missing )");
     }
+    return token;
+}
 
-    CLVMObjectPtr type_sexp, val_sexp;
-    std::tie(type_sexp, val_sexp) = Pair(sexp);
-    auto the_type = Int(ToBytes(type_sexp));
-    if (!types::Type::GetInstance().Available(the_type)) {
-        return false;
-    }
+} // namespace assemble
 
-    if (the_type == CONS) {
-        if (IsNull(val_sexp)) {
-            return true;
+CLVMObjectPtr Assemble(std::string_view str)
+{
+    stream::TokenStream stream(str);
+    std::size_t offset;
+    std::string_view token = stream.Next(offset);
+    if (token.empty()) {
+        throw std::runtime_error("unexpected end of stream");
+    }
+
+    // An explicit stack of the open lists, deeply nested sources don't exhaust the call stack
+    std::vector<assemble::Frame> frames;
+    while (1) {
+        CLVMObjectPtr value;
+        if (token == "(") {
+            frames.emplace_back();
+            token = assemble::NextConsToken(stream);
+            if (token != ")") {
+                // The first item of the list, a dot here is a symbol
+                continue;
+            }
+            value = MakeNull();
+            frames.pop_back();
+        } else {
+            value = assemble::AtomFromToken(token);
         }
-        if (IsPair(val_sexp)) {
-            return is_ir(First(val_sexp)) && is_ir(Rest(val_sexp));
+
+        // Pass the value up to the enclosing lists until one of them needs more tokens
+        while (1) {
+            if (frames.empty()) {
+                return value;
+            }
+            auto& frame = frames.back();
+            if (frame.after_dot) {
+                frame.tail = value;
+                if (assemble::NextConsToken(stream) != ")") {
+                    throw std::runtime_error("illegal dot expression");
+                }
+            } else {
+                frame.items.push_back(std::move(value));
+                token = assemble::NextConsToken(stream);
+                if (token == ".") {
+                    frame.after_dot = true;
+                    token = assemble::NextConsToken(stream);
+                    break;
+                }
+                if (token != ")") {
+                    break;
+                }
+            }
+            value = assemble::CloseFrame(frame);
+            frames.pop_back();
         }
-        return false;
     }
-
-    return IsAtom(val_sexp);
 }
 
-std::tuple<std::string, int> next_cons_token(stream::TokenStream& stream)
+namespace disassemble
 {
-    std::string token;
-    int offset;
-    std::tie(token, offset) = stream.Next();
-    if (token.empty()) {
-        throw std::runtime_error("missing )");
-    }
-    return std::make_tuple(token, offset);
-}
 
-CLVMObjectPtr tokenize_int(std::string token, int offset)
+/// The keywords of the single byte atoms as they are written in clvm source, "add" is written as "+"
+std::array<std::string, 256> const& Keywords()
 {
-    if (Int::IsValidNumberStr(token)) {
-        return ir_new(INT, Int(token, 0), offset);
-    }
-    return {};
+    static std::array<std::string, 256> const keywords = []() {
+        std::array<std::string, 256> keywords;
+        OperatorLookup lookup;
+        for (int atom = 0; atom <= 0xff; ++atom) {
+            try {
+                std::string keyword = lookup.AtomToKeywords(static_cast<uint8_t>(atom)).back();
+                if (keyword != ".") {
+                    keywords[atom] = std::move(keyword);
+                }
+            } catch (std::exception const&) {
+                // No keyword for the atom
+            }
+        }
+        return keywords;
+    }();
+    return keywords;
 }
 
-CLVMObjectPtr tokenize_hex(std::string token, int offset)
+/// The characters of python's `string.printable`
+bool IsPrintable(uint8_t ch) { return (ch >= 0x20 && ch <= 0x7e) || (ch >= 0x09 && ch <= 0x0d); }
+
+void WriteHex(Bytes const& bytes, std::ostream& out)
 {
-    if (utils::ToUpper(token.substr(0, 2)) == "0X") {
-        std::string hex { token.substr(2) };
-        if (hex.size() % 2 == 1) {
-            hex.insert(std::begin(hex), '0');
-        }
-        try {
-            return ir_new(HEX, utils::BytesFromHex(hex), offset);
-        } catch (std::exception const&) {
-            // The token cannot be parsed into bytes
+    static char const HEX_CHARS[] = "0123456789abcdef";
+    char buf[256];
+    std::size_t n { 0 };
+    buf[n++] = '0';
+    buf[n++] = 'x';
+    for (uint8_t b : bytes) {
+        if (n + 2 > sizeof(buf)) {
+            out.write(buf, n);
+            n = 0;
         }
+        buf[n++] = HEX_CHARS[b >> 4];
+        buf[n++] = HEX_CHARS[b & 0x0f];
     }
-    return {};
+    out.write(buf, n);
 }
 
-CLVMObjectPtr tokenize_quotes(std::string token, int offset)
+/// Atoms with up to 2 bytes are ints when they are in the canonical signed encoding
+bool IsCanonicalSmallInt(Bytes const& bytes)
 {
-    if (token.size() < 2) {
-        return {};
+    if (bytes.empty() || bytes.size() > 2) {
+        return false;
     }
-    char c = token[0];
-    if (c != '\'' && c != '"') {
-        return {};
+    if (bytes.size() == 1) {
+        return bytes[0] != 0;
     }
-    auto q_type = c == '"' ? DOUBLE_QUOTE : SINGLE_QUOTE;
-    return ir_new(q_type, token.substr(1, token.size() - 2), offset);
+    return !(bytes[0] == 0x00 && (bytes[1] & 0x80) == 0) && !(bytes[0] == 0xff && (bytes[1] & 0x80) != 0);
 }
 
-CLVMObjectPtr tokenize_symbol(std::string token, int offset) { return ir_new(SYMBOL, token, offset); }
-
-CLVMObjectPtr tokenize_sexp(std::string token, int offset, stream::TokenStream& stream);
-
-CLVMObjectPtr tokenize_cons(std::string token, int offset, stream::TokenStream& stream)
+/// The empty atom which terminates a list
+bool IsNil(CLVMObjectPtr const& sexp)
 {
-    if (token == ")") {
-        return ir_new(NIL, MakeNull(), offset);
-    }
-
-    int initial_offset = offset;
-
-    auto first_sexp = tokenize_sexp(token, offset, stream);
-    CLVMObjectPtr rest_sexp;
-
-    std::tie(token, offset) = next_cons_token(stream);
-    if (token == ".") {
-        // grab the last item
-        std::tie(token, offset) = next_cons_token(stream);
-        rest_sexp = tokenize_sexp(token, offset, stream);
-        if (!rest_sexp) {
-            throw std::runtime_error("receive a null from tokenize_sexp");
-        }
-        std::tie(token, offset) = next_cons_token(stream);
-        if (token != ")") {
-            throw std::runtime_error("illegal dot expression");
-        }
-    } else {
-        rest_sexp = tokenize_cons(token, offset, stream);
-        if (!rest_sexp) {
-            throw std::runtime_error("tokenize_cons returns a null");
-        }
-    }
-    return ir_cons(first_sexp, rest_sexp, initial_offset);
+    auto atom = static_cast<CLVMObject_Atom*>(sexp.get());
+    return atom->GetBytes().empty() && !atom->IsNeg();
 }
 
-CLVMObjectPtr tokenize_sexp(std::string token, int offset, stream::TokenStream& stream)
+void WriteAtom(CLVMObjectPtr const& sexp, bool allow_keyword, std::ostream& out)
 {
-    if (token == "(") {
-        std::string token;
-        int offset;
-        std::tie(token, offset) = next_cons_token(stream);
-        return tokenize_cons(token, offset, stream);
-    }
-
-    auto funcs = { tokenize_int, tokenize_hex, tokenize_quotes, tokenize_symbol };
-    for (auto& f : funcs) {
-        auto r = f(token, offset);
-        if (r) {
-            return r;
+    auto atom = static_cast<CLVMObject_Atom*>(sexp.get());
+    Bytes const& bytes = atom->GetBytes();
+    if (allow_keyword && bytes.size() == 1 && !atom->IsNeg()) {
+        auto const& keyword = Keywords()[bytes[0]];
+        if (!keyword.empty()) {
+            out << keyword;
+            return;
         }
     }
-
-    throw std::runtime_error("cannot be tokenized");
-}
-
-CLVMObjectPtr assemble_from_ir(CLVMObjectPtr ir_sexp)
-{
-    auto keyword_opt = ir_as_symbol(ir_sexp);
-    if (keyword_opt) {
-        std::string keyword = *keyword_opt;
-        if (keyword[0] == '#') {
-            keyword = keyword.substr(1);
+    if (IsNil(sexp)) {
+        out << "()";
+        return;
+    }
+    if (sexp->GetNodeType() == NodeType::Atom_Int) {
+        out << atom->AsInt().ToString();
+        return;
+    }
+    if (bytes.size() > 2) {
+        bool printable = std::all_of(std::begin(bytes), std::end(bytes), IsPrintable);
+        if (printable && std::find(std::begin(bytes), std::end(bytes), '"') == std::end(bytes)) {
+            out << '"';
+            out.write(reinterpret_cast<char const*>(bytes.data()), bytes.size());
+            out << '"';
+            return;
         }
-        OperatorLookup lookup;
-        try {
-            uint8_t atom = lookup.KeywordToAtom(keyword);
-            return ToSExp(utils::ByteToBytes(atom));
-        } catch (std::exception const& e) {
-            return ir_val(ir_sexp);
+        if (printable && std::find(std::begin(bytes), std::end(bytes), '\'') == std::end(bytes)) {
+            out << '\'';
+            out.write(reinterpret_cast<char const*>(bytes.data()), bytes.size());
+            out << '\'';
+            return;
         }
-    }
-
-    if (!ir_listp(ir_sexp)) {
-        return ir_val(ir_sexp);
-    }
-
-    if (ir_nullp(ir_sexp)) {
-        return ToSExpList();
-    }
-
-    auto first = ir_first(ir_sexp);
-    keyword_opt = ir_as_symbol(first);
-    if (keyword_opt) {
-        auto keyword = *keyword_opt;
-        if (keyword == "q") {
-            // TODO note that any symbol is legal after this point
+    } else if (IsCanonicalSmallInt(bytes)) {
+        int val = static_cast<int8_t>(bytes[0]);
+        if (bytes.size() == 2) {
+            val = val * 256 + bytes[1];
         }
+        out << val;
+        return;
     }
-
-    auto sexp_1 = assemble_from_ir(first);
-    auto sexp_2 = assemble_from_ir(ir_rest(ir_sexp));
-    return ToSExpPair(sexp_1, sexp_2);
+    WriteHex(bytes, out);
 }
 
-CLVMObjectPtr read_ir(std::string str)
+} // namespace disassemble
+
+void Disassemble(CLVMObjectPtr sexp, std::ostream& out)
 {
-    stream::TokenStream s(str);
-    std::string token;
-    int offset;
-    std::tie(token, offset) = s.Next();
-    while (!token.empty()) {
-        return tokenize_sexp(token, offset, s);
+    enum class Kind {
+        VALUE, // an item of a list or the root
+        HEAD, // the first item of a list, an atom here is written as a keyword
+        REST, // the rest of a list after an item
+    };
+    std::vector<std::pair<CLVMObjectPtr, Kind>> todo;
+    todo.emplace_back(std::move(sexp), Kind::VALUE);
+    while (!todo.empty()) {
+        CLVMObjectPtr node;
+        Kind kind;
+        std::tie(node, kind) = std::move(todo.back());
+        todo.pop_back();
+        if (kind == Kind::REST) {
+            if (IsPair(node)) {
+                out << ' ';
+                todo.emplace_back(Rest(node), Kind::REST);
+                todo.emplace_back(First(node), Kind::VALUE);
+            } else if (disassemble::IsNil(node)) {
+                out << ')';
+            } else {
+                out << " . ";
+                disassemble::WriteAtom(node, false, out);
+                out << ')';
+            }
+        } else if (IsPair(node)) {
+            out << '(';
+            todo.emplace_back(Rest(node), Kind::REST);
+            todo.emplace_back(First(node), Kind::HEAD);
+        } else {
+            disassemble::WriteAtom(node, kind == Kind::HEAD, out);
+        }
     }
-    throw std::runtime_error("unexpected end of stream");
 }
 
-CLVMObjectPtr Assemble(std::string str)
+void Disassemble(Program const& program, std::ostream& out) { Disassemble(program.GetSExp(), out); }
+
+std::string Disassemble(Program const& program)
 {
-    auto symbols = read_ir(str);
-    return assemble_from_ir(symbols);
+    std::ostringstream ss;
+    Disassemble(program, ss);
+    return ss.str();
 }
 
 } // namespace chia
@@ -0,0 +1,188 @@
+#include "batch_verifier.h"
+
+#include <react-native-bls-signatures/elements.hpp>
+#include <react-native-bls-signatures/schemes.hpp>
+
+#include <algorithm>
+#include <optional>
+
+#include "clvm_utils.h"
+#include "crypto_utils.h"
+#include "key.h"
+#include "thread_pool.h"
+
+namespace chia::wallet
+{
+
+namespace batch
+{
+
+/// A signature set with all elements parsed and validated
+struct ParsedSet {
+    std::vector<bls::G1Element> public_keys;
+    std::vector<Bytes> augmented_messages;
+    bls::G2Element signature;
+};
+
+std::optional<ParsedSet> parse_set(SignatureSet const& set)
+{
+    if (set.public_keys.size() != set.messages.size()) {
+        return {};
+    }
+    try {
+        ParsedSet parsed;
+        parsed.public_keys.reserve(set.public_keys.size());
+        parsed.augmented_messages.reserve(set.messages.size());
+        for (std::size_t i = 0; i < set.public_keys.size(); ++i) {
+            parsed.public_keys.push_back(
+                bls::G1Element::FromByteVector(utils::bytes_cast<Key::PUB_KEY_LEN>(set.public_keys[i])));
+            // The augmented scheme signs `public_key || message`
+            Bytes augmented_message(set.public_keys[i].begin(), set.public_keys[i].end());
+            augmented_message.insert(augmented_message.end(), set.messages[i].begin(), set.messages[i].end());
+            parsed.augmented_messages.push_back(std::move(augmented_message));
+        }
+        parsed.signature = bls::G2Element::FromByteVector(utils::bytes_cast<Key::SIG_LEN>(set.signature));
+        return parsed;
+    } catch (std::exception const&) {
+        return {};
+    }
+}
+
+bool verify_set(ParsedSet const& set)
+{
+    bls::CoreMPL core(bls::AugSchemeMPL::CIPHERSUITE_ID);
+    return core.AggregateVerify(set.public_keys, set.augmented_messages, set.signature);
+}
+
+bls::PrivateKey random_scalar()
+{
+    // 128 bits of randomness is enough for the weights, the value is always below the group order
+    Bytes bytes(Key::PRIV_KEY_LEN, 0);
+    crypto_utils::RandomBytes(bytes.data() + Key::PRIV_KEY_LEN / 2, Key::PRIV_KEY_LEN / 2);
+    bytes[Key::PRIV_KEY_LEN - 1] |= 1;
+    return bls::PrivateKey::FromByteVector(bytes);
+}
+
+/// Check `e(g1, sum(r_i * sig_i)) == prod(e(r_i * pk_ij, H(m_ij)))` for the sets with one multi-pairing
+bool verify_weighted(std::vector<ParsedSet const*> const& sets)
+{
+    if (sets.size() == 1) {
+        return verify_set(*sets[0]);
+    }
+    std::vector<bls::G1Element> public_keys;
+    std::vector<Bytes> messages;
+    bls::G2Element signature;
+    for (ParsedSet const* set : sets) {
+        auto r = random_scalar();
+        for (std::size_t i = 0; i < set->public_keys.size(); ++i) {
+            public_keys.push_back(set->public_keys[i] * r);
+            messages.push_back(set->augmented_messages[i]);
+        }
+        signature += set->signature * r;
+    }
+    bls::CoreMPL core(bls::AugSchemeMPL::CIPHERSUITE_ID);
+    return core.AggregateVerify(public_keys, messages, signature);
+}
+
+} // namespace batch
+
+BatchVerifier::BatchVerifier(int max_threads)
+    : BatchVerifier(ThreadPool::GetInstance(), max_threads)
+{
+}
+
+BatchVerifier::BatchVerifier(ThreadPool& pool, int max_threads)
+    : pool_(pool)
+    , max_threads_(max_threads)
+{
+}
+
+std::size_t BatchVerifier::Add(SignatureSet set)
+{
+    sets_.push_back(std::move(set));
+    return sets_.size() - 1;
+}
+
+std::size_t BatchVerifier::Add(
+    std::vector<PublicKey> public_keys, std::vector<Bytes> messages, Signature const& signature)
+{
+    return Add(SignatureSet { std::move(public_keys), std::move(messages), signature });
+}
+
+std::vector<bool> BatchVerifier::Verify() const { return Verify(true); }
+
+bool BatchVerifier::VerifyAll() const
+{
+    auto results = Verify(false);
+    return std::all_of(std::begin(results), std::end(results), [](bool valid) { return valid; });
+}
+
+std::vector<bool> BatchVerifier::Verify(bool find_invalid) const
+{
+    std::vector<std::optional<batch::ParsedSet>> parsed(sets_.size());
+    pool_.ParallelFor(
+        sets_.size(), [this, &parsed](std::size_t i) { parsed[i] = batch::parse_set(sets_[i]); }, max_threads_);
+
+    std::vector<bool> results(sets_.size(), false);
+    std::vector<std::size_t> indices;
+    for (std::size_t i = 0; i < parsed.size(); ++i) {
+        if (parsed[i].has_value()) {
+            indices.push_back(i);
+        } else if (!find_invalid) {
+            return results;
+        }
+    }
+    if (indices.empty()) {
+        return results;
+    }
+
+    // One chunk per thread, each chunk makes one multi-pairing
+    std::size_t num_chunks = pool_.GetNumThreads() + 1;
+    if (max_threads_ > 0) {
+        num_chunks = std::min<std::size_t>(num_chunks, max_threads_);
+    }
+    num_chunks = std::min(num_chunks, indices.size());
+    std::size_t chunk_size = (indices.size() + num_chunks - 1) / num_chunks;
+    num_chunks = (indices.size() + chunk_size - 1) / chunk_size;
+
+    std::vector<char> chunk_results(num_chunks, 0);
+    pool_.ParallelFor(
+        num_chunks,
+        [&](std::size_t c) {
+            std::size_t begin = c * chunk_size;
+            std::size_t end = std::min(begin + chunk_size, indices.size());
+            std::vector<batch::ParsedSet const*> chunk;
+            for (std::size_t i = begin; i < end; ++i) {
+                chunk.push_back(&parsed[indices[i]].value());
+            }
+            chunk_results[c] = batch::verify_weighted(chunk);
+        },
+        max_threads_);
+
+    // Fall back to per-set checks only for the chunks which failed
+    std::vector<std::size_t> recheck;
+    for (std::size_t c = 0; c < num_chunks; ++c) {
+        std::size_t begin = c * chunk_size;
+        std::size_t end = std::min(begin + chunk_size, indices.size());
+        for (std::size_t i = begin; i < end; ++i) {
+            if (chunk_results[c]) {
+                results[indices[i]] = true;
+            } else if (find_invalid && end - begin > 1) {
+                recheck.push_back(indices[i]);
+            }
+        }
+        if (!chunk_results[c] && !find_invalid) {
+            return results;
+        }
+    }
+    std::vector<char> recheck_results(recheck.size(), 0);
+    pool_.ParallelFor(
+        recheck.size(), [&](std::size_t i) { recheck_results[i] = batch::verify_set(parsed[recheck[i]].value()); },
+        max_threads_);
+    for (std::size_t i = 0; i < recheck.size(); ++i) {
+        results[recheck[i]] = recheck_results[i];
+    }
+    return results;
+}
+
+} // namespace chia::wallet
@@ -1,85 +1,151 @@
 #include "bech32.h"
 
-#include <sstream>
+#include <algorithm>
+#include <array>
+#include <stdexcept>
+#include <tuple>
 
-#include "clvm_utils.h"
+#include "thread_pool.h"
 
 namespace chia
 {
 namespace bech32
 {
 
-static std::string CHARSET = "qpzry9x8gf2tvdw0s3jn54khce6mua7l";
+static char const CHARSET[] = "qpzry9x8gf2tvdw0s3jn54khce6mua7l";
 
-static Int M { 0x2BC830A3 };
+static uint32_t const M = 0x2BC830A3;
 
-bool CharInCHARSET(char ch) { return CHARSET.find(ch) != std::string::npos; }
+static int const CHECKSUM_LEN = 6;
 
-uint8_t ByteFromCHARSET(char ch)
+/// Batches below this size are not worth the thread pool
+static std::size_t const PARALLEL_BATCH_SIZE = 256;
+
+/// The xor of the generators selected by the 5 bits shifted out of the checksum
+constexpr std::array<uint32_t, 32> MakePolymodTable()
 {
-    auto pos = CHARSET.find(ch);
-    if (pos == std::string::npos) {
-        throw std::runtime_error("Invalid character, it cannot be found from CHARSET");
+    uint32_t const generator[] = { 0x3B6A57B2, 0x26508E6D, 0x1EA119FA, 0x3D4233DD, 0x2A1462B3 };
+    std::array<uint32_t, 32> table {};
+    for (uint32_t top = 0; top < 32; ++top) {
+        for (int i = 0; i < 5; ++i) {
+            if ((top >> i) & 1) {
+                table[top] ^= generator[i];
+            }
+        }
     }
-    return static_cast<uint8_t>(pos);
+    return table;
 }
 
-Int Polymod(std::vector<Int> const& values)
+static constexpr std::array<uint32_t, 32> POLYMOD_TABLE = MakePolymodTable();
+
+/// The value of each character in CHARSET, -1 for the others
+constexpr std::array<int8_t, 128> MakeReverseCharset()
 {
-    Int generator[] = { Int(0x3B6A57B2), Int(0x26508E6D), Int(0x1EA119FA), Int(0x3D4233DD), Int(0x2A1462B3) };
-    Int chk { 1 };
-    for (Int value : values) {
-        Int top = chk >> 25;
-        chk = (chk & Int(0x1FFFFFF)) << 5 ^ value;
-        for (int i = 0; i < 5; ++i) {
-            chk ^= (((top >> i) & Int(1)) != Int(0)) ? generator[i] : Int(0);
-        }
+    std::array<int8_t, 128> rev {};
+    for (auto& v : rev) {
+        v = -1;
+    }
+    for (int8_t i = 0; i < 32; ++i) {
+        rev[static_cast<uint8_t>(CHARSET[i])] = i;
+    }
+    return rev;
+}
+
+static constexpr std::array<int8_t, 128> REVERSE_CHARSET = MakeReverseCharset();
+
+uint32_t Const(Encoding encoding) { return encoding == Encoding::BECH32M ? M : 1; }
+
+uint32_t PolymodStep(uint32_t chk, uint8_t value)
+{
+    uint32_t top = chk >> 25;
+    return ((chk & 0x1FFFFFF) << 5) ^ value ^ POLYMOD_TABLE[top];
+}
+
+/// The polymod of the expanded hrp without allocating it
+uint32_t PolymodHRP(std::string_view hrp)
+{
+    uint32_t chk = 1;
+    for (char x : hrp) {
+        chk = PolymodStep(chk, static_cast<uint8_t>(x) >> 5);
+    }
+    chk = PolymodStep(chk, 0);
+    for (char x : hrp) {
+        chk = PolymodStep(chk, static_cast<uint8_t>(x) & 31);
     }
     return chk;
 }
 
-std::vector<Int> HRPExpand(std::string_view hrp)
+uint32_t Polymod(uint8_t const* values, std::size_t num_values, uint32_t chk)
 {
-    std::vector<Int> res;
+    for (std::size_t i = 0; i < num_values; ++i) {
+        chk = PolymodStep(chk, values[i]);
+    }
+    return chk;
+}
+
+uint32_t Polymod(Symbols const& values) { return Polymod(values.data(), values.size()); }
+
+Symbols HRPExpand(std::string_view hrp)
+{
+    Symbols res;
+    res.reserve(hrp.size() * 2 + 1);
     for (char x : hrp) {
-        int xx = static_cast<int>(x) >> 5;
-        res.push_back(Int(xx));
+        res.push_back(static_cast<uint8_t>(x) >> 5);
     }
-    res.push_back(Int(0));
+    res.push_back(0);
     for (char x : hrp) {
-        int xx = static_cast<int>(x) & 31;
-        res.push_back(Int(xx));
+        res.push_back(static_cast<uint8_t>(x) & 31);
     }
     return res;
 }
 
-bool VerifyChecksum(std::string_view hrp, std::vector<Int> const& data)
+bool VerifyChecksum(std::string_view hrp, Symbols const& data, Encoding encoding)
 {
-    return Polymod(chia::utils::ConnectContainers(HRPExpand(hrp), data)) != Int(0);
+    return Polymod(data.data(), data.size(), PolymodHRP(hrp)) == Const(encoding);
 }
 
-std::vector<Int> CreateChecksum(std::string_view hrp, std::vector<Int> const& data)
+void AppendChecksum(std::string& out, std::string_view hrp, uint8_t const* data, std::size_t size, Encoding encoding)
 {
-    auto values = chia::utils::ConnectContainers(HRPExpand(hrp), data);
-    std::vector<Int> zeros { Int(0), Int(0), Int(0), Int(0), Int(0), Int(0) };
-    auto polymod = Polymod(chia::utils::ConnectContainers(values, zeros)) ^ M;
-    std::vector<Int> checksum;
-    for (int i = 0; i < 6; ++i) {
-        Int e = (polymod >> 5 * (5 - i)) & Int(31);
-        checksum.push_back(e);
+    uint32_t chk = Polymod(data, size, PolymodHRP(hrp));
+    for (int i = 0; i < CHECKSUM_LEN; ++i) {
+        chk = PolymodStep(chk, 0);
+    }
+    chk ^= Const(encoding);
+    for (int i = 0; i < CHECKSUM_LEN; ++i) {
+        out.push_back(CHARSET[(chk >> 5 * (5 - i)) & 31]);
+    }
+}
+
+Symbols CreateChecksum(std::string_view hrp, Symbols const& data, Encoding encoding)
+{
+    std::string chars;
+    AppendChecksum(chars, hrp, data.data(), data.size(), encoding);
+    Symbols checksum;
+    for (char ch : chars) {
+        checksum.push_back(static_cast<uint8_t>(REVERSE_CHARSET[static_cast<uint8_t>(ch)]));
     }
     return checksum;
 }
 
-std::string Encode(std::string_view hrp, std::vector<Int> const& data)
+std::string EncodeSymbols(std::string_view hrp, uint8_t const* data, std::size_t size, Encoding encoding)
 {
-    auto combined = chia::utils::ConnectContainers(data, CreateChecksum(hrp, data));
-    std::stringstream ss;
-    ss << hrp << "1";
-    for (auto d : combined) {
-        ss << CHARSET[d.ToInt()];
+    std::string res;
+    res.reserve(hrp.size() + 1 + size + CHECKSUM_LEN);
+    res.append(hrp);
+    res.push_back('1');
+    for (std::size_t i = 0; i < size; ++i) {
+        if (data[i] >> 5) {
+            throw std::runtime_error("Invalid Value");
+        }
+        res.push_back(CHARSET[data[i]]);
     }
-    return ss.str();
+    AppendChecksum(res, hrp, data, size, encoding);
+    return res;
+}
+
+std::string Encode(std::string_view hrp, Symbols const& data, Encoding encoding)
+{
+    return EncodeSymbols(hrp, data.data(), data.size(), encoding);
 }
 
 std::string Strip(std::string_view str, char strip_ch)
@@ -91,81 +157,129 @@ std::string Strip(std::string_view str, char strip_ch)
     return std::string(first, last);
 }
 
-std::pair<std::string, std::vector<Int>> Decode(std::string_view bech_in, int max_length)
+std::pair<std::string, Symbols> Decode(std::string_view bech_in, int max_length, Encoding encoding)
 {
     std::string bech = Strip(bech_in);
-    for (auto ch : bech) {
+    bool has_lower { false }, has_upper { false };
+    for (auto& ch : bech) {
         if (ch < 33 || ch > 126) {
-            return std::make_pair("", std::vector<Int> {});
+            return std::make_pair("", Symbols {});
+        }
+        if (ch >= 'a' && ch <= 'z') {
+            has_lower = true;
+        } else if (ch >= 'A' && ch <= 'Z') {
+            has_upper = true;
+            ch = static_cast<char>(ch - 'A' + 'a');
         }
     }
-    if (chia::utils::ToLower(bech) != bech && chia::utils::ToUpper(bech) != bech) {
-        return std::make_pair("", std::vector<Int> {});
+    if (has_lower && has_upper) {
+        return std::make_pair("", Symbols {});
     }
-    bech = utils::ToLower(bech);
-    auto pos = bech.find_last_of("1");
-    if (pos == std::string::npos || pos < 1 || pos + 7 > bech.size() || bech.size() > max_length) {
-        return std::make_pair("", std::vector<Int> {});
+    auto pos = bech.find_last_of('1');
+    if (pos == std::string::npos || pos < 1 || pos + 7 > bech.size() || bech.size() > static_cast<std::size_t>(max_length)) {
+        return std::make_pair("", Symbols {});
     }
+    Symbols data;
+    data.reserve(bech.size() - pos - 1);
     for (auto i = std::cbegin(bech) + pos + 1; i != std::cend(bech); ++i) {
-        if (!CharInCHARSET(*i)) {
-            return std::make_pair("", std::vector<Int> {});
+        int8_t value = REVERSE_CHARSET[static_cast<uint8_t>(*i)];
+        if (value < 0) {
+            return std::make_pair("", Symbols {});
         }
+        data.push_back(static_cast<uint8_t>(value));
     }
     std::string hrp = bech.substr(0, pos);
-    std::vector<Int> data;
-    for (auto i = std::cbegin(bech) + pos + 1; i != std::cend(bech); ++i) {
-        data.push_back(Int(static_cast<uint32_t>(ByteFromCHARSET(*i))));
-    }
-    if (!VerifyChecksum(hrp, data)) {
-        return std::make_pair("", std::vector<Int> {});
+    if (!VerifyChecksum(hrp, data, encoding)) {
+        return std::make_pair("", Symbols {});
     }
+    data.resize(data.size() - CHECKSUM_LEN);
     return std::make_pair(hrp, data);
 }
 
-std::vector<Int> ConvertBits(std::vector<Int> const& data, int frombits, int tobits, bool pad)
+Bytes ConvertBits(uint8_t const* data, std::size_t size, int frombits, int tobits, bool pad)
 {
-    Int acc { 0 }, bits { 0 };
-    std::vector<Int> ret;
-    Int maxv = (Int(1) << tobits) - Int(1);
-    Int max_acc = (Int(1) << (frombits + tobits - 1)) - Int(1);
-    for (Int value : data) {
-        if (value < Int(0) || (value >> frombits) != Int(0)) {
+    uint32_t acc { 0 };
+    int bits { 0 };
+    Bytes ret;
+    ret.reserve((size * frombits + tobits - 1) / tobits);
+    uint32_t maxv = (1u << tobits) - 1;
+    uint32_t max_acc = (1u << (frombits + tobits - 1)) - 1;
+    for (std::size_t i = 0; i < size; ++i) {
+        uint32_t value = data[i];
+        if ((value >> frombits) != 0) {
             throw std::runtime_error("Invalid Value");
         }
         acc = ((acc << frombits) | value) & max_acc;
-        bits += Int(frombits);
-        while (bits >= Int(tobits)) {
-            bits -= Int(tobits);
-            ret.push_back((acc >> bits.ToInt()) & maxv);
+        bits += frombits;
+        while (bits >= tobits) {
+            bits -= tobits;
+            ret.push_back(static_cast<uint8_t>((acc >> bits) & maxv));
         }
     }
     if (pad) {
-        if (bits != Int(0)) {
-            ret.push_back((acc << (Int(tobits) - bits).ToInt()) & maxv);
-        } else if (bits >= Int(frombits) || ((acc << (Int(tobits) - bits).ToInt()) & maxv) != Int(0)) {
-            throw std::runtime_error("Invalid bits");
+        if (bits != 0) {
+            ret.push_back(static_cast<uint8_t>((acc << (tobits - bits)) & maxv));
         }
+    } else if (bits >= frombits || ((acc << (tobits - bits)) & maxv) != 0) {
+        throw std::runtime_error("Invalid bits");
     }
     return ret;
 }
 
-std::string EncodePuzzleHash(std::vector<Int> const& puzzle_hash, std::string_view prefix)
+Bytes ConvertBits(Bytes const& data, int frombits, int tobits, bool pad)
+{
+    return ConvertBits(data.data(), data.size(), frombits, tobits, pad);
+}
+
+std::string EncodePuzzleHash(Bytes32 const& puzzle_hash, std::string_view prefix)
 {
-    return Encode(prefix, ConvertBits(puzzle_hash, 8, 5));
+    auto data = ConvertBits(puzzle_hash.data(), puzzle_hash.size(), 8, 5);
+    return EncodeSymbols(prefix, data.data(), data.size(), Encoding::BECH32M);
 }
 
-std::vector<Int> DecodePuzzleHash(std::string_view address)
+Bytes32 DecodePuzzleHash(std::string_view address)
 {
     std::string hrp;
-    std::vector<Int> data;
+    Symbols data;
     std::tie(hrp, data) = Decode(address);
-    if (data.empty()) {
+    if (hrp.empty()) {
         throw std::runtime_error("Invalid address");
     }
-    std::vector<Int> decoded = ConvertBits(data, 5, 8, false);
-    decoded.resize(32);
-    return decoded;
+    Bytes decoded = ConvertBits(data, 5, 8, false);
+    if (decoded.size() != std::tuple_size<Bytes32>::value) {
+        throw std::runtime_error("Invalid address, the length of the puzzle-hash is wrong");
+    }
+    Bytes32 puzzle_hash;
+    std::copy(std::begin(decoded), std::end(decoded), std::begin(puzzle_hash));
+    return puzzle_hash;
+}
+
+std::vector<std::string> EncodeMany(std::vector<Bytes32> const& puzzle_hashes, std::string_view prefix)
+{
+    std::vector<std::string> addresses(puzzle_hashes.size());
+    auto encode = [&](std::size_t i) { addresses[i] = EncodePuzzleHash(puzzle_hashes[i], prefix); };
+    if (puzzle_hashes.size() < PARALLEL_BATCH_SIZE) {
+        for (std::size_t i = 0; i < puzzle_hashes.size(); ++i) {
+            encode(i);
+        }
+    } else {
+        ThreadPool::GetInstance().ParallelFor(puzzle_hashes.size(), encode);
+    }
+    return addresses;
+}
+
+std::vector<Bytes32> DecodeMany(std::vector<std::string> const& addresses)
+{
+    std::vector<Bytes32> puzzle_hashes(addresses.size());
+    auto decode = [&](std::size_t i) { puzzle_hashes[i] = DecodePuzzleHash(addresses[i]); };
+    if (addresses.size() < PARALLEL_BATCH_SIZE) {
+        for (std::size_t i = 0; i < addresses.size(); ++i) {
+            decode(i);
+        }
+    } else {
+        ThreadPool::GetInstance().ParallelFor(addresses.size(), decode);
+    }
+    return puzzle_hashes;
 }
 
 } // namespace bech32
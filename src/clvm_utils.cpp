@@ -1,10 +1,22 @@
 #include "clvm_utils.h"
 
 #include <algorithm>
+#include <array>
 #include <cctype>
 #include <fstream>
 #include <sstream>
 
+#if defined(__SSE2__) || defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
 namespace chia
 {
 namespace utils
@@ -24,15 +36,16 @@ Bytes HashToBytes(Bytes32 const& hash) { return bytes_cast<HASH256_LEN>(hash); }
 
 Bytes32 HashFromHex(std::string_view hex)
 {
-    Bytes bytes = BytesFromHex(hex);
-    return bytes_cast<HASH256_LEN>(bytes);
+    if (hex.size() != HASH256_LEN * 2) {
+        Bytes bytes = BytesFromHex(hex);
+        return bytes_cast<HASH256_LEN>(bytes);
+    }
+    Bytes32 hash;
+    BytesFromHex(hex, hash.data());
+    return hash;
 }
 
-std::string HashToHex(Bytes32 const& hash)
-{
-    Bytes bytes = bytes_cast<HASH256_LEN>(hash);
-    return BytesToHex(bytes);
-}
+std::string HashToHex(Bytes32 const& hash) { return BytesToHex(hash.data(), hash.size()); }
 
 Bytes MakeBytes(char const* sz)
 {
@@ -44,17 +57,147 @@ Bytes MakeBytes(char const* sz)
 
 char const hex_chars[16] = { '0', '1', '2', '3', '4', '5', '6', '7', '8', '9', 'a', 'b', 'c', 'd', 'e', 'f' };
 
+uint8_t const INVALID_HEX = 0xff;
+
+/// The value of each hex character, other characters are `INVALID_HEX`
+constexpr std::array<uint8_t, 256> HEX_VALUES = []() {
+    std::array<uint8_t, 256> values {};
+    for (auto& value : values) {
+        value = INVALID_HEX;
+    }
+    for (int i = 0; i < 10; ++i) {
+        values['0' + i] = i;
+    }
+    for (int i = 0; i < 6; ++i) {
+        values['a' + i] = 10 + i;
+        values['A' + i] = 10 + i;
+    }
+    return values;
+}();
+
+namespace hex
+{
+
+void EncodeScalar(uint8_t const* data, std::size_t size, char* out)
+{
+    for (std::size_t i = 0; i < size; ++i) {
+        out[i * 2] = hex_chars[data[i] >> 4];
+        out[i * 2 + 1] = hex_chars[data[i] & 0x0f];
+    }
+}
+
+void DecodeScalar(char const* hex, std::size_t size, uint8_t* out)
+{
+    for (std::size_t i = 0; i < size / 2; ++i) {
+        uint8_t hi = HEX_VALUES[static_cast<uint8_t>(hex[i * 2])];
+        uint8_t lo = HEX_VALUES[static_cast<uint8_t>(hex[i * 2 + 1])];
+        if ((hi | lo) == INVALID_HEX) {
+            throw std::runtime_error("invalid character");
+        }
+        out[i] = (hi << 4) | lo;
+    }
+}
+
+#if defined(__SSE2__)
+
+/// The hex characters of 16 nibbles
+inline __m128i NibblesToChars(__m128i nibbles)
+{
+    __m128i letters = _mm_and_si128(_mm_cmpgt_epi8(nibbles, _mm_set1_epi8(9)), _mm_set1_epi8('a' - '0' - 10));
+    return _mm_add_epi8(_mm_add_epi8(nibbles, _mm_set1_epi8('0')), letters);
+}
+
+/// The values of 16 hex characters, `valid` is set to false when any of them is not a hex character
+inline __m128i CharsToNibbles(__m128i chars, bool& valid)
+{
+    __m128i digits = _mm_sub_epi8(chars, _mm_set1_epi8('0'));
+    __m128i is_digit
+        = _mm_and_si128(_mm_cmpgt_epi8(digits, _mm_set1_epi8(-1)), _mm_cmplt_epi8(digits, _mm_set1_epi8(10)));
+    __m128i letters = _mm_sub_epi8(_mm_or_si128(chars, _mm_set1_epi8(0x20)), _mm_set1_epi8('a'));
+    __m128i is_letter
+        = _mm_and_si128(_mm_cmpgt_epi8(letters, _mm_set1_epi8(-1)), _mm_cmplt_epi8(letters, _mm_set1_epi8(6)));
+    valid = _mm_movemask_epi8(_mm_or_si128(is_digit, is_letter)) == 0xffff;
+    return _mm_or_si128(_mm_and_si128(is_digit, digits),
+        _mm_and_si128(is_letter, _mm_add_epi8(letters, _mm_set1_epi8(10))));
+}
+
+/// Merge the 16 nibbles `h0 l0 h1 l1 ...` into 8 bytes, which are in the low halves of the 16-bit lanes
+inline __m128i MergeNibbles(__m128i nibbles)
+{
+    __m128i hi = _mm_slli_epi16(_mm_and_si128(nibbles, _mm_set1_epi16(0x00ff)), 4);
+    return _mm_or_si128(hi, _mm_srli_epi16(nibbles, 8));
+}
+
+#endif
+
+void Encode(uint8_t const* data, std::size_t size, char* out)
+{
+    std::size_t i { 0 };
+#if defined(__AVX2__)
+    for (; i + 32 <= size; i += 32) {
+        __m256i bytes = _mm256_loadu_si256(reinterpret_cast<__m256i const*>(data + i));
+        __m256i mask = _mm256_set1_epi8(0x0f);
+        __m256i hi = _mm256_and_si256(_mm256_srli_epi16(bytes, 4), mask);
+        __m256i lo = _mm256_and_si256(bytes, mask);
+        auto to_chars = [](__m256i nibbles) {
+            __m256i letters
+                = _mm256_and_si256(_mm256_cmpgt_epi8(nibbles, _mm256_set1_epi8(9)), _mm256_set1_epi8('a' - '0' - 10));
+            return _mm256_add_epi8(_mm256_add_epi8(nibbles, _mm256_set1_epi8('0')), letters);
+        };
+        hi = to_chars(hi);
+        lo = to_chars(lo);
+        // The unpack works in each 128-bit lane, put the lanes back in order
+        __m256i first = _mm256_unpacklo_epi8(hi, lo);
+        __m256i second = _mm256_unpackhi_epi8(hi, lo);
+        _mm256_storeu_si256(
+            reinterpret_cast<__m256i*>(out + i * 2), _mm256_permute2x128_si256(first, second, 0x20));
+        _mm256_storeu_si256(
+            reinterpret_cast<__m256i*>(out + i * 2 + 32), _mm256_permute2x128_si256(first, second, 0x31));
+    }
+#endif
+#if defined(__SSE2__)
+    for (; i + 16 <= size; i += 16) {
+        __m128i bytes = _mm_loadu_si128(reinterpret_cast<__m128i const*>(data + i));
+        __m128i mask = _mm_set1_epi8(0x0f);
+        __m128i hi = NibblesToChars(_mm_and_si128(_mm_srli_epi16(bytes, 4), mask));
+        __m128i lo = NibblesToChars(_mm_and_si128(bytes, mask));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i * 2), _mm_unpacklo_epi8(hi, lo));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i * 2 + 16), _mm_unpackhi_epi8(hi, lo));
+    }
+#endif
+    EncodeScalar(data + i, size - i, out + i * 2);
+}
+
+/// Decode `size` (even) hex characters, throws when there is an invalid character
+void Decode(char const* hex, std::size_t size, uint8_t* out)
+{
+    std::size_t i { 0 };
+#if defined(__SSE2__)
+    for (; i + 32 <= size; i += 32) {
+        bool valid0, valid1;
+        __m128i first = CharsToNibbles(_mm_loadu_si128(reinterpret_cast<__m128i const*>(hex + i)), valid0);
+        __m128i second = CharsToNibbles(_mm_loadu_si128(reinterpret_cast<__m128i const*>(hex + i + 16)), valid1);
+        if (!valid0 || !valid1) {
+            throw std::runtime_error("invalid character");
+        }
+        __m128i bytes = _mm_packus_epi16(MergeNibbles(first), MergeNibbles(second));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i / 2), bytes);
+    }
+#endif
+    DecodeScalar(hex + i, size - i, out + i / 2);
+}
+
+} // namespace hex
+
 char Byte4bToHexChar(uint8_t hex) { return hex_chars[hex]; }
 
 uint8_t HexCharToByte4b(char ch)
 {
-    for (int i = 0; i < 16; ++i) {
-        if (std::tolower(ch) == hex_chars[i]) {
-            return i;
-        }
+    uint8_t value = HEX_VALUES[static_cast<uint8_t>(ch)];
+    if (value == INVALID_HEX) {
+        throw std::runtime_error("invalid character");
     }
-    // Not found, the character is invalid
-    throw std::runtime_error("invalid character");
+    return value;
 }
 
 std::string ByteToHex(uint8_t byte)
@@ -88,26 +231,67 @@ uint8_t ByteFromHex(std::string_view hex, int* consumed)
     return byte;
 }
 
-std::string BytesToHex(Bytes const& bytes)
+std::string BytesToHex(Bytes const& bytes) { return BytesToHex(bytes.data(), bytes.size()); }
+
+std::string BytesToHex(uint8_t const* data, std::size_t size)
 {
-    std::stringstream ss;
-    for (uint8_t byte : bytes) {
-        ss << ByteToHex(byte);
-    }
-    return ss.str();
+    std::string hex(size * 2, '\0');
+    hex::Encode(data, size, hex.data());
+    return hex;
 }
 
+void BytesToHex(uint8_t const* data, std::size_t size, char* out) { hex::Encode(data, size, out); }
+
 Bytes BytesFromHex(std::string_view hex)
 {
-    Bytes res;
-    int consumed;
-    uint8_t byte = ByteFromHex(hex, &consumed);
-    while (consumed > 0) {
-        res.push_back(byte);
-        hex = hex.substr(consumed);
-        // Next byte
-        byte = ByteFromHex(hex, &consumed);
+    // A single character at the end is converted to a byte of its own
+    Bytes res((hex.size() + 1) / 2);
+    BytesFromHex(hex, res.data());
+    return res;
+}
+
+void BytesFromHex(std::string_view hex, uint8_t* out)
+{
+    std::size_t n = hex.size() / 2;
+    hex::Decode(hex.data(), n * 2, out);
+    if (hex.size() % 2) {
+        out[n] = HexCharToByte4b(hex.back());
+    }
+}
+
+Bytes BytesFromHexText(std::string_view hex)
+{
+    Bytes res(hex.size() / 2 + 1);
+    std::size_t n { 0 };
+    int hi { -1 };
+    std::size_t i { 0 };
+    while (i < hex.size()) {
+        if (std::isspace(static_cast<uint8_t>(hex[i]))) {
+            ++i;
+            continue;
+        }
+        if (hi >= 0) {
+            // The last run ended with half a byte
+            res[n++] = (hi << 4) | HexCharToByte4b(hex[i++]);
+            hi = -1;
+            continue;
+        }
+        std::size_t j = i;
+        while (j < hex.size() && !std::isspace(static_cast<uint8_t>(hex[j]))) {
+            ++j;
+        }
+        std::size_t len = (j - i) / 2 * 2;
+        hex::Decode(hex.data() + i, len, res.data() + n);
+        n += len / 2;
+        if (len < j - i) {
+            hi = HexCharToByte4b(hex[j - 1]);
+        }
+        i = j;
+    }
+    if (hi >= 0) {
+        res[n++] = hi;
     }
+    res.resize(n);
     return res;
 }
 
@@ -147,6 +331,58 @@ std::string LoadHexFromFile(std::string file_path)
     return ss.str();
 }
 
+MappedFile::MappedFile(std::string const& file_path, bool use_mmap, bool sequential)
+{
+#ifndef _WIN32
+    if (use_mmap) {
+        int fd = open(file_path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            throw std::runtime_error("cannot open file: " + file_path + " to read");
+        }
+        struct stat st;
+        if (fstat(fd, &st) != 0) {
+            close(fd);
+            throw std::runtime_error("cannot get the size of file: " + file_path);
+        }
+        size_ = static_cast<std::size_t>(st.st_size);
+        if (size_ == 0) {
+            // An empty file cannot be mapped, there is nothing to read anyway
+            close(fd);
+            data_ = buffer_.data();
+            return;
+        }
+        void* p = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+        close(fd);
+        if (p == MAP_FAILED) {
+            throw std::runtime_error("cannot map file: " + file_path);
+        }
+        madvise(p, size_, sequential ? MADV_SEQUENTIAL : MADV_RANDOM);
+        data_ = static_cast<uint8_t const*>(p);
+        mapped_ = true;
+        return;
+    }
+#endif
+    std::ifstream in(file_path, std::ios::binary);
+    if (!in.is_open()) {
+        throw std::runtime_error("cannot open file: " + file_path + " to read");
+    }
+    in.seekg(0, std::ios::end);
+    buffer_.resize(static_cast<std::size_t>(in.tellg()));
+    in.seekg(0, std::ios::beg);
+    in.read(reinterpret_cast<char*>(buffer_.data()), buffer_.size());
+    data_ = buffer_.data();
+    size_ = buffer_.size();
+}
+
+MappedFile::~MappedFile()
+{
+#ifndef _WIN32
+    if (mapped_) {
+        munmap(const_cast<uint8_t*>(data_), size_);
+    }
+#endif
+}
+
 Bytes ByteToBytes(uint8_t b)
 {
     Bytes res(1);
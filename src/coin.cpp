@@ -3,22 +3,29 @@
 #include <cassert>
 
 #include <algorithm>
+#include <array>
 #include <cassert>
+#include <cstring>
 #include <functional>
 #include <map>
+#include <mutex>
 #include <tuple>
+#include <unordered_set>
 #include <vector>
 
 #include <react-native-bls-signatures/schemes.hpp>
 
+#include "batch_verifier.h"
 #include "clvm_utils.h"
 #include "costs.h"
 #include "crypto_utils.h"
 #include "int.h"
 #include "key.h"
+#include "pairing_cache.h"
 
 #include "condition_opcode.h"
 #include "puzzle.h"
+#include "thread_pool.h"
 
 namespace chia
 {
@@ -66,7 +73,7 @@ std::tuple<std::vector<ConditionWithArgs>, uint64_t> conditions_for_solution(
 {
     Cost cost;
     CLVMObjectPtr r;
-    std::tie(cost, r) = puzzle_reveal.Run(solution.GetSExp());
+    std::tie(cost, r) = puzzle_reveal.Run(solution.GetSExp(), max_cost);
     auto results = parse_sexp_to_conditions(r);
     return std::make_tuple(results, cost);
 }
@@ -96,7 +103,7 @@ std::vector<Coin> created_outputs_for_conditions_dict(
         for (auto const& cvp : i->second) {
             Bytes32 puzzle_hash = utils::BytesToHash(cvp.vars[0]);
             Bytes amount_bin = cvp.vars[1];
-            uint64_t amount = utils::IntFromBEBytes<uint64_t>(amount_bin);
+            uint64_t amount = utils::UIntFromAtom<uint64_t>(amount_bin);
             output_coins.emplace_back(std::move(input_coin_name), std::move(puzzle_hash), amount);
         }
     }
@@ -134,8 +141,10 @@ Cost fee_for_solution(Program const& puzzle_reveal, Program const& solution, Cos
     if (i != std::end(dic)) {
         for (auto const& cvp : i->second) {
             auto amount_bin = cvp.vars[0];
-            Cost amount = utils::IntFromBEBytes<Cost>(amount_bin);
-            total += amount;
+            Cost amount = utils::UIntFromAtom<Cost>(amount_bin);
+            if (__builtin_add_overflow(total, amount, &total)) {
+                throw std::runtime_error("the reserved fee overflows");
+            }
         }
     }
     return total;
@@ -149,26 +158,95 @@ std::vector<std::tuple<Bytes48, Bytes>> pkm_pairs_for_conditions_dict(
     std::vector<std::tuple<Bytes48, Bytes>> ret;
 
     auto i = conditions_dict.find(ConditionOpcode(ConditionOpcode::AGG_SIG_UNSAFE));
-
-    for (auto const& cwa : i->second) {
-        assert(cwa.vars.size() == 2);
-        assert(cwa.vars[0].size() == 48 && cwa.vars[1].size() <= 1024);
-        assert(!cwa.vars[0].empty() && !cwa.vars[1].empty());
-        ret.push_back(std::make_pair(utils::bytes_cast<48>(cwa.vars[0]), cwa.vars[1]));
+    if (i != std::end(conditions_dict)) {
+        for (auto const& cwa : i->second) {
+            assert(cwa.vars.size() == 2);
+            assert(cwa.vars[0].size() == 48 && cwa.vars[1].size() <= 1024);
+            assert(!cwa.vars[0].empty() && !cwa.vars[1].empty());
+            ret.push_back(std::make_pair(utils::bytes_cast<48>(cwa.vars[0]), cwa.vars[1]));
+        }
     }
 
     auto j = conditions_dict.find(ConditionOpcode(ConditionOpcode::AGG_SIG_ME));
-    for (auto const& cwa : j->second) {
-        assert(cwa.vars.size() == 2);
-        assert(cwa.vars[0].size() == 48 && cwa.vars[1].size() <= 1024);
-        assert(!cwa.vars[0].empty() && !cwa.vars[1].empty());
-        ret.push_back(std::make_pair(utils::bytes_cast<48>(cwa.vars[0]),
-            utils::ConnectBuffers(cwa.vars[1], utils::HashToBytes(coin_name), additional_data)));
+    if (j != std::end(conditions_dict)) {
+        for (auto const& cwa : j->second) {
+            assert(cwa.vars.size() == 2);
+            assert(cwa.vars[0].size() == 48 && cwa.vars[1].size() <= 1024);
+            assert(!cwa.vars[0].empty() && !cwa.vars[1].empty());
+            ret.push_back(std::make_pair(utils::bytes_cast<48>(cwa.vars[0]),
+                utils::ConnectBuffers(cwa.vars[1], utils::HashToBytes(coin_name), additional_data)));
+        }
     }
 
     return ret;
 }
 
+std::vector<std::tuple<Bytes48, Bytes>> pkm_pairs_for_spend_bundle(
+    SpendBundle const& spend_bundle, Bytes const& additional_data, Cost max_cost)
+{
+    std::vector<std::tuple<Bytes48, Bytes>> ret;
+    for (auto const& coin_spend : spend_bundle.CoinSolutions()) {
+        std::map<chia::ConditionOpcode, std::vector<chia::ConditionWithArgs>> conditions_dict;
+        Cost cost;
+        std::tie(conditions_dict, cost)
+            = conditions_dict_for_solution(coin_spend.puzzle_reveal.value(), coin_spend.solution.value(), max_cost);
+        auto pkm_pairs = pkm_pairs_for_conditions_dict(conditions_dict, coin_spend.coin.GetName(), additional_data);
+        std::move(std::begin(pkm_pairs), std::end(pkm_pairs), std::back_inserter(ret));
+    }
+    return ret;
+}
+
+std::vector<bool> verify_spend_bundles(
+    std::vector<SpendBundle> const& spend_bundles, Bytes const& additional_data, Cost max_cost)
+{
+    // Running the puzzles is independent for each bundle, a bundle which fails to run is invalid
+    std::vector<std::optional<wallet::SignatureSet>> sets(spend_bundles.size());
+    ThreadPool::GetInstance().ParallelFor(spend_bundles.size(), [&](std::size_t i) {
+        try {
+            wallet::SignatureSet set;
+            for (auto const& p : pkm_pairs_for_spend_bundle(spend_bundles[i], additional_data, max_cost)) {
+                set.public_keys.push_back(std::get<0>(p));
+                set.messages.push_back(std::get<1>(p));
+            }
+            set.signature = spend_bundles[i].GetAggregatedSignature();
+            sets[i] = std::move(set);
+        } catch (std::exception const&) {
+            // Leave the set empty
+        }
+    });
+
+    wallet::BatchVerifier verifier;
+    std::vector<std::size_t> indices;
+    for (std::size_t i = 0; i < sets.size(); ++i) {
+        if (sets[i].has_value()) {
+            indices.push_back(i);
+            verifier.Add(std::move(sets[i].value()));
+        }
+    }
+    auto verified = verifier.Verify();
+    std::vector<bool> results(spend_bundles.size(), false);
+    for (std::size_t i = 0; i < indices.size(); ++i) {
+        results[indices[i]] = verified[i];
+    }
+    return results;
+}
+
+bool validate_spend_bundle_signature(
+    SpendBundle const& spend_bundle, Bytes const& additional_data, wallet::PairingCache& cache, Cost max_cost)
+{
+    std::vector<PublicKey> public_keys;
+    std::vector<Bytes> messages;
+    try {
+        for (auto const& p : pkm_pairs_for_spend_bundle(spend_bundle, additional_data, max_cost)) {
+            public_keys.push_back(std::get<0>(p));
+            messages.push_back(std::get<1>(p));
+        }
+    } catch (std::exception const&) {
+        return false;
+    }
+    return cache.AggregateVerify(public_keys, messages, spend_bundle.GetAggregatedSignature());
+}
+
 Program make_solution(std::vector<Payment> const& primaries, std::set<Bytes> const& coin_announcements,
     std::set<Bytes32> const& coin_announcements_to_assert, std::set<Bytes> const& puzzle_announcements,
     std::set<Bytes32> const& puzzle_announcements_to_assert, CLVMObjectPtr additions, uint64_t fee)
@@ -240,14 +318,51 @@ std::vector<Payment> decode_payments_from_solution(
 
 SpendBundle sign_coin_spends(std::vector<CoinSpend> coin_spends, SecretKeyForPublicKeyFunc secret_key_for_public_key_f,
     SecretKeyForPuzzleHashFunc secret_key_for_puzzle_hash_f, Bytes const& additional_data, Cost max_cost,
-    std::vector<DeriveFunc> const& derive_f_list)
+    std::vector<DeriveFunc> const& derive_f_list, SignOptions const& options)
 {
-    std::vector<chia::Signature> signatures;
-    std::vector<chia::PublicKey> public_key_list;
-    std::vector<Bytes> message_list;
     if (coin_spends.empty()) {
         throw std::runtime_error("no coin spends");
     }
+
+    // Keys are parsed once per signing session, by the secret and by the public key they have been matched to
+    std::map<PrivateKey, wallet::CachedKey> keys_by_secret;
+    std::map<PublicKey, wallet::CachedKey> keys_by_public_key;
+
+    auto get_key = [&keys_by_secret](PrivateKey const& secret) -> wallet::CachedKey const& {
+        auto i = keys_by_secret.find(secret);
+        if (i == std::end(keys_by_secret)) {
+            i = keys_by_secret.emplace(secret, wallet::CachedKey(secret)).first;
+        }
+        return i->second;
+    };
+
+    auto find_key = [&](PublicKey const& public_key) -> wallet::CachedKey {
+        auto i = keys_by_public_key.find(public_key);
+        if (i != std::end(keys_by_public_key)) {
+            return i->second;
+        }
+        std::optional<wallet::CachedKey> key;
+        auto secret_key_opt = secret_key_for_public_key_f(public_key);
+        if (secret_key_opt.has_value() && get_key(secret_key_opt.value()).GetPublicKey() == public_key) {
+            key = get_key(secret_key_opt.value());
+        } else {
+            for (auto const& derive : derive_f_list) {
+                secret_key_opt = secret_key_for_puzzle_hash_f(derive(public_key));
+                if (secret_key_opt.has_value() && get_key(secret_key_opt.value()).GetPublicKey() == public_key) {
+                    key = get_key(secret_key_opt.value());
+                    break;
+                }
+            }
+        }
+        if (!key.has_value()) {
+            throw std::runtime_error("cannot get secret key");
+        }
+        keys_by_public_key.emplace(public_key, key.value());
+        return key.value();
+    };
+
+    std::vector<wallet::CachedKey> key_list;
+    std::vector<Bytes> message_list;
     for (auto const& coin_spend : coin_spends) {
         // Get AGG_SIG conditions
         std::map<chia::ConditionOpcode, std::vector<chia::ConditionWithArgs>> conditions_dict;
@@ -257,54 +372,174 @@ SpendBundle sign_coin_spends(std::vector<CoinSpend> coin_spends, SecretKeyForPub
         if (conditions_dict.empty()) {
             throw std::runtime_error("Sign transaction failed");
         }
-        // Create signature
         auto pkm_pairs = pkm_pairs_for_conditions_dict(conditions_dict, coin_spend.coin.GetName(), additional_data);
         for (auto const& p : pkm_pairs) {
             PublicKey public_key;
             Bytes message;
             std::tie(public_key, message) = p;
-            public_key_list.push_back(public_key);
-            message_list.push_back(message);
-            std::optional<PrivateKey> private_key;
-            auto secret_key_opt = secret_key_for_public_key_f(public_key);
-            if (!secret_key_opt.has_value() || wallet::Key(secret_key_opt.value()).GetPublicKey() != public_key) {
-                for (auto const& derive : derive_f_list) {
-                    secret_key_opt = secret_key_for_puzzle_hash_f(derive(public_key));
-                    if (secret_key_opt.has_value()
-                        && wallet::Key(secret_key_opt.value()).GetPublicKey() == public_key) {
-                        private_key = secret_key_opt.value();
-                        break;
-                    }
-                }
-            } else {
-                private_key = secret_key_opt.value();
-            }
-            if (!private_key.has_value()) {
-                throw std::runtime_error("cannot get secret key");
-            }
-            chia::wallet::Key key(private_key.value());
-            auto signature = key.Sign(message);
-            assert(chia::wallet::Key::VerifySignature(public_key, message, signature));
-            signatures.push_back(std::move(signature));
+            key_list.push_back(find_key(public_key));
+            message_list.push_back(std::move(message));
+        }
+    }
+
+    // Create signatures
+    std::vector<chia::Signature> signatures(key_list.size());
+    auto sign = [&](std::size_t i) {
+        signatures[i] = key_list[i].Sign(message_list[i]);
+        if (options.verify_each_signature
+            && !wallet::CachedKey::VerifySignature(key_list[i].GetPublicKeyHandle(), message_list[i], signatures[i])) {
+            throw std::runtime_error("failed to verify the signature just made, critical internal error!");
+        }
+    };
+    if (options.parallel) {
+        ThreadPool::GetInstance().ParallelFor(signatures.size(), sign);
+    } else {
+        for (std::size_t i = 0; i < signatures.size(); ++i) {
+            sign(i);
         }
     }
 
     // Aggregate signatures
     auto aggregated_signature = chia::wallet::Key::AggregateSignatures(signatures);
-    if (!chia::wallet::Key::AggregateVerifySignature(public_key_list, message_list, aggregated_signature)) {
-        throw std::runtime_error("failed to verify the signature just made, critical internal error!");
+    if (options.verify_aggregated_signature) {
+        std::vector<wallet::PublicKeyHandle> public_key_list;
+        public_key_list.reserve(key_list.size());
+        for (auto const& key : key_list) {
+            public_key_list.push_back(key.GetPublicKeyHandle());
+        }
+        if (!wallet::CachedKey::AggregateVerifySignature(public_key_list, message_list, aggregated_signature)) {
+            throw std::runtime_error("failed to verify the signature just made, critical internal error!");
+        }
     }
     return SpendBundle(std::move(coin_spends), std::move(aggregated_signature));
 }
 
 } // namespace puzzle
 
+namespace streamable
+{
+
+/// The integers of the streamable format are big-endian
+void WriteUInt(WriteStreamFunc const& f, uint64_t val, int size)
+{
+    uint8_t buf[sizeof(uint64_t)];
+    for (int i = size - 1; i >= 0; --i) {
+        buf[i] = static_cast<uint8_t>(val);
+        val >>= 8;
+    }
+    f(buf, size);
+}
+
+void WriteHash(WriteStreamFunc const& f, Bytes32 const& hash) { f(hash.data(), hash.size()); }
+
+/// The smallest coin spend is a coin of 72 bytes with a single byte puzzle and solution
+constexpr std::size_t MIN_COIN_SPEND_SIZE = 2 * utils::HASH256_LEN + sizeof(uint64_t) + 2;
+
+class Reader
+{
+public:
+    Reader(uint8_t const* data, std::size_t size)
+        : data_(data)
+        , size_(size)
+    {
+    }
+
+    uint8_t const* Read(std::size_t size)
+    {
+        if (size > size_ - pos_) {
+            throw std::runtime_error("streamable: the buffer ends before the object");
+        }
+        uint8_t const* p = data_ + pos_;
+        pos_ += size;
+        return p;
+    }
+
+    uint64_t ReadUInt(int size)
+    {
+        uint8_t const* p = Read(size);
+        uint64_t val { 0 };
+        for (int i = 0; i < size; ++i) {
+            val = (val << 8) | p[i];
+        }
+        return val;
+    }
+
+    template <std::size_t N> std::array<uint8_t, N> ReadArray()
+    {
+        std::array<uint8_t, N> res;
+        memcpy(res.data(), Read(N), N);
+        return res;
+    }
+
+    Program ReadProgram()
+    {
+        std::size_t consumed { 0 };
+        auto sexp = SExpFromBuffer(data_ + pos_, size_ - pos_, &consumed);
+        pos_ += consumed;
+        return Program(std::move(sexp));
+    }
+
+    Coin ReadCoin()
+    {
+        auto parent_coin_info = ReadArray<utils::HASH256_LEN>();
+        auto puzzle_hash = ReadArray<utils::HASH256_LEN>();
+        return Coin(parent_coin_info, puzzle_hash, ReadUInt(sizeof(uint64_t)));
+    }
+
+    CoinSpend ReadCoinSpend()
+    {
+        Coin coin = ReadCoin();
+        Program puzzle_reveal = ReadProgram();
+        return CoinSpend(std::move(coin), std::move(puzzle_reveal), ReadProgram());
+    }
+
+    std::size_t GetPos() const { return pos_; }
+
+    std::size_t GetRemaining() const { return size_ - pos_; }
+
+private:
+    uint8_t const* data_;
+    std::size_t size_;
+    std::size_t pos_ { 0 };
+};
+
+} // namespace streamable
+
+namespace coin_set
+{
+
+/// The coins whose IDs aren't in the other list, the IDs of the other list are joined through a hash set
+std::vector<Coin> Difference(std::vector<Coin> coins, std::vector<Coin> const& others)
+{
+    std::unordered_set<Bytes32, utils::Bytes32Hash> other_ids;
+    other_ids.reserve(others.size());
+    for (auto const& coin : others) {
+        other_ids.insert(coin.GetName());
+    }
+    coins.erase(std::remove_if(std::begin(coins), std::end(coins),
+                    [&other_ids](Coin const& coin) { return other_ids.find(coin.GetName()) != std::end(other_ids); }),
+        std::end(coins));
+    return coins;
+}
+
+} // namespace coin_set
+
 /*******************************************************************************
  *
  * class Coin
  *
  ******************************************************************************/
 
+Coin Coin::FromBytes(uint8_t const* data, std::size_t size, std::size_t* consumed)
+{
+    streamable::Reader reader(data, size);
+    Coin coin = reader.ReadCoin();
+    if (consumed) {
+        *consumed = reader.GetPos();
+    }
+    return coin;
+}
+
 Bytes32 Coin::HashCoinList(std::vector<Coin> coin_list)
 {
     std::sort(std::begin(coin_list), std::end(coin_list),
@@ -333,8 +568,27 @@ Coin::Coin(Bytes32 const& parent_coin_info, Bytes32 const& puzzle_hash, uint64_t
 
 Bytes32 Coin::GetName() const { return GetHash(); }
 
+Bytes32 Coin::GetParentCoinInfo() const { return utils::BytesToHash(parent_coin_info_); }
+
+Bytes32 Coin::GetPuzzleHash() const { return utils::BytesToHash(puzzle_hash_); }
+
 std::string Coin::GetNameStr() const { return utils::BytesToHex(utils::HashToBytes(GetName())); }
 
+void Coin::Stream(WriteStreamFunc const& f) const
+{
+    streamable::WriteHash(f, GetParentCoinInfo());
+    streamable::WriteHash(f, GetPuzzleHash());
+    streamable::WriteUInt(f, amount_, sizeof(uint64_t));
+}
+
+Bytes Coin::Serialize() const
+{
+    Bytes res;
+    res.reserve(2 * utils::HASH256_LEN + sizeof(uint64_t));
+    Stream([&res](uint8_t const* data, std::size_t size) { res.insert(std::end(res), data, data + size); });
+    return res;
+}
+
 Bytes32 Coin::GetHash() const
 {
     Int amountInt(amount_);
@@ -347,6 +601,16 @@ Bytes32 Coin::GetHash() const
  *
  ******************************************************************************/
 
+CoinSpend CoinSpend::FromBytes(uint8_t const* data, std::size_t size, std::size_t* consumed)
+{
+    streamable::Reader reader(data, size);
+    CoinSpend coin_spend = reader.ReadCoinSpend();
+    if (consumed) {
+        *consumed = reader.GetPos();
+    }
+    return coin_spend;
+}
+
 CoinSpend::CoinSpend(Coin in_coin, Program in_puzzle_reveal, Program in_solution)
     : coin(std::move(in_coin))
     , puzzle_reveal(std::move(in_puzzle_reveal))
@@ -364,15 +628,38 @@ Cost CoinSpend::ReservedFee()
     return puzzle::fee_for_solution(puzzle_reveal.value(), solution.value(), INFINITE_COST);
 }
 
+void CoinSpend::Stream(WriteStreamFunc const& f) const
+{
+    if (!puzzle_reveal.has_value() || !solution.has_value()) {
+        throw std::runtime_error("the puzzle reveal or the solution is missing");
+    }
+    coin.Stream(f);
+    puzzle_reveal->Serialize(f);
+    solution->Serialize(f);
+}
+
+Bytes CoinSpend::Serialize() const
+{
+    Bytes res;
+    Stream([&res](uint8_t const* data, std::size_t size) { res.insert(std::end(res), data, data + size); });
+    return res;
+}
+
 /*******************************************************************************
  *
  * class SpendBundle
  *
  ******************************************************************************/
 
+struct SpendBundle::NameCache {
+    std::once_flag once;
+    Bytes32 name;
+};
+
 SpendBundle::SpendBundle(std::vector<CoinSpend> coin_spends, Signature sig)
     : coin_spends_(std::move(coin_spends))
     , aggregated_signature_(std::move(sig))
+    , name_cache_(std::make_shared<NameCache>())
 {
 }
 
@@ -391,11 +678,29 @@ SpendBundle SpendBundle::Aggregate(std::vector<SpendBundle> const& spend_bundles
     return SpendBundle(std::move(coin_spends), sig);
 }
 
+SpendBundle SpendBundle::FromBytes(uint8_t const* data, std::size_t size, std::size_t* consumed)
+{
+    streamable::Reader reader(data, size);
+    auto num_spends = static_cast<std::size_t>(reader.ReadUInt(sizeof(uint32_t)));
+    std::vector<CoinSpend> coin_spends;
+    // The count comes from the peer, only the spends which can fit into the buffer are reserved
+    coin_spends.reserve(std::min(num_spends, reader.GetRemaining() / streamable::MIN_COIN_SPEND_SIZE));
+    for (std::size_t i = 0; i < num_spends; ++i) {
+        coin_spends.push_back(reader.ReadCoinSpend());
+    }
+    Signature sig = reader.ReadArray<wallet::Key::SIG_LEN>();
+    if (consumed) {
+        *consumed = reader.GetPos();
+    }
+    return SpendBundle(std::move(coin_spends), std::move(sig));
+}
+
 std::vector<Coin> SpendBundle::Additions() const
 {
     std::vector<Coin> items;
     for (auto const& coin_spend : coin_spends_) {
-        std::copy(std::begin(coin_spend.Additions()), std::end(coin_spend.Additions()), std::back_inserter(items));
+        std::vector<Coin> additions = coin_spend.Additions();
+        std::move(std::begin(additions), std::end(additions), std::back_inserter(items));
     }
     return items;
 }
@@ -430,12 +735,45 @@ uint64_t SpendBundle::Fees() const
     return amount_in - amount_out;
 }
 
-Bytes32 SpendBundle::Name() const { return Bytes32(); }
+Bytes32 SpendBundle::Name() const
+{
+    auto hash = [this]() {
+        crypto_utils::SHA256 sha256;
+        Stream([&sha256](uint8_t const* data, std::size_t size) { sha256.Add(data, size); });
+        return sha256.Finish();
+    };
+    // The cache is moved with the bundle, a moved-from bundle hashes itself on every call
+    if (!name_cache_) {
+        return hash();
+    }
+    std::call_once(name_cache_->once, [&]() { name_cache_->name = hash(); });
+    return name_cache_->name;
+}
 
-std::vector<Coin> SpendBundle::NotEphemeralAdditions() const
+void SpendBundle::Stream(WriteStreamFunc const& f) const
 {
-    std::vector<Coin> res;
+    streamable::WriteUInt(f, coin_spends_.size(), sizeof(uint32_t));
+    for (auto const& coin_spend : coin_spends_) {
+        coin_spend.Stream(f);
+    }
+    f(aggregated_signature_.data(), aggregated_signature_.size());
+}
+
+Bytes SpendBundle::Serialize() const
+{
+    Bytes res;
+    Stream([&res](uint8_t const* data, std::size_t size) { res.insert(std::end(res), data, data + size); });
     return res;
 }
 
+std::vector<Coin> SpendBundle::NotEphemeralAdditions() const
+{
+    return coin_set::Difference(Additions(), Removals());
+}
+
+std::vector<Coin> SpendBundle::NotEphemeralRemovals() const
+{
+    return coin_set::Difference(Removals(), Additions());
+}
+
 } // namespace chia
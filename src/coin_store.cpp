@@ -0,0 +1,1044 @@
+#include "coin_store.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <stdexcept>
+#include <unordered_set>
+
+#include "clvm_utils.h"
+#include "crypto_utils.h"
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+namespace chia
+{
+
+namespace coin_store
+{
+
+/// The number of slots of a table which holds `size` values, a power of 2 and the table is at most 3/4 full
+std::size_t TableCapacity(std::size_t size)
+{
+    std::size_t capacity { 16 };
+    while (capacity * 3 < size * 4) {
+        capacity *= 2;
+    }
+    return capacity;
+}
+
+/**
+ * An open addressing hash table with linear probing
+ *
+ * The slots are split into pages which are shared by the copies of the table, a page is copied before its first write
+ * when another table holds it. The capacity is a power of 2, the table is at most 3/4 full and no tombstone is left by
+ * an erase.
+ */
+template <typename T, typename Hash> class PagedTable
+{
+public:
+    struct Slot {
+        T value;
+        bool used { false };
+    };
+
+    static constexpr std::size_t MAX_PAGE_SLOTS = 1024;
+
+    explicit PagedTable(std::size_t expected_size) { Rehash(TableCapacity(expected_size)); }
+
+    std::size_t GetSize() const { return size_; }
+
+    std::size_t GetMemoryUsage() const { return capacity_ * sizeof(Slot) + pages_.size() * sizeof(PagePtr); }
+
+    Slot const& At(std::size_t i) const { return (*pages_[i / page_slots_])[i % page_slots_]; }
+
+    Slot& MutableAt(std::size_t i)
+    {
+        auto& page = pages_[i / page_slots_];
+        if (page.use_count() > 1) {
+            page = std::make_shared<Page>(*page);
+        }
+        return (*page)[i % page_slots_];
+    }
+
+    /// The slot of the first value which matches, or the empty slot where the probe ends
+    template <typename Pred> std::size_t Find(uint64_t hash, Pred&& pred) const
+    {
+        std::size_t i = hash & mask_;
+        while (At(i).used && !pred(At(i).value)) {
+            i = (i + 1) & mask_;
+        }
+        return i;
+    }
+
+    template <typename F> void ForEach(F&& f) const
+    {
+        for (auto const& page : pages_) {
+            for (auto const& slot : *page) {
+                if (slot.used) {
+                    f(slot.value);
+                }
+            }
+        }
+    }
+
+    void Insert(T value)
+    {
+        if ((size_ + 1) * 4 > capacity_ * 3) {
+            Rehash(capacity_ * 2);
+        }
+        InsertNoGrow(std::move(value));
+    }
+
+    /// The values after the slot are shifted back when their probes pass it
+    void Erase(std::size_t i)
+    {
+        MutableAt(i).used = false;
+        --size_;
+        for (std::size_t j = (i + 1) & mask_; At(j).used; j = (j + 1) & mask_) {
+            std::size_t home = Hash()(At(j).value) & mask_;
+            if (((j - home) & mask_) < ((j - i) & mask_)) {
+                continue;
+            }
+            T value = At(j).value;
+            auto& dest = MutableAt(i);
+            dest.value = std::move(value);
+            dest.used = true;
+            MutableAt(j).used = false;
+            i = j;
+        }
+    }
+
+private:
+    using Page = std::vector<Slot>;
+    using PagePtr = std::shared_ptr<Page>;
+
+    void InsertNoGrow(T value)
+    {
+        std::size_t i = Hash()(value) & mask_;
+        while (At(i).used) {
+            i = (i + 1) & mask_;
+        }
+        auto& slot = MutableAt(i);
+        slot.value = std::move(value);
+        slot.used = true;
+        ++size_;
+    }
+
+    void Rehash(std::size_t capacity)
+    {
+        std::vector<PagePtr> old_pages;
+        old_pages.swap(pages_);
+        capacity_ = capacity;
+        mask_ = capacity - 1;
+        page_slots_ = std::min(capacity, MAX_PAGE_SLOTS);
+        pages_.reserve(capacity / page_slots_);
+        for (std::size_t i = 0; i < capacity / page_slots_; ++i) {
+            pages_.push_back(std::make_shared<Page>(page_slots_));
+        }
+        size_ = 0;
+        for (auto const& page : old_pages) {
+            for (auto const& slot : *page) {
+                if (slot.used) {
+                    InsertNoGrow(slot.value);
+                }
+            }
+        }
+    }
+
+    std::vector<PagePtr> pages_;
+    std::size_t capacity_ { 0 };
+    std::size_t mask_ { 0 };
+    std::size_t page_slots_ { 0 };
+    std::size_t size_ { 0 };
+};
+
+/// The coins of a puzzle hash are linked from the last one added to the first one, a copy of a coin from the coin file
+/// isn't linked
+struct CoinSlot {
+    CoinRecord record;
+    Bytes32 next_coin_id;
+    bool has_next;
+    bool from_file;
+};
+
+struct CoinSlotHash {
+    uint64_t operator()(CoinSlot const& slot) const { return utils::Bytes32Hash()(slot.record.coin_id); }
+};
+
+struct PuzzleSlot {
+    Bytes32 puzzle_hash;
+    Bytes32 last_coin_id;
+};
+
+struct PuzzleSlotHash {
+    uint64_t operator()(PuzzleSlot const& slot) const { return utils::Bytes32Hash()(slot.puzzle_hash); }
+};
+
+struct BlockUndo {
+    uint32_t height;
+    std::vector<Bytes32> additions;
+    std::vector<Bytes32> removals;
+};
+
+/*******************************************************************************
+ *
+ * The coin file and the log
+ *
+ ******************************************************************************/
+
+char const DATA_FILE_NAME[] = "coins.dat";
+char const LOG_FILE_NAME[] = "coins.log";
+
+/**
+ * The layout of the coin file, the integers are big-endian
+ *
+ * header   64 bytes: "CHIACOIN", version u32, flags u32 (bit 0: the height is set), checkpoint ID u64, height u32,
+ *          reserved u32, number of coins u64, number of slots u64, reserved 16 bytes
+ * slots    the table of the coins by coin ID with linear probing from the first 8 bytes of the coin ID, a slot is the
+ *          coin ID, the parent coin info, the puzzle hash, the amount u64, the confirmed height u32 and the spent
+ *          height u32, an empty slot is all zeros
+ * puzzles  an entry of each coin sorted by puzzle hash, an entry is the puzzle hash and the slot u64 of the coin
+ */
+uint8_t const MAGIC[8] = { 'C', 'H', 'I', 'A', 'C', 'O', 'I', 'N' };
+uint32_t const VERSION = 1;
+uint32_t const FLAG_HEIGHT = 1;
+std::size_t const HEADER_SIZE = 64;
+std::size_t const SLOT_SIZE = 112;
+
+struct PuzzleEntry {
+    Bytes32 puzzle_hash;
+    std::array<uint8_t, 8> slot;
+
+    bool operator<(PuzzleEntry const& rhs) const { return memcmp(this, &rhs, sizeof(PuzzleEntry)) < 0; }
+};
+
+static_assert(sizeof(PuzzleEntry) == 40 && alignof(PuzzleEntry) == 1, "the entries are read in place");
+
+struct PuzzleHashLess {
+    bool operator()(PuzzleEntry const& lhs, Bytes32 const& rhs) const { return lhs.puzzle_hash < rhs; }
+
+    bool operator()(Bytes32 const& lhs, PuzzleEntry const& rhs) const { return lhs < rhs.puzzle_hash; }
+};
+
+uint64_t ReadBE(uint8_t const* p, int size)
+{
+    uint64_t res { 0 };
+    for (int i = 0; i < size; ++i) {
+        res = (res << 8) | p[i];
+    }
+    return res;
+}
+
+void WriteBE(uint8_t* p, uint64_t val, int size)
+{
+    for (int i = size - 1; i >= 0; --i) {
+        p[i] = static_cast<uint8_t>(val);
+        val >>= 8;
+    }
+}
+
+bool IsEmptySlot(uint8_t const* slot)
+{
+    static Bytes32 const ZERO {};
+    return memcmp(slot, ZERO.data(), ZERO.size()) == 0;
+}
+
+CoinRecord ReadRecord(uint8_t const* slot)
+{
+    CoinRecord record;
+    memcpy(record.coin_id.data(), slot, 32);
+    memcpy(record.parent_coin_info.data(), slot + 32, 32);
+    memcpy(record.puzzle_hash.data(), slot + 64, 32);
+    record.amount = ReadBE(slot + 96, 8);
+    record.confirmed_height = static_cast<uint32_t>(ReadBE(slot + 104, 4));
+    record.spent_height = static_cast<uint32_t>(ReadBE(slot + 108, 4));
+    return record;
+}
+
+void WriteRecord(uint8_t* slot, CoinRecord const& record)
+{
+    memcpy(slot, record.coin_id.data(), 32);
+    memcpy(slot + 32, record.parent_coin_info.data(), 32);
+    memcpy(slot + 64, record.puzzle_hash.data(), 32);
+    WriteBE(slot + 96, record.amount, 8);
+    WriteBE(slot + 104, record.confirmed_height, 4);
+    WriteBE(slot + 108, record.spent_height, 4);
+}
+
+void SyncFile(std::FILE* file)
+{
+#ifdef _WIN32
+    bool synced = std::fflush(file) == 0 && _commit(_fileno(file)) == 0;
+#else
+    bool synced = std::fflush(file) == 0 && fsync(fileno(file)) == 0;
+#endif
+    if (!synced) {
+        throw std::runtime_error("cannot sync the file to the disk");
+    }
+}
+
+/// The entry of a new or renamed file is only durable once its directory is synced
+void SyncDirectory(std::string const& dir_path)
+{
+#ifndef _WIN32
+    int fd = open(dir_path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw std::runtime_error("cannot open directory: " + dir_path + " to sync");
+    }
+    bool synced = fsync(fd) == 0;
+    close(fd);
+    if (!synced) {
+        throw std::runtime_error("cannot sync directory: " + dir_path);
+    }
+#endif
+}
+
+/// A new file which is written through memory, the content is synced to the disk by `Finish`
+class OutputFile
+{
+public:
+    OutputFile(std::string const& file_path, std::size_t size)
+        : file_path_(file_path)
+        , size_(size)
+    {
+#ifdef _WIN32
+        buffer_.resize(size);
+        data_ = buffer_.data();
+#else
+        fd_ = open(file_path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+        if (fd_ < 0) {
+            throw std::runtime_error("cannot open file: " + file_path + " to write");
+        }
+        void* p = MAP_FAILED;
+        if (ftruncate(fd_, static_cast<off_t>(size)) == 0) {
+            p = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0);
+        }
+        if (p == MAP_FAILED) {
+            close(fd_);
+            throw std::runtime_error("cannot map file: " + file_path);
+        }
+        data_ = static_cast<uint8_t*>(p);
+#endif
+    }
+
+    ~OutputFile()
+    {
+#ifndef _WIN32
+        if (data_) {
+            munmap(data_, size_);
+            close(fd_);
+        }
+#endif
+    }
+
+    OutputFile(OutputFile const&) = delete;
+
+    OutputFile& operator=(OutputFile const&) = delete;
+
+    /// The content is zeros until it is written
+    uint8_t* GetData() const { return data_; }
+
+    void Finish()
+    {
+#ifdef _WIN32
+        std::FILE* file = std::fopen(file_path_.c_str(), "wb");
+        if (!file) {
+            throw std::runtime_error("cannot open file: " + file_path_ + " to write");
+        }
+        bool written = std::fwrite(buffer_.data(), 1, size_, file) == size_;
+        try {
+            SyncFile(file);
+        } catch (...) {
+            written = false;
+        }
+        std::fclose(file);
+        if (!written) {
+            throw std::runtime_error("cannot write file: " + file_path_);
+        }
+#else
+        bool synced = msync(data_, size_, MS_SYNC) == 0;
+        munmap(data_, size_);
+        data_ = nullptr;
+        synced = fsync(fd_) == 0 && synced;
+        close(fd_);
+        if (!synced) {
+            throw std::runtime_error("cannot write file: " + file_path_);
+        }
+#endif
+    }
+
+private:
+    std::string file_path_;
+    std::size_t size_;
+    uint8_t* data_ { nullptr };
+#ifdef _WIN32
+    Bytes buffer_;
+#else
+    int fd_ { -1 };
+#endif
+};
+
+/// The coins of a checkpoint, they are looked up in the mapped file without reading the rest
+class CoinFile
+{
+public:
+    explicit CoinFile(std::string const& file_path)
+        : file_(file_path, true, false)
+    {
+        uint8_t const* p = file_.GetData();
+        if (file_.GetSize() < HEADER_SIZE || memcmp(p, MAGIC, sizeof(MAGIC)) != 0 || ReadBE(p + 8, 4) != VERSION) {
+            throw std::runtime_error("it isn't a coin file: " + file_path);
+        }
+        if (ReadBE(p + 12, 4) & FLAG_HEIGHT) {
+            height_ = static_cast<uint32_t>(ReadBE(p + 24, 4));
+        }
+        checkpoint_id_ = ReadBE(p + 16, 8);
+        num_coins_ = ReadBE(p + 32, 8);
+        num_slots_ = ReadBE(p + 40, 8);
+        std::size_t body_size = file_.GetSize() - HEADER_SIZE;
+        if (num_slots_ == 0 || (num_slots_ & (num_slots_ - 1)) != 0 || num_coins_ >= num_slots_
+            || num_slots_ > body_size / SLOT_SIZE
+            || body_size != num_slots_ * SLOT_SIZE + num_coins_ * sizeof(PuzzleEntry)) {
+            throw std::runtime_error("the coin file is damaged: " + file_path);
+        }
+        slots_ = p + HEADER_SIZE;
+        entries_ = reinterpret_cast<PuzzleEntry const*>(slots_ + num_slots_ * SLOT_SIZE);
+    }
+
+    uint64_t GetCheckpointId() const { return checkpoint_id_; }
+
+    std::optional<uint32_t> GetHeight() const { return height_; }
+
+    std::size_t GetSize() const { return num_coins_; }
+
+    /// The slot of the coin, nullptr when the coin isn't in the file
+    uint8_t const* Find(Bytes32 const& coin_id) const
+    {
+        std::size_t mask = num_slots_ - 1;
+        for (std::size_t i = ReadBE(coin_id.data(), 8) & mask;; i = (i + 1) & mask) {
+            uint8_t const* slot = slots_ + i * SLOT_SIZE;
+            if (IsEmptySlot(slot)) {
+                return nullptr;
+            }
+            if (memcmp(slot, coin_id.data(), coin_id.size()) == 0) {
+                return slot;
+            }
+        }
+    }
+
+    template <typename F> void ForEachCoinOfPuzzleHash(Bytes32 const& puzzle_hash, F&& f) const
+    {
+        auto [begin, end] = std::equal_range(entries_, entries_ + num_coins_, puzzle_hash, PuzzleHashLess());
+        for (auto i = begin; i != end; ++i) {
+            uint64_t slot = ReadBE(i->slot.data(), 8);
+            if (slot >= num_slots_) {
+                throw std::runtime_error("the coin file is damaged");
+            }
+            f(slots_ + slot * SLOT_SIZE);
+        }
+    }
+
+    template <typename F> void ForEach(F&& f) const
+    {
+        for (std::size_t i = 0; i < num_slots_; ++i) {
+            uint8_t const* slot = slots_ + i * SLOT_SIZE;
+            if (!IsEmptySlot(slot)) {
+                f(slot);
+            }
+        }
+    }
+
+    /// Write the coins passed by `for_each_record` to a new file, `num_coins` must be the number of them
+    template <typename ForEachRecord>
+    static void Write(std::string const& file_path, uint64_t checkpoint_id, std::optional<uint32_t> height,
+        std::size_t num_coins, ForEachRecord&& for_each_record)
+    {
+        std::size_t num_slots = TableCapacity(num_coins);
+        OutputFile out(file_path, HEADER_SIZE + num_slots * SLOT_SIZE + num_coins * sizeof(PuzzleEntry));
+        uint8_t* p = out.GetData();
+        memcpy(p, MAGIC, sizeof(MAGIC));
+        WriteBE(p + 8, VERSION, 4);
+        WriteBE(p + 12, height.has_value() ? FLAG_HEIGHT : 0, 4);
+        WriteBE(p + 16, checkpoint_id, 8);
+        WriteBE(p + 24, height.value_or(0), 4);
+        WriteBE(p + 32, num_coins, 8);
+        WriteBE(p + 40, num_slots, 8);
+        uint8_t* slots = p + HEADER_SIZE;
+        auto* entries = reinterpret_cast<PuzzleEntry*>(slots + num_slots * SLOT_SIZE);
+        std::size_t n { 0 };
+        for_each_record([&](CoinRecord const& record) {
+            if (n == num_coins) {
+                throw std::runtime_error("too many coins to write");
+            }
+            std::size_t mask = num_slots - 1;
+            std::size_t i = ReadBE(record.coin_id.data(), 8) & mask;
+            while (!IsEmptySlot(slots + i * SLOT_SIZE)) {
+                i = (i + 1) & mask;
+            }
+            WriteRecord(slots + i * SLOT_SIZE, record);
+            entries[n].puzzle_hash = record.puzzle_hash;
+            WriteBE(entries[n].slot.data(), i, 8);
+            ++n;
+        });
+        if (n != num_coins) {
+            throw std::runtime_error("too few coins to write");
+        }
+        std::sort(entries, entries + num_coins);
+        out.Finish();
+    }
+
+private:
+    utils::MappedFile file_;
+    uint64_t checkpoint_id_ { 0 };
+    std::optional<uint32_t> height_;
+    std::size_t num_coins_ { 0 };
+    std::size_t num_slots_ { 0 };
+    uint8_t const* slots_ { nullptr };
+    PuzzleEntry const* entries_ { nullptr };
+};
+
+enum class LogRecordType : uint8_t { BEGIN, APPLY_BLOCK, ROLLBACK };
+
+/**
+ * The write-ahead log of the changes after a checkpoint
+ *
+ * A record is the size u32 of the payload, the payload and the SHA256 of the payload. The log starts with a BEGIN
+ * record of the checkpoint ID, a log which starts with another ID belongs to an older checkpoint and it is ignored.
+ */
+class LogFile
+{
+public:
+    /// Open the log to append, the log is emptied when `truncate` is true
+    LogFile(std::string const& file_path, bool truncate)
+        : file_path_(file_path)
+        , file_(std::fopen(file_path.c_str(), truncate ? "wb" : "ab"))
+    {
+        if (!file_) {
+            throw std::runtime_error("cannot open file: " + file_path + " to write");
+        }
+        size_ = truncate ? 0 : std::filesystem::file_size(file_path);
+    }
+
+    ~LogFile()
+    {
+        if (file_) {
+            std::fclose(file_);
+        }
+    }
+
+    LogFile(LogFile const&) = delete;
+
+    LogFile& operator=(LogFile const&) = delete;
+
+    /**
+     * The record is on the disk once it returns
+     *
+     * A record which fails is cut off the log and the log is closed, every later record is refused. A record appended
+     * after a partial one would be lost with it, the log is read up to the first torn record.
+     */
+    void Append(Bytes const& payload)
+    {
+        if (!file_) {
+            throw std::runtime_error("the log failed to write before, the store can't change any more");
+        }
+        uint8_t size[4];
+        WriteBE(size, payload.size(), 4);
+        crypto_utils::SHA256 sha256;
+        sha256.Add(payload);
+        Bytes32 hash = sha256.Finish();
+        try {
+            if (std::fwrite(size, 1, sizeof(size), file_) != sizeof(size)
+                || std::fwrite(payload.data(), 1, payload.size(), file_) != payload.size()
+                || std::fwrite(hash.data(), 1, hash.size(), file_) != hash.size()) {
+                throw std::runtime_error("cannot write the log");
+            }
+            SyncFile(file_);
+        } catch (std::exception const&) {
+            // The buffered bytes are flushed by the close, so the log is cut after it
+            std::fclose(file_);
+            file_ = nullptr;
+            std::error_code ec;
+            std::filesystem::resize_file(file_path_, size_, ec);
+            throw;
+        }
+        size_ += sizeof(size) + payload.size() + hash.size();
+    }
+
+    /// Pass the payloads to `f` until it returns false or a record is torn, the size of the records read is returned
+    template <typename F> static std::size_t Read(std::string const& file_path, F&& f)
+    {
+        utils::MappedFile file(file_path);
+        uint8_t const* p = file.GetData();
+        std::size_t pos { 0 };
+        while (file.GetSize() - pos >= 4) {
+            std::size_t size = ReadBE(p + pos, 4);
+            if (file.GetSize() - pos - 4 < size + 32) {
+                break;
+            }
+            crypto_utils::SHA256 sha256;
+            sha256.Add(p + pos + 4, size);
+            if (memcmp(sha256.Finish().data(), p + pos + 4 + size, 32) != 0 || !f(p + pos + 4, size)) {
+                break;
+            }
+            pos += 4 + size + 32;
+        }
+        return pos;
+    }
+
+private:
+    std::string file_path_;
+    std::FILE* file_;
+    std::size_t size_ { 0 };
+};
+
+Bytes MakeBeginRecord(uint64_t checkpoint_id)
+{
+    Bytes payload(9);
+    payload[0] = static_cast<uint8_t>(LogRecordType::BEGIN);
+    WriteBE(payload.data() + 1, checkpoint_id, 8);
+    return payload;
+}
+
+Bytes MakeApplyBlockRecord(uint32_t height, std::vector<Coin> const& additions, std::vector<Bytes32> const& removals)
+{
+    Bytes payload(13 + additions.size() * 72 + removals.size() * 32);
+    uint8_t* p = payload.data();
+    *p++ = static_cast<uint8_t>(LogRecordType::APPLY_BLOCK);
+    WriteBE(p, height, 4);
+    WriteBE(p + 4, additions.size(), 4);
+    p += 8;
+    for (auto const& coin : additions) {
+        memcpy(p, coin.GetParentCoinInfo().data(), 32);
+        memcpy(p + 32, coin.GetPuzzleHash().data(), 32);
+        WriteBE(p + 64, coin.GetAmount(), 8);
+        p += 72;
+    }
+    WriteBE(p, removals.size(), 4);
+    p += 4;
+    for (auto const& coin_id : removals) {
+        memcpy(p, coin_id.data(), 32);
+        p += 32;
+    }
+    return payload;
+}
+
+Bytes MakeRollbackRecord(uint32_t height)
+{
+    Bytes payload(5);
+    payload[0] = static_cast<uint8_t>(LogRecordType::ROLLBACK);
+    WriteBE(payload.data() + 1, height, 4);
+    return payload;
+}
+
+/// Read the fields of a log record, a record which passes its hash but is short is a damaged log
+class RecordReader
+{
+public:
+    RecordReader(uint8_t const* data, std::size_t size)
+        : p_(data)
+        , end_(data + size)
+    {
+    }
+
+    uint8_t const* Take(std::size_t size)
+    {
+        if (static_cast<std::size_t>(end_ - p_) < size) {
+            throw std::runtime_error("the coin log is damaged");
+        }
+        uint8_t const* p = p_;
+        p_ += size;
+        return p;
+    }
+
+    uint64_t ReadInt(int size) { return ReadBE(Take(size), size); }
+
+    /// The number of the items which follow, they must fit in the rest of the record
+    std::size_t ReadCount(std::size_t item_size)
+    {
+        std::size_t count = ReadInt(4);
+        if (count > static_cast<std::size_t>(end_ - p_) / item_size) {
+            throw std::runtime_error("the coin log is damaged");
+        }
+        return count;
+    }
+
+    Bytes32 ReadHash()
+    {
+        Bytes32 hash;
+        memcpy(hash.data(), Take(hash.size()), hash.size());
+        return hash;
+    }
+
+private:
+    uint8_t const* p_;
+    uint8_t const* end_;
+};
+
+} // namespace coin_store
+
+/*******************************************************************************
+ *
+ * class CoinStore
+ *
+ ******************************************************************************/
+
+struct CoinStore::Impl {
+    coin_store::PagedTable<coin_store::CoinSlot, coin_store::CoinSlotHash> coins;
+    coin_store::PagedTable<coin_store::PuzzleSlot, coin_store::PuzzleSlotHash> puzzle_hashes;
+
+    // The blocks are undone from the back, the records are shared with the snapshots
+    std::vector<std::shared_ptr<coin_store::BlockUndo const>> undo;
+
+    std::optional<uint32_t> height;
+    std::optional<uint32_t> pruned_height;
+
+    // The coins of the last checkpoint, `coins` holds the coins added after it and the copies of the ones which change
+    std::shared_ptr<coin_store::CoinFile const> file;
+    std::size_t num_file_copies { 0 };
+    uint64_t checkpoint_id { 0 };
+
+    // Only the store which is opened from the directory writes to the log
+    std::string dir_path;
+    std::shared_ptr<coin_store::LogFile> log;
+
+    explicit Impl(std::size_t expected_coins)
+        : coins(expected_coins)
+        , puzzle_hashes(0)
+    {
+    }
+
+    /// The slot of the coin, it isn't used when the coin isn't in memory
+    std::size_t FindCoin(Bytes32 const& coin_id) const
+    {
+        return coins.Find(utils::Bytes32Hash()(coin_id),
+            [&coin_id](coin_store::CoinSlot const& slot) { return slot.record.coin_id == coin_id; });
+    }
+
+    std::size_t FindPuzzleHash(Bytes32 const& puzzle_hash) const
+    {
+        return puzzle_hashes.Find(utils::Bytes32Hash()(puzzle_hash),
+            [&puzzle_hash](coin_store::PuzzleSlot const& slot) { return slot.puzzle_hash == puzzle_hash; });
+    }
+
+    std::optional<CoinRecord> Lookup(Bytes32 const& coin_id) const
+    {
+        auto const& slot = coins.At(FindCoin(coin_id));
+        if (slot.used) {
+            return slot.value.record;
+        }
+        if (file) {
+            uint8_t const* file_slot = file->Find(coin_id);
+            if (file_slot) {
+                return coin_store::ReadRecord(file_slot);
+            }
+        }
+        return {};
+    }
+
+    /// The record in memory overrides the one in the file
+    CoinRecord Resolve(uint8_t const* file_slot) const
+    {
+        CoinRecord record = coin_store::ReadRecord(file_slot);
+        auto const& slot = coins.At(FindCoin(record.coin_id));
+        return slot.used ? slot.value.record : record;
+    }
+
+    void AddCoin(Bytes32 const& coin_id, Coin const& coin, uint32_t height)
+    {
+        coin_store::CoinSlot slot { CoinRecord { coin_id, coin.GetParentCoinInfo(), coin.GetPuzzleHash(),
+                                        coin.GetAmount(), height, 0 },
+            {}, false, false };
+        std::size_t i = FindPuzzleHash(slot.record.puzzle_hash);
+        if (puzzle_hashes.At(i).used) {
+            auto& puzzle_slot = puzzle_hashes.MutableAt(i);
+            slot.next_coin_id = puzzle_slot.value.last_coin_id;
+            slot.has_next = true;
+            puzzle_slot.value.last_coin_id = coin_id;
+        } else {
+            puzzle_hashes.Insert({ slot.record.puzzle_hash, coin_id });
+        }
+        coins.Insert(std::move(slot));
+    }
+
+    /// The coins are removed in the reverse order they are added, so the coin is the last one of its puzzle hash
+    void RemoveCoin(Bytes32 const& coin_id)
+    {
+        std::size_t i = FindCoin(coin_id);
+        coin_store::CoinSlot slot = coins.At(i).value;
+        coins.Erase(i);
+        std::size_t j = FindPuzzleHash(slot.record.puzzle_hash);
+        if (slot.has_next) {
+            puzzle_hashes.MutableAt(j).value.last_coin_id = slot.next_coin_id;
+        } else {
+            puzzle_hashes.Erase(j);
+        }
+    }
+
+    void SetSpentHeight(Bytes32 const& coin_id, uint32_t spent_height)
+    {
+        std::size_t i = FindCoin(coin_id);
+        if (!coins.At(i).used) {
+            // The coin is in the file, it is copied to memory before it changes
+            coins.Insert({ coin_store::ReadRecord(file->Find(coin_id)), {}, false, true });
+            ++num_file_copies;
+            i = FindCoin(coin_id);
+        }
+        coins.MutableAt(i).value.record.spent_height = spent_height;
+    }
+};
+
+CoinStore::CoinStore(std::size_t expected_coins)
+    : m_pimpl(new Impl(expected_coins))
+{
+}
+
+CoinStore::~CoinStore() { }
+
+CoinStore::CoinStore(CoinStore const& rhs)
+    : m_pimpl(new Impl(*rhs.m_pimpl))
+{
+    m_pimpl->dir_path.clear();
+    m_pimpl->log.reset();
+}
+
+CoinStore& CoinStore::operator=(CoinStore const& rhs)
+{
+    if (this != &rhs) {
+        *m_pimpl = *rhs.m_pimpl;
+        m_pimpl->dir_path.clear();
+        m_pimpl->log.reset();
+    }
+    return *this;
+}
+
+CoinStore::CoinStore(CoinStore&& rhs) noexcept = default;
+
+CoinStore& CoinStore::operator=(CoinStore&& rhs) noexcept = default;
+
+CoinStore CoinStore::Open(std::string const& dir_path)
+{
+    std::filesystem::create_directories(dir_path);
+    std::string data_path = (std::filesystem::path(dir_path) / coin_store::DATA_FILE_NAME).string();
+    std::string log_path = (std::filesystem::path(dir_path) / coin_store::LOG_FILE_NAME).string();
+
+    CoinStore store;
+    auto& impl = *store.m_pimpl;
+    if (std::filesystem::exists(data_path)) {
+        impl.file = std::make_shared<coin_store::CoinFile const>(data_path);
+        impl.checkpoint_id = impl.file->GetCheckpointId();
+        impl.height = impl.pruned_height = impl.file->GetHeight();
+    }
+
+    bool matched { false };
+    std::size_t log_size { 0 };
+    if (std::filesystem::exists(log_path)) {
+        log_size = coin_store::LogFile::Read(log_path, [&](uint8_t const* data, std::size_t size) {
+            coin_store::RecordReader reader(data, size);
+            auto type = static_cast<coin_store::LogRecordType>(reader.ReadInt(1));
+            if (!matched) {
+                matched = type == coin_store::LogRecordType::BEGIN && reader.ReadInt(8) == impl.checkpoint_id;
+                return matched;
+            }
+            if (type == coin_store::LogRecordType::APPLY_BLOCK) {
+                auto height = static_cast<uint32_t>(reader.ReadInt(4));
+                std::vector<Coin> additions(reader.ReadCount(72));
+                for (auto& coin : additions) {
+                    Bytes32 parent_coin_info = reader.ReadHash();
+                    Bytes32 puzzle_hash = reader.ReadHash();
+                    coin = Coin(parent_coin_info, puzzle_hash, reader.ReadInt(8));
+                }
+                std::vector<Bytes32> removals(reader.ReadCount(32));
+                for (auto& coin_id : removals) {
+                    coin_id = reader.ReadHash();
+                }
+                store.ApplyBlock(height, additions, removals);
+            } else if (type == coin_store::LogRecordType::ROLLBACK) {
+                store.Rollback(static_cast<uint32_t>(reader.ReadInt(4)));
+            } else {
+                throw std::runtime_error("the coin log is damaged");
+            }
+            return true;
+        });
+    }
+    if (matched) {
+        // A record torn by a crash is cut off before the next one is appended
+        std::filesystem::resize_file(log_path, log_size);
+        impl.log = std::make_shared<coin_store::LogFile>(log_path, false);
+    } else {
+        impl.log = std::make_shared<coin_store::LogFile>(log_path, true);
+        impl.log->Append(coin_store::MakeBeginRecord(impl.checkpoint_id));
+        coin_store::SyncDirectory(dir_path);
+    }
+    impl.dir_path = dir_path;
+    return store;
+}
+
+void CoinStore::Checkpoint()
+{
+    auto& impl = *m_pimpl;
+    if (!impl.log) {
+        throw std::runtime_error("the store isn't opened from a directory");
+    }
+    std::string data_path = (std::filesystem::path(impl.dir_path) / coin_store::DATA_FILE_NAME).string();
+    std::string log_path = (std::filesystem::path(impl.dir_path) / coin_store::LOG_FILE_NAME).string();
+    uint64_t checkpoint_id = impl.checkpoint_id + 1;
+
+    coin_store::CoinFile::Write(data_path + ".tmp", checkpoint_id, impl.height, GetSize(), [&impl](auto&& write) {
+        if (impl.file) {
+            impl.file->ForEach([&](uint8_t const* file_slot) { write(impl.Resolve(file_slot)); });
+        }
+        impl.coins.ForEach([&](coin_store::CoinSlot const& slot) {
+            if (!slot.from_file) {
+                write(slot.record);
+            }
+        });
+    });
+    std::filesystem::rename(data_path + ".tmp", data_path);
+    coin_store::SyncDirectory(impl.dir_path);
+    // The old log doesn't begin with the new checkpoint ID, it is ignored if the store stops before the new log begins
+    impl.log = std::make_shared<coin_store::LogFile>(log_path, true);
+    impl.log->Append(coin_store::MakeBeginRecord(checkpoint_id));
+    coin_store::SyncDirectory(impl.dir_path);
+
+    impl.file = std::make_shared<coin_store::CoinFile const>(data_path);
+    impl.checkpoint_id = checkpoint_id;
+    impl.coins = decltype(impl.coins)(0);
+    impl.puzzle_hashes = decltype(impl.puzzle_hashes)(0);
+    impl.num_file_copies = 0;
+    impl.undo.clear();
+    impl.pruned_height = impl.height;
+}
+
+std::optional<CoinRecord> CoinStore::Get(Bytes32 const& coin_id) const { return m_pimpl->Lookup(coin_id); }
+
+std::vector<CoinRecord> CoinStore::GetByPuzzleHash(Bytes32 const& puzzle_hash, bool include_spent) const
+{
+    std::vector<CoinRecord> res;
+    auto const& puzzle_slot = m_pimpl->puzzle_hashes.At(m_pimpl->FindPuzzleHash(puzzle_hash));
+    if (puzzle_slot.used) {
+        Bytes32 coin_id = puzzle_slot.value.last_coin_id;
+        while (true) {
+            auto const& slot = m_pimpl->coins.At(m_pimpl->FindCoin(coin_id)).value;
+            if (include_spent || !slot.record.IsSpent()) {
+                res.push_back(slot.record);
+            }
+            if (!slot.has_next) {
+                break;
+            }
+            coin_id = slot.next_coin_id;
+        }
+    }
+    if (m_pimpl->file) {
+        m_pimpl->file->ForEachCoinOfPuzzleHash(puzzle_hash, [&](uint8_t const* file_slot) {
+            CoinRecord record = m_pimpl->Resolve(file_slot);
+            if (include_spent || !record.IsSpent()) {
+                res.push_back(record);
+            }
+        });
+    }
+    return res;
+}
+
+void CoinStore::ApplyBlock(uint32_t height, std::vector<Coin> const& additions, std::vector<Bytes32> const& removals)
+{
+    if (m_pimpl->height.has_value() && height <= *m_pimpl->height) {
+        throw std::runtime_error("the height of the block isn't above the last block");
+    }
+    if (height == 0 && !removals.empty()) {
+        throw std::runtime_error("no coin can be spent at height 0");
+    }
+    auto undo = std::make_shared<coin_store::BlockUndo>();
+    undo->height = height;
+    undo->additions.reserve(additions.size());
+    std::unordered_set<Bytes32, utils::Bytes32Hash> added;
+    for (auto const& coin : additions) {
+        Bytes32 coin_id = coin.GetName();
+        if (!added.insert(coin_id).second || m_pimpl->Lookup(coin_id).has_value()) {
+            throw std::runtime_error("the coin is added twice");
+        }
+        undo->additions.push_back(coin_id);
+    }
+    std::unordered_set<Bytes32, utils::Bytes32Hash> removed;
+    for (auto const& coin_id : removals) {
+        if (!removed.insert(coin_id).second) {
+            throw std::runtime_error("the coin is spent twice in the block");
+        }
+        if (added.find(coin_id) != std::end(added)) {
+            continue;
+        }
+        auto record = m_pimpl->Lookup(coin_id);
+        if (!record.has_value()) {
+            throw std::runtime_error("the coin to spend doesn't exist");
+        }
+        if (record->IsSpent()) {
+            throw std::runtime_error("the coin is spent already");
+        }
+    }
+
+    if (m_pimpl->log) {
+        m_pimpl->log->Append(coin_store::MakeApplyBlockRecord(height, additions, removals));
+    }
+    for (std::size_t i = 0; i < additions.size(); ++i) {
+        m_pimpl->AddCoin(undo->additions[i], additions[i], height);
+    }
+    for (auto const& coin_id : removals) {
+        m_pimpl->SetSpentHeight(coin_id, height);
+    }
+    undo->removals = removals;
+    m_pimpl->undo.push_back(std::move(undo));
+    m_pimpl->height = height;
+}
+
+void CoinStore::Rollback(uint32_t height)
+{
+    if (m_pimpl->pruned_height.has_value() && *m_pimpl->pruned_height > height) {
+        throw std::runtime_error("the blocks to undo are pruned");
+    }
+    if (m_pimpl->log && m_pimpl->height.has_value() && *m_pimpl->height > height) {
+        m_pimpl->log->Append(coin_store::MakeRollbackRecord(height));
+    }
+    while (!m_pimpl->undo.empty() && m_pimpl->undo.back()->height > height) {
+        auto const& undo = *m_pimpl->undo.back();
+        for (auto const& coin_id : undo.removals) {
+            m_pimpl->SetSpentHeight(coin_id, 0);
+        }
+        for (auto i = undo.additions.rbegin(); i != undo.additions.rend(); ++i) {
+            m_pimpl->RemoveCoin(*i);
+        }
+        m_pimpl->undo.pop_back();
+    }
+    m_pimpl->height = m_pimpl->undo.empty() ? m_pimpl->pruned_height : m_pimpl->undo.back()->height;
+}
+
+void CoinStore::PruneUndo(uint32_t height)
+{
+    auto i = std::find_if(std::begin(m_pimpl->undo), std::end(m_pimpl->undo),
+        [height](std::shared_ptr<coin_store::BlockUndo const> const& undo) { return undo->height > height; });
+    if (i != std::begin(m_pimpl->undo)) {
+        m_pimpl->pruned_height = (*(i - 1))->height;
+        m_pimpl->undo.erase(std::begin(m_pimpl->undo), i);
+    }
+}
+
+uint32_t CoinStore::GetHeight() const { return m_pimpl->height.value_or(0); }
+
+std::size_t CoinStore::GetSize() const
+{
+    std::size_t num_file_coins = m_pimpl->file ? m_pimpl->file->GetSize() : 0;
+    return num_file_coins + m_pimpl->coins.GetSize() - m_pimpl->num_file_copies;
+}
+
+std::size_t CoinStore::GetMemoryUsage() const
+{
+    return m_pimpl->coins.GetMemoryUsage() + m_pimpl->puzzle_hashes.GetMemoryUsage();
+}
+
+} // namespace chia
@@ -0,0 +1,268 @@
+#include "conditions.h"
+
+#include <algorithm>
+#include <limits>
+#include <unordered_set>
+
+#include "clvm_utils.h"
+#include "costs.h"
+#include "crypto_utils.h"
+
+namespace chia
+{
+
+namespace conditions
+{
+
+/// The value of an integer atom, a negative value is 0 and a value beyond 64 bits is the max, false is returned for
+/// both of them
+bool AtomToUInt64(Bytes const& atom, uint64_t& value)
+{
+    value = 0;
+    if (atom.empty()) {
+        return true;
+    }
+    if (atom[0] & 0x80) {
+        return false;
+    }
+    std::size_t i { 0 };
+    while (i < atom.size() && atom[i] == 0) {
+        ++i;
+    }
+    if (atom.size() - i > sizeof(uint64_t)) {
+        value = std::numeric_limits<uint64_t>::max();
+        return false;
+    }
+    for (; i < atom.size(); ++i) {
+        value = (value << 8) | atom[i];
+    }
+    return true;
+}
+
+uint64_t SaturatedAdd(uint64_t lhs, uint64_t rhs)
+{
+    return lhs > std::numeric_limits<uint64_t>::max() - rhs ? std::numeric_limits<uint64_t>::max() : lhs + rhs;
+}
+
+/// The ID of an announcement is the hash of the coin ID or the puzzle hash and the message
+Bytes32 AnnouncementId(Bytes32 const& origin, Bytes const& message)
+{
+    crypto_utils::SHA256 sha256;
+    sha256.Add(origin);
+    sha256.Add(message);
+    return sha256.Finish();
+}
+
+bool EqualsHash(Bytes const& atom, Bytes32 const& hash)
+{
+    return atom.size() == hash.size() && std::equal(std::begin(atom), std::end(atom), std::begin(hash));
+}
+
+bool ContainsHash(std::unordered_set<Bytes32, utils::Bytes32Hash> const& hashes, Bytes const& atom)
+{
+    if (atom.size() != utils::HASH256_LEN) {
+        return false;
+    }
+    Bytes32 hash;
+    std::copy(std::begin(atom), std::end(atom), std::begin(hash));
+    return hashes.find(hash) != std::end(hashes);
+}
+
+} // namespace conditions
+
+std::string ConditionFailureCodeToString(ConditionFailure::Code code)
+{
+    switch (code) {
+    case ConditionFailure::Code::INVALID_CONDITION:
+        return "INVALID_CONDITION";
+    case ConditionFailure::Code::ASSERT_ANNOUNCE_CONSUMED_FAILED:
+        return "ASSERT_ANNOUNCE_CONSUMED_FAILED";
+    case ConditionFailure::Code::ASSERT_MY_COIN_ID_FAILED:
+        return "ASSERT_MY_COIN_ID_FAILED";
+    case ConditionFailure::Code::ASSERT_MY_PARENT_ID_FAILED:
+        return "ASSERT_MY_PARENT_ID_FAILED";
+    case ConditionFailure::Code::ASSERT_MY_PUZZLEHASH_FAILED:
+        return "ASSERT_MY_PUZZLEHASH_FAILED";
+    case ConditionFailure::Code::ASSERT_MY_AMOUNT_FAILED:
+        return "ASSERT_MY_AMOUNT_FAILED";
+    case ConditionFailure::Code::ASSERT_SECONDS_RELATIVE_FAILED:
+        return "ASSERT_SECONDS_RELATIVE_FAILED";
+    case ConditionFailure::Code::ASSERT_SECONDS_ABSOLUTE_FAILED:
+        return "ASSERT_SECONDS_ABSOLUTE_FAILED";
+    case ConditionFailure::Code::ASSERT_HEIGHT_RELATIVE_FAILED:
+        return "ASSERT_HEIGHT_RELATIVE_FAILED";
+    case ConditionFailure::Code::ASSERT_HEIGHT_ABSOLUTE_FAILED:
+        return "ASSERT_HEIGHT_ABSOLUTE_FAILED";
+    case ConditionFailure::Code::UNKNOWN_UNSPENT:
+        return "UNKNOWN_UNSPENT";
+    }
+    return "UNKNOWN";
+}
+
+std::optional<ConditionFailure> ValidateSpendConditions(
+    std::vector<SpendConditions> const& spends, ChainState const& chain_state)
+{
+    using Code = ConditionFailure::Code;
+    using HashSet = std::unordered_set<Bytes32, utils::Bytes32Hash>;
+
+    auto is_op = [](ConditionOpcode const& opcode, uint8_t const (&op)[1]) {
+        return opcode.value.size() == 1 && opcode.value[0] == op[0];
+    };
+    std::size_t num_coin_announcements { 0 }, num_puzzle_announcements { 0 };
+    for (auto const& spend : spends) {
+        for (auto const& [opcode, cvps] : spend.conditions) {
+            if (is_op(opcode, ConditionOpcode::CREATE_COIN_ANNOUNCEMENT)) {
+                num_coin_announcements += cvps.size();
+            } else if (is_op(opcode, ConditionOpcode::CREATE_PUZZLE_ANNOUNCEMENT)) {
+                num_puzzle_announcements += cvps.size();
+            }
+        }
+    }
+    HashSet coin_announcements, puzzle_announcements;
+    coin_announcements.reserve(num_coin_announcements);
+    puzzle_announcements.reserve(num_puzzle_announcements);
+    for (std::size_t spend_index = 0; spend_index < spends.size(); ++spend_index) {
+        auto const& spend = spends[spend_index];
+        for (auto const& [opcode, cvps] : spend.conditions) {
+            bool is_coin = is_op(opcode, ConditionOpcode::CREATE_COIN_ANNOUNCEMENT);
+            if (!is_coin && !is_op(opcode, ConditionOpcode::CREATE_PUZZLE_ANNOUNCEMENT)) {
+                continue;
+            }
+            for (std::size_t n = 0; n < cvps.size(); ++n) {
+                if (cvps[n].vars.empty()) {
+                    return ConditionFailure { Code::INVALID_CONDITION, spend_index, opcode.value[0], n };
+                }
+                if (is_coin) {
+                    coin_announcements.insert(conditions::AnnouncementId(spend.coin_id, cvps[n].vars[0]));
+                } else {
+                    puzzle_announcements.insert(conditions::AnnouncementId(spend.puzzle_hash, cvps[n].vars[0]));
+                }
+            }
+        }
+    }
+
+    // The coins created by the spends are only needed when a relative timelock spends one of them
+    std::optional<HashSet> created_coins;
+    auto is_created = [&](Bytes32 const& coin_id) {
+        if (!created_coins.has_value()) {
+            created_coins.emplace();
+            for (auto const& spend : spends) {
+                for (auto const& coin : puzzle::created_outputs_for_conditions_dict(spend.conditions, spend.coin_id)) {
+                    created_coins->insert(coin.GetName());
+                }
+            }
+        }
+        return created_coins->find(coin_id) != std::end(*created_coins);
+    };
+
+    for (std::size_t spend_index = 0; spend_index < spends.size(); ++spend_index) {
+        auto const& spend = spends[spend_index];
+        Coin const& coin = spend.coin_spend.coin;
+        std::optional<CoinConfirmation> confirmation;
+        for (auto const& [opcode, cvps] : spend.conditions) {
+            if (opcode.value.size() != 1) {
+                continue;
+            }
+            uint8_t op = opcode.value[0];
+            bool is_assertion = op == ConditionOpcode::ASSERT_COIN_ANNOUNCEMENT[0]
+                || op == ConditionOpcode::ASSERT_PUZZLE_ANNOUNCEMENT[0]
+                || (op >= ConditionOpcode::ASSERT_MY_COIN_ID[0] && op <= ConditionOpcode::ASSERT_MY_AMOUNT[0])
+                || (op >= ConditionOpcode::ASSERT_SECONDS_RELATIVE[0]
+                    && op <= ConditionOpcode::ASSERT_HEIGHT_ABSOLUTE[0]);
+            if (!is_assertion) {
+                continue;
+            }
+            for (std::size_t n = 0; n < cvps.size(); ++n) {
+                auto fail = [&](Code code) { return ConditionFailure { code, spend_index, op, n }; };
+                if (cvps[n].vars.empty()) {
+                    return fail(Code::INVALID_CONDITION);
+                }
+                Bytes const& arg = cvps[n].vars[0];
+                uint64_t value { 0 };
+                bool exact = conditions::AtomToUInt64(arg, value);
+                if (op == ConditionOpcode::ASSERT_COIN_ANNOUNCEMENT[0]) {
+                    if (!conditions::ContainsHash(coin_announcements, arg)) {
+                        return fail(Code::ASSERT_ANNOUNCE_CONSUMED_FAILED);
+                    }
+                } else if (op == ConditionOpcode::ASSERT_PUZZLE_ANNOUNCEMENT[0]) {
+                    if (!conditions::ContainsHash(puzzle_announcements, arg)) {
+                        return fail(Code::ASSERT_ANNOUNCE_CONSUMED_FAILED);
+                    }
+                } else if (op == ConditionOpcode::ASSERT_MY_COIN_ID[0]) {
+                    if (!conditions::EqualsHash(arg, spend.coin_id)) {
+                        return fail(Code::ASSERT_MY_COIN_ID_FAILED);
+                    }
+                } else if (op == ConditionOpcode::ASSERT_MY_PARENT_ID[0]) {
+                    if (!conditions::EqualsHash(arg, coin.GetParentCoinInfo())) {
+                        return fail(Code::ASSERT_MY_PARENT_ID_FAILED);
+                    }
+                } else if (op == ConditionOpcode::ASSERT_MY_PUZZLEHASH[0]) {
+                    if (!conditions::EqualsHash(arg, spend.puzzle_hash)) {
+                        return fail(Code::ASSERT_MY_PUZZLEHASH_FAILED);
+                    }
+                } else if (op == ConditionOpcode::ASSERT_MY_AMOUNT[0]) {
+                    if (!exact || value != coin.GetAmount()) {
+                        return fail(Code::ASSERT_MY_AMOUNT_FAILED);
+                    }
+                } else if (op == ConditionOpcode::ASSERT_SECONDS_ABSOLUTE[0]) {
+                    if (chain_state.timestamp < value) {
+                        return fail(Code::ASSERT_SECONDS_ABSOLUTE_FAILED);
+                    }
+                } else if (op == ConditionOpcode::ASSERT_HEIGHT_ABSOLUTE[0]) {
+                    if (chain_state.prev_transaction_block_height < value) {
+                        return fail(Code::ASSERT_HEIGHT_ABSOLUTE_FAILED);
+                    }
+                } else if (value > 0) {
+                    if (!confirmation.has_value()) {
+                        if (chain_state.get_coin_confirmation) {
+                            confirmation = chain_state.get_coin_confirmation(spend.coin_id);
+                        }
+                        if (!confirmation.has_value()) {
+                            if (!is_created(spend.coin_id)) {
+                                return fail(Code::UNKNOWN_UNSPENT);
+                            }
+                            confirmation = CoinConfirmation { chain_state.prev_transaction_block_height + 1,
+                                chain_state.timestamp };
+                        }
+                    }
+                    if (op == ConditionOpcode::ASSERT_SECONDS_RELATIVE[0]) {
+                        if (chain_state.timestamp < conditions::SaturatedAdd(confirmation->timestamp, value)) {
+                            return fail(Code::ASSERT_SECONDS_RELATIVE_FAILED);
+                        }
+                    } else if (chain_state.prev_transaction_block_height
+                        < conditions::SaturatedAdd(confirmation->height, value)) {
+                        return fail(Code::ASSERT_HEIGHT_RELATIVE_FAILED);
+                    }
+                }
+            }
+        }
+    }
+    return {};
+}
+
+std::optional<ConditionFailure> ValidateBundleConditions(
+    SpendBundle const& spend_bundle, ChainState const& chain_state, Cost max_cost)
+{
+    if (max_cost == 0) {
+        max_cost = INFINITE_COST;
+    }
+    Cost cost { 0 };
+    std::vector<SpendConditions> spends;
+    spends.reserve(spend_bundle.CoinSolutions().size());
+    for (auto const& coin_spend : spend_bundle.CoinSolutions()) {
+        if (!coin_spend.puzzle_reveal.has_value() || !coin_spend.solution.has_value()) {
+            throw std::runtime_error("the puzzle reveal or the solution is missing");
+        }
+        if (cost >= max_cost) {
+            throw std::runtime_error("cost exceeded");
+        }
+        SpendConditions spend { coin_spend, coin_spend.coin.GetName(), coin_spend.coin.GetPuzzleHash(), {}, 0 };
+        std::tie(spend.conditions, spend.cost) = puzzle::conditions_dict_for_solution(
+            *coin_spend.puzzle_reveal, *coin_spend.solution, max_cost - cost);
+        cost += spend.cost;
+        spends.push_back(std::move(spend));
+    }
+    return ValidateSpendConditions(spends, chain_state);
+}
+
+} // namespace chia
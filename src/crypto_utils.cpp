@@ -3,6 +3,7 @@
 #include "clvm_utils.h"
 
 #include <stdexcept>
+#include <vector>
 
 namespace chia
 {
@@ -20,18 +21,31 @@ namespace crypto_utils
 
 #ifdef USE_COMMON_CRYPTO
 #include <CommonCrypto/CommonCrypto.h>
+#include <CommonCrypto/CommonRandom.h>
 
 struct SHA256::Impl {
-    void Add(Bytes const& buff) { m_buff = utils::ConnectBuffers(m_buff, buff); }
+    Impl() { CC_SHA256_Init(&ctx_); }
 
-    void Finish(uint8_t* pout) { CC_SHA256(m_buff.data(), static_cast<CC_LONG>(m_buff.size()), pout); }
+    void Reset() { CC_SHA256_Init(&ctx_); }
+
+    void Add(uint8_t const* data, std::size_t size) { CC_SHA256_Update(&ctx_, data, static_cast<CC_LONG>(size)); }
+
+    void Finish(uint8_t* pout) { CC_SHA256_Final(pout, &ctx_); }
 
 private:
-    Bytes m_buff;
+    CC_SHA256_CTX ctx_;
 };
 
+void RandomBytes(uint8_t* out, std::size_t size)
+{
+    if (CCRandomGenerateBytes(out, size) != kCCSuccess) {
+        throw std::runtime_error("failed to generate random bytes");
+    }
+}
+
 #else
 #include <openssl/evp.h>
+#include <openssl/rand.h>
 
 void _C(int ret)
 {
@@ -49,7 +63,10 @@ struct SHA256::Impl {
 
     ~Impl() { EVP_MD_CTX_destroy(ctx_); }
 
-    void Add(Bytes const& buff) { _C(EVP_DigestUpdate(ctx_, buff.data(), buff.size())); }
+    /// The digest of the context is kept, looking it up again costs more than hashing a short message
+    void Reset() { _C(EVP_DigestInit_ex(ctx_, nullptr, nullptr)); }
+
+    void Add(uint8_t const* data, std::size_t size) { _C(EVP_DigestUpdate(ctx_, data, size)); }
 
     void Finish(uint8_t* pout)
     {
@@ -61,16 +78,63 @@ private:
     EVP_MD_CTX* ctx_;
 };
 
+void RandomBytes(uint8_t* out, std::size_t size)
+{
+    if (RAND_bytes(out, static_cast<int>(size)) != 1) {
+        throw std::runtime_error("failed to generate random bytes");
+    }
+}
+
 #endif
 
+std::size_t const MAX_IDLE_CONTEXTS = 16;
+
+struct SHA256::IdlePool {
+    ~IdlePool() { destroyed = true; }
+
+    std::vector<std::unique_ptr<Impl>> contexts;
+
+    /// A trivial thread_local isn't destroyed, a hash which outlives the pool at the exit of the thread or in a static
+    /// object reads it to release its own context
+    static thread_local bool destroyed;
+};
+
+thread_local bool SHA256::IdlePool::destroyed { false };
+
+std::vector<std::unique_ptr<SHA256::Impl>>* SHA256::IdleContexts()
+{
+    if (IdlePool::destroyed) {
+        return nullptr;
+    }
+    thread_local IdlePool pool;
+    return &pool.contexts;
+}
+
 SHA256::SHA256()
-    : m_pimpl(new Impl)
 {
+    auto contexts = IdleContexts();
+    if (!contexts || contexts->empty()) {
+        m_pimpl.reset(new Impl);
+        return;
+    }
+    m_pimpl = std::move(contexts->back());
+    contexts->pop_back();
 }
 
-SHA256::~SHA256() { }
+SHA256::~SHA256()
+{
+    auto contexts = IdleContexts();
+    if (contexts && contexts->size() < MAX_IDLE_CONTEXTS) {
+        try {
+            m_pimpl->Reset();
+            contexts->push_back(std::move(m_pimpl));
+        } catch (std::exception const&) {
+            // The context is released with this object
+        }
+    }
+}
 
-void SHA256::Add(Bytes const& bytes) { m_pimpl->Add(bytes); }
+void SHA256::Add(uint8_t const* data, std::size_t size) { m_pimpl->Add(data, size); }
 
 Bytes32 SHA256::Finish()
 {
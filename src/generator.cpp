@@ -0,0 +1,121 @@
+#include "generator.h"
+
+#include <stdexcept>
+#include <unordered_map>
+
+#include "clvm_utils.h"
+#include "costs.h"
+#include "int.h"
+
+namespace chia
+{
+
+namespace generator
+{
+
+/// The remaining cost of the block, a limit of 0 means no limit to `Program::Run` so it is never passed on
+Cost RemainingCost(Cost max_cost, Cost used)
+{
+    if (used >= max_cost) {
+        throw std::runtime_error("cost exceeded");
+    }
+    return max_cost - used;
+}
+
+/// The cost of the conditions which create coins or ask for signatures
+Cost ConditionCost(std::map<ConditionOpcode, std::vector<ConditionWithArgs>> const& conditions)
+{
+    Cost cost { 0 };
+    for (auto const& [opcode, cvps] : conditions) {
+        if (opcode.value.size() != 1) {
+            continue;
+        }
+        uint8_t op = opcode.value[0];
+        if (op == ConditionOpcode::CREATE_COIN[0]) {
+            cost += cvps.size() * CREATE_COIN_COST;
+        } else if (op == ConditionOpcode::AGG_SIG_UNSAFE[0] || op == ConditionOpcode::AGG_SIG_ME[0]) {
+            cost += cvps.size() * AGG_SIG_COST;
+        }
+    }
+    return cost;
+}
+
+/// The tree hashes of the puzzle reveals by node, a puzzle shared by many spends is hashed once
+class PuzzleHashCache
+{
+public:
+    Bytes32 Get(CLVMObjectPtr const& puzzle)
+    {
+        auto i = hashes_.find(puzzle.get());
+        if (i != std::end(hashes_)) {
+            return i->second;
+        }
+        Bytes32 puzzle_hash = Program(puzzle).GetTreeHash();
+        hashes_.emplace(puzzle.get(), puzzle_hash);
+        return puzzle_hash;
+    }
+
+private:
+    std::unordered_map<CLVMObject const*, Bytes32> hashes_;
+};
+
+} // namespace generator
+
+GeneratorRunner::GeneratorRunner(std::optional<Program> rom)
+    : rom_(std::move(rom))
+{
+}
+
+BlockConditions GeneratorRunner::Run(
+    Program const& generator, std::vector<Bytes> const& generator_refs, Cost max_cost) const
+{
+    ListBuilder refs;
+    for (auto const& ref : generator_refs) {
+        refs.Add(ToSExp(ref));
+    }
+    auto generator_args = ToSExpList(refs.GetRoot());
+
+    if (max_cost == 0) {
+        max_cost = INFINITE_COST;
+    }
+    BlockConditions block;
+    CLVMObjectPtr result;
+    if (rom_.has_value()) {
+        std::tie(block.generator_cost, result)
+            = rom_->Run(ToSExpList(generator.GetSExp(), generator_args), max_cost);
+    } else {
+        std::tie(block.generator_cost, result) = generator.Run(generator_args, max_cost);
+    }
+    block.cost = block.generator_cost;
+
+    generator::PuzzleHashCache puzzle_hashes;
+    ArgsIter i(First(result));
+    while (!i.IsEof()) {
+        ArgsIter spend(i.NextCLVMObj());
+        Bytes parent_coin_info = spend.Next();
+        if (parent_coin_info.size() != utils::HASH256_LEN) {
+            throw std::runtime_error("invalid parent coin info");
+        }
+        auto puzzle = spend.NextCLVMObj();
+        uint64_t amount = Int(spend.Next()).ToUInt();
+        Program solution(spend.NextCLVMObj());
+
+        SpendConditions spend_conditions;
+        spend_conditions.puzzle_hash = puzzle_hashes.Get(puzzle);
+        spend_conditions.coin_spend = CoinSpend(
+            Coin(utils::BytesToHash(parent_coin_info), spend_conditions.puzzle_hash, amount), Program(puzzle), solution);
+        spend_conditions.coin_id = spend_conditions.coin_spend.coin.GetName();
+        std::tie(spend_conditions.conditions, spend_conditions.cost) = puzzle::conditions_dict_for_solution(
+            *spend_conditions.coin_spend.puzzle_reveal, solution, generator::RemainingCost(max_cost, block.cost));
+        Cost condition_cost = generator::ConditionCost(spend_conditions.conditions);
+        block.condition_cost += condition_cost;
+        block.cost += spend_conditions.cost + condition_cost;
+        if (block.cost > max_cost) {
+            throw std::runtime_error("cost exceeded");
+        }
+        block.spends.push_back(std::move(spend_conditions));
+    }
+    return block;
+}
+
+} // namespace chia
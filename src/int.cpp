@@ -117,11 +117,56 @@ Bytes Int::ToBytes(bool* neg) const
     if (neg) {
         *neg = neg2;
     }
+    if (r.size() % 2 == 1) {
+        // The hex string of the value has no leading zero, 0x102 must be 01 02 rather than 10 02
+        r.insert(std::begin(r), '0');
+    }
     return utils::BytesFromHex(r);
 }
 
+Int Int::FromSignedBytes(Bytes const& bytes)
+{
+    if (bytes.empty()) {
+        return Int(0L);
+    }
+    mpz_class mpz(Int(bytes).impl_->mpz);
+    if (bytes[0] & 0x80) {
+        mpz -= mpz_class(1) << (8 * bytes.size());
+    }
+    Int res;
+    res.impl_ = create_impl_from_mpz(std::move(mpz));
+    return res;
+}
+
+Bytes Int::ToSignedBytes() const
+{
+    mpz_class const& mpz = impl_->mpz;
+    if (mpz == 0) {
+        return {};
+    }
+    bool neg;
+    Bytes bytes = ToBytes(&neg);
+    if (!neg) {
+        if (bytes[0] & 0x80) {
+            bytes.insert(std::begin(bytes), 0x00);
+        }
+        return bytes;
+    }
+    // The two's complement of n bytes is the value plus 2^(8n), one more byte is needed when its top bit is clear
+    std::size_t n = bytes.size();
+    mpz_class complement = mpz + (mpz_class(1) << (8 * n));
+    if (complement < (mpz_class(1) << (8 * n - 1))) {
+        ++n;
+        complement = mpz + (mpz_class(1) << (8 * n));
+    }
+    std::string hex = complement.get_str(16);
+    return utils::BytesFromHex(std::string(2 * n - hex.size(), '0') + hex);
+}
+
 int Int::NumBytes() const { return static_cast<int>(ToBytes().size()); }
 
+std::string Int::ToString(int base) const { return impl_->mpz.get_str(base); }
+
 int Int::ToInt() const { return static_cast<int>(impl_->mpz.get_si()); }
 
 unsigned long Int::ToUInt() const { return impl_->mpz.get_ui(); }
@@ -4,6 +4,7 @@
 #include <react-native-bls-signatures/schemes.hpp>
 
 #include <map>
+#include <mutex>
 
 #include "clvm_utils.h"
 
@@ -143,9 +144,130 @@ Key Key::GetBackupKey(uint32_t index, bool unhardened) const { return DerivePath
 
 Address Key::GetAddress(std::string_view prefix) const
 {
-    auto puzzle_hash
-        = utils::BytesToInts(utils::HashToBytes(puzzle::puzzle_for_public_key(GetPublicKey()).GetTreeHash()));
-    return bech32::EncodePuzzleHash(puzzle_hash, prefix);
+    return bech32::EncodePuzzleHash(puzzle::puzzle_for_public_key(GetPublicKey()).GetTreeHash(), prefix);
+}
+
+/*******************************************************************************
+ *
+ * class PublicKeyHandle
+ *
+ ******************************************************************************/
+
+struct PublicKeyHandle::Impl {
+    explicit Impl(bls::G1Element in_g1)
+        : g1(std::move(in_g1))
+        , public_key(adapters::public_key_from_g1(g1))
+    {
+    }
+
+    explicit Impl(PublicKey const& in_public_key)
+        : g1(adapters::public_key_to_g1(in_public_key))
+        , public_key(in_public_key)
+    {
+    }
+
+    bls::G1Element g1;
+    PublicKey public_key;
+};
+
+PublicKeyHandle::PublicKeyHandle() { }
+
+PublicKeyHandle::PublicKeyHandle(PublicKey const& public_key)
+    : impl_(std::make_shared<Impl>(public_key))
+{
+}
+
+PublicKeyHandle::PublicKeyHandle(bls::G1Element const& g1)
+    : impl_(std::make_shared<Impl>(g1))
+{
+}
+
+bool PublicKeyHandle::IsEmpty() const { return impl_ == nullptr; }
+
+PublicKey const& PublicKeyHandle::GetPublicKey() const
+{
+    if (IsEmpty()) {
+        throw std::runtime_error("the public key handle is empty");
+    }
+    return impl_->public_key;
+}
+
+bls::G1Element const& PublicKeyHandle::GetG1Element() const
+{
+    if (IsEmpty()) {
+        throw std::runtime_error("the public key handle is empty");
+    }
+    return impl_->g1;
+}
+
+/*******************************************************************************
+ *
+ * class CachedKey
+ *
+ ******************************************************************************/
+
+struct CachedKey::Impl {
+    explicit Impl(PrivateKey const& in_priv_key)
+        : priv_key(in_priv_key)
+        , bls_priv_key(adapters::private_key_to_bls_private_key(in_priv_key))
+    {
+    }
+
+    PublicKeyHandle const& GetPublicKeyHandle()
+    {
+        std::call_once(public_key_once, [this]() { public_key = PublicKeyHandle(bls_priv_key.GetG1Element()); });
+        return public_key;
+    }
+
+    PrivateKey priv_key;
+    bls::PrivateKey bls_priv_key;
+    std::once_flag public_key_once;
+    PublicKeyHandle public_key;
+};
+
+bool CachedKey::VerifySignature(PublicKeyHandle const& public_key, Bytes const& message, Signature const& signature)
+{
+    return bls::AugSchemeMPL().Verify(public_key.GetG1Element(), message, adapters::signature_to_g2(signature));
+}
+
+PublicKeyHandle CachedKey::AggregatePublicKeys(std::vector<PublicKeyHandle> const& public_keys)
+{
+    std::vector<bls::G1Element> pks = adapters::convert_container<bls::G1Element>(
+        public_keys, [](PublicKeyHandle const& public_key) { return public_key.GetG1Element(); });
+    return PublicKeyHandle(bls::AugSchemeMPL().Aggregate(pks));
+}
+
+bool CachedKey::AggregateVerifySignature(
+    std::vector<PublicKeyHandle> const& public_keys, std::vector<Bytes> const& messages, Signature const& signature)
+{
+    std::vector<bls::G1Element> pks = adapters::convert_container<bls::G1Element>(
+        public_keys, [](PublicKeyHandle const& public_key) { return public_key.GetG1Element(); });
+    return bls::AugSchemeMPL().AggregateVerify(pks, messages, adapters::signature_to_g2(signature));
+}
+
+CachedKey::CachedKey(PrivateKey const& priv_key)
+    : impl_(std::make_shared<Impl>(priv_key))
+{
+}
+
+CachedKey::CachedKey(Key const& key)
+    : CachedKey(key.GetPrivateKey())
+{
+}
+
+PrivateKey const& CachedKey::GetPrivateKey() const { return impl_->priv_key; }
+
+bls::PrivateKey const& CachedKey::GetBlsPrivateKey() const { return impl_->bls_priv_key; }
+
+PublicKey const& CachedKey::GetPublicKey() const { return impl_->GetPublicKeyHandle().GetPublicKey(); }
+
+PublicKeyHandle const& CachedKey::GetPublicKeyHandle() const { return impl_->GetPublicKeyHandle(); }
+
+Signature CachedKey::Sign(Bytes const& message) const
+{
+    // The augmented scheme prepends the public key to the message, pass the cached one so it isn't derived again
+    auto const& g1 = GetPublicKeyHandle().GetG1Element();
+    return adapters::signature_from_g2(bls::AugSchemeMPL().Sign(impl_->bls_priv_key, message, g1));
 }
 
 } // namespace wallet
@@ -0,0 +1,329 @@
+#include "mempool.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <mutex>
+#include <optional>
+#include <unordered_map>
+#include <unordered_set>
+
+#include "clvm_utils.h"
+#include "costs.h"
+#include "key.h"
+#include "pairing_cache.h"
+
+namespace chia
+{
+
+namespace mempool
+{
+
+struct HeapEntry {
+    double fee_per_cost;
+    uint64_t id;
+
+    /// The greatest fee per cost is on the top, an older item goes first with the same fee per cost
+    bool operator<(HeapEntry const& rhs) const
+    {
+        if (fee_per_cost != rhs.fee_per_cost) {
+            return fee_per_cost < rhs.fee_per_cost;
+        }
+        return id > rhs.id;
+    }
+};
+
+struct Validated {
+    Cost cost { 0 };
+    uint64_t fee { 0 };
+    std::vector<Bytes32> removals;
+    std::vector<Coin> additions;
+    std::vector<PublicKey> public_keys;
+    std::vector<Bytes> messages;
+};
+
+/// Run every spend of the bundle and check the amounts, the error is returned when the bundle is invalid
+std::optional<std::string> Validate(SpendBundle const& spend_bundle, MempoolOptions const& options, Validated& res)
+{
+    Cost const max_cost = options.max_bundle_cost ? options.max_bundle_cost : INFINITE_COST;
+    uint64_t amount_in { 0 }, amount_out { 0 }, reserved_fee { 0 };
+    std::unordered_set<Bytes32, utils::Bytes32Hash> removals;
+    for (auto const& coin_spend : spend_bundle.CoinSolutions()) {
+        if (!coin_spend.puzzle_reveal.has_value() || !coin_spend.solution.has_value()) {
+            return "the puzzle reveal or the solution is missing";
+        }
+        Bytes32 coin_id = coin_spend.coin.GetName();
+        if (!removals.insert(coin_id).second) {
+            return "the coin is spent twice";
+        }
+        if (coin_spend.puzzle_reveal->GetTreeHash() != coin_spend.coin.GetPuzzleHash()) {
+            return "the puzzle reveal doesn't match the puzzle hash";
+        }
+        if (res.cost >= max_cost) {
+            return "cost exceeded";
+        }
+        auto [conditions, cost]
+            = puzzle::conditions_dict_for_solution(*coin_spend.puzzle_reveal, *coin_spend.solution, max_cost - res.cost);
+        res.cost += cost;
+        if (res.cost > max_cost) {
+            return "cost exceeded";
+        }
+        for (auto& coin : puzzle::created_outputs_for_conditions_dict(conditions, coin_id)) {
+            if (__builtin_add_overflow(amount_out, coin.GetAmount(), &amount_out)) {
+                return "the outputs overflow";
+            }
+            res.additions.push_back(std::move(coin));
+        }
+        auto i = conditions.find(ConditionOpcode(ConditionOpcode::RESERVE_FEE));
+        if (i != std::end(conditions)) {
+            for (auto const& cvp : i->second) {
+                uint64_t fee = utils::UIntFromAtom<uint64_t>(cvp.vars.at(0));
+                if (__builtin_add_overflow(reserved_fee, fee, &reserved_fee)) {
+                    return "the reserved fee overflows";
+                }
+            }
+        }
+        for (auto const& p : puzzle::pkm_pairs_for_conditions_dict(conditions, coin_id, options.additional_data)) {
+            res.public_keys.push_back(std::get<0>(p));
+            res.messages.push_back(std::get<1>(p));
+        }
+        if (__builtin_add_overflow(amount_in, coin_spend.coin.GetAmount(), &amount_in)) {
+            return "the inputs overflow";
+        }
+        res.removals.push_back(coin_id);
+    }
+    if (res.removals.empty()) {
+        return "the bundle spends nothing";
+    }
+    if (amount_out > amount_in) {
+        return "the outputs are more than the inputs";
+    }
+    res.fee = amount_in - amount_out;
+    if (reserved_fee > res.fee) {
+        return "the fee is less than the reserved fee";
+    }
+    return {};
+}
+
+} // namespace mempool
+
+struct Mempool::Impl {
+    static std::size_t const NUM_SHARDS = 64;
+
+    struct Shard {
+        std::mutex mutex;
+        std::unordered_map<Bytes32, uint64_t, utils::Bytes32Hash> spent_coins;
+    };
+
+    MempoolOptions options;
+    wallet::PairingCache* cache;
+    std::atomic<uint64_t> next_id { 1 };
+
+    // The shards are locked before `items_mutex` and in the order of their indices
+    std::array<Shard, NUM_SHARDS> shards;
+
+    mutable std::mutex items_mutex;
+    std::unordered_map<uint64_t, MempoolItemPtr> items;
+    std::vector<mempool::HeapEntry> heap;
+    std::size_t num_stale_entries { 0 };
+    Cost total_cost { 0 };
+
+    Impl(MempoolOptions options, wallet::PairingCache* cache)
+        : options(std::move(options))
+        , cache(cache)
+    {
+    }
+
+    static std::size_t ShardIndex(Bytes32 const& coin_id) { return utils::Bytes32Hash()(coin_id) % NUM_SHARDS; }
+
+    /// Lock the shards of the coins in the order of their indices
+    std::vector<std::unique_lock<std::mutex>> LockShards(std::vector<Bytes32> const& coin_ids)
+    {
+        std::vector<std::size_t> indices;
+        indices.reserve(coin_ids.size());
+        for (auto const& coin_id : coin_ids) {
+            indices.push_back(ShardIndex(coin_id));
+        }
+        std::sort(std::begin(indices), std::end(indices));
+        indices.erase(std::unique(std::begin(indices), std::end(indices)), std::end(indices));
+        std::vector<std::unique_lock<std::mutex>> locks;
+        locks.reserve(indices.size());
+        for (std::size_t index : indices) {
+            locks.emplace_back(shards[index].mutex);
+        }
+        return locks;
+    }
+
+    /// The shards of the item and `items_mutex` are locked
+    void EraseLocked(MempoolItemPtr const& item)
+    {
+        for (auto const& coin_id : item->removals) {
+            auto& spent_coins = shards[ShardIndex(coin_id)].spent_coins;
+            auto i = spent_coins.find(coin_id);
+            if (i != std::end(spent_coins) && i->second == item->id) {
+                spent_coins.erase(i);
+            }
+        }
+        items.erase(item->id);
+        total_cost -= item->cost;
+        // The entry of the item is left in the heap, the heap is rebuilt once most of its entries are stale
+        ++num_stale_entries;
+        if (num_stale_entries > heap.size() / 2) {
+            heap.clear();
+            for (auto const& [id, other] : items) {
+                heap.push_back({ other->GetFeePerCost(), id });
+            }
+            std::make_heap(std::begin(heap), std::end(heap));
+            num_stale_entries = 0;
+        }
+    }
+};
+
+Mempool::Mempool(MempoolOptions options, wallet::PairingCache* cache)
+    : m_pimpl(new Impl(std::move(options), cache))
+{
+}
+
+Mempool::~Mempool() { }
+
+Mempool::AddResult Mempool::Add(SpendBundle spend_bundle)
+{
+    mempool::Validated validated;
+    try {
+        auto error = mempool::Validate(spend_bundle, m_pimpl->options, validated);
+        if (error.has_value()) {
+            return { Status::INVALID, nullptr, {}, std::move(*error) };
+        }
+        if (m_pimpl->options.verify_signature) {
+            bool verified = m_pimpl->cache
+                ? m_pimpl->cache->AggregateVerify(
+                    validated.public_keys, validated.messages, spend_bundle.GetAggregatedSignature())
+                : wallet::Key::AggregateVerifySignature(
+                    validated.public_keys, validated.messages, spend_bundle.GetAggregatedSignature());
+            if (!verified) {
+                return { Status::INVALID, nullptr, {}, "invalid signature" };
+            }
+        }
+    } catch (std::exception const& e) {
+        return { Status::INVALID, nullptr, {}, e.what() };
+    }
+
+    auto item = std::make_shared<MempoolItem const>(MempoolItem { m_pimpl->next_id++, std::move(spend_bundle),
+        validated.cost, validated.fee, std::move(validated.removals), std::move(validated.additions) });
+
+    auto locks = m_pimpl->LockShards(item->removals);
+    std::vector<uint64_t> conflicts;
+    for (auto const& coin_id : item->removals) {
+        auto const& spent_coins = m_pimpl->shards[Impl::ShardIndex(coin_id)].spent_coins;
+        auto i = spent_coins.find(coin_id);
+        if (i != std::end(spent_coins)) {
+            conflicts.push_back(i->second);
+        }
+    }
+    if (!conflicts.empty()) {
+        std::sort(std::begin(conflicts), std::end(conflicts));
+        conflicts.erase(std::unique(std::begin(conflicts), std::end(conflicts)), std::end(conflicts));
+        return { Status::CONFLICT, nullptr, std::move(conflicts), "the coins are spent by other items" };
+    }
+    for (auto const& coin_id : item->removals) {
+        m_pimpl->shards[Impl::ShardIndex(coin_id)].spent_coins.emplace(coin_id, item->id);
+    }
+    std::lock_guard<std::mutex> items_lock(m_pimpl->items_mutex);
+    m_pimpl->items.emplace(item->id, item);
+    m_pimpl->heap.push_back({ item->GetFeePerCost(), item->id });
+    std::push_heap(std::begin(m_pimpl->heap), std::end(m_pimpl->heap));
+    m_pimpl->total_cost += item->cost;
+    return { Status::ADDED, item, {}, {} };
+}
+
+MempoolItemPtr Mempool::Get(uint64_t id) const
+{
+    std::lock_guard<std::mutex> lock(m_pimpl->items_mutex);
+    auto i = m_pimpl->items.find(id);
+    return i != std::end(m_pimpl->items) ? i->second : nullptr;
+}
+
+MempoolItemPtr Mempool::GetBySpentCoin(Bytes32 const& coin_id) const
+{
+    uint64_t id;
+    {
+        auto& shard = m_pimpl->shards[Impl::ShardIndex(coin_id)];
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        auto i = shard.spent_coins.find(coin_id);
+        if (i == std::end(shard.spent_coins)) {
+            return nullptr;
+        }
+        id = i->second;
+    }
+    return Get(id);
+}
+
+bool Mempool::Remove(uint64_t id)
+{
+    auto item = Get(id);
+    if (!item) {
+        return false;
+    }
+    auto locks = m_pimpl->LockShards(item->removals);
+    std::lock_guard<std::mutex> items_lock(m_pimpl->items_mutex);
+    if (m_pimpl->items.find(id) == std::end(m_pimpl->items)) {
+        // Removed by another thread
+        return false;
+    }
+    m_pimpl->EraseLocked(item);
+    return true;
+}
+
+std::size_t Mempool::RemoveConflicts(std::vector<Bytes32> const& coin_ids)
+{
+    std::unordered_set<uint64_t> ids;
+    for (auto const& coin_id : coin_ids) {
+        auto& shard = m_pimpl->shards[Impl::ShardIndex(coin_id)];
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        auto i = shard.spent_coins.find(coin_id);
+        if (i != std::end(shard.spent_coins)) {
+            ids.insert(i->second);
+        }
+    }
+    std::size_t num_removed { 0 };
+    for (uint64_t id : ids) {
+        if (Remove(id)) {
+            ++num_removed;
+        }
+    }
+    return num_removed;
+}
+
+std::vector<MempoolItemPtr> Mempool::CreateBlockCandidate(Cost max_cost) const
+{
+    std::vector<MempoolItemPtr> res;
+    std::lock_guard<std::mutex> lock(m_pimpl->items_mutex);
+    auto heap = m_pimpl->heap;
+    Cost cost { 0 };
+    while (!heap.empty() && cost < max_cost) {
+        std::pop_heap(std::begin(heap), std::end(heap));
+        uint64_t id = heap.back().id;
+        heap.pop_back();
+        auto i = m_pimpl->items.find(id);
+        if (i == std::end(m_pimpl->items) || i->second->cost > max_cost - cost) {
+            continue;
+        }
+        cost += i->second->cost;
+        res.push_back(i->second);
+    }
+    return res;
+}
+
+std::size_t Mempool::GetSize() const
+{
+    std::lock_guard<std::mutex> lock(m_pimpl->items_mutex);
+    return m_pimpl->items.size();
+}
+
+Cost Mempool::GetTotalCost() const
+{
+    std::lock_guard<std::mutex> lock(m_pimpl->items_mutex);
+    return m_pimpl->total_cost;
+}
+
+} // namespace chia
@@ -25,15 +25,15 @@ OpResult op_sha256(CLVMObjectPtr args)
 {
     crypto_utils::SHA256 sha256;
     Cost cost { SHA256_BASE_COST };
-    int arg_len { 0 };
+    Cost arg_len { 0 };
     ArgsIter iter(args);
     while (!iter.IsEof()) {
-        Bytes b = iter.Next();
-        sha256.Add(b);
-        arg_len += static_cast<int>(b.size());
+        auto const& atom = iter.NextAtom();
+        sha256.Add(atom.GetData(), atom.GetSize());
+        arg_len += atom.GetSize();
         cost += SHA256_COST_PER_ARG;
     }
-    cost += arg_len * SHA256_COST_PER_ARG;
+    cost += arg_len * SHA256_COST_PER_BYTE;
     return MallocCost(cost, ToSExp(utils::HashToBytes(sha256.Finish())));
 }
 
@@ -213,39 +213,48 @@ OpResult op_strlen(CLVMObjectPtr args)
 
 OpResult op_substr(CLVMObjectPtr args)
 {
-    auto arg_list = ListBytes(args);
-    int arg_count = static_cast<int>(arg_list.size());
+    int arg_count = ListLen(args);
     if (arg_count != 2 && arg_count != 3) {
         throw std::runtime_error("substr takes exactly 2 or 3 arguments");
     }
-    auto s0 = arg_list[0];
-    int i1 = Int(arg_list[1]).ToInt();
-    int i2 { 0 };
-    if (arg_count == 2) {
-        i2 = static_cast<int>(s0.size());
-    } else {
-        i2 = Int(arg_list[2]).ToInt();
-    }
-    if (i2 > s0.size() || i2 < i1 || i2 < 0 || i1 < 0) {
+    ArgsIter iter(args);
+    auto const& s0 = iter.NextAtom();
+    int size = static_cast<int>(s0.GetSize());
+    int i1 = Int(iter.Next()).ToInt();
+    int i2 { size };
+    if (arg_count == 3) {
+        i2 = Int(iter.Next()).ToInt();
+    }
+    if (i2 > size || i2 < i1 || i2 < 0 || i1 < 0) {
         throw std::runtime_error("invalid indices for substr");
     }
-    Bytes s = utils::SubBytes(s0, i1, i2 - i1);
+    // Atoms own their storage, so the slice is the only copy
+    Bytes s(s0.GetData() + i1, s0.GetData() + i2);
     Cost cost = 1;
-    return std::make_tuple(cost, ToSExp(s));
+    return std::make_tuple(cost, ToSExp(std::move(s)));
 }
 
 OpResult op_concat(CLVMObjectPtr args)
 {
     Cost cost { CONCAT_BASE_COST };
-    utils::BufferConnector conn;
+    std::size_t size { 0 };
     ArgsIter iter(args);
     while (!iter.IsEof()) {
-        conn.Append(iter.Next());
+        size += iter.NextAtom().GetSize();
         cost += CONCAT_COST_PER_ARG;
     }
-    auto r = conn.GetResult();
+    Bytes r(size);
+    std::size_t pos { 0 };
+    ArgsIter iter_copy(args);
+    while (!iter_copy.IsEof()) {
+        auto const& atom = iter_copy.NextAtom();
+        if (atom.GetSize() > 0) {
+            memcpy(r.data() + pos, atom.GetData(), atom.GetSize());
+            pos += atom.GetSize();
+        }
+    }
     cost += r.size() * CONCAT_COST_PER_BYTE;
-    return MallocCost(cost, ToSExp(r));
+    return MallocCost(cost, ToSExp(std::move(r)));
 }
 
 OpResult op_ash(CLVMObjectPtr args)
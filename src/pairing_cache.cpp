@@ -0,0 +1,137 @@
+#include "pairing_cache.h"
+
+#include <react-native-bls-signatures/elements.hpp>
+#include <react-native-bls-signatures/schemes.hpp>
+
+#include <list>
+#include <mutex>
+#include <optional>
+#include <unordered_map>
+
+#include "clvm_utils.h"
+#include "crypto_utils.h"
+#include "key.h"
+#include "thread_pool.h"
+
+namespace chia::wallet
+{
+
+struct PairingCache::Impl {
+    using Entry = std::pair<Bytes32, bls::GTElement>;
+
+    explicit Impl(std::size_t in_capacity)
+        : capacity(in_capacity)
+    {
+    }
+
+    std::optional<bls::GTElement> Get(Bytes32 const& key)
+    {
+        std::lock_guard<std::mutex> lg(mtx);
+        auto i = index.find(key);
+        if (i == std::end(index)) {
+            return {};
+        }
+        entries.splice(std::begin(entries), entries, i->second);
+        return i->second->second;
+    }
+
+    void Put(Bytes32 const& key, bls::GTElement const& pairing)
+    {
+        std::lock_guard<std::mutex> lg(mtx);
+        if (capacity == 0 || index.find(key) != std::end(index)) {
+            return;
+        }
+        entries.emplace_front(key, pairing);
+        index.emplace(key, std::begin(entries));
+        while (entries.size() > capacity) {
+            index.erase(entries.back().first);
+            entries.pop_back();
+        }
+    }
+
+    std::size_t const capacity;
+    mutable std::mutex mtx;
+    std::list<Entry> entries;
+    std::unordered_map<Bytes32, std::list<Entry>::iterator, utils::Bytes32Hash> index;
+};
+
+PairingCache::PairingCache(std::size_t capacity)
+    : impl_(new Impl(capacity))
+{
+}
+
+PairingCache::~PairingCache() { }
+
+bool PairingCache::AggregateVerify(
+    std::vector<PublicKey> const& public_keys, std::vector<Bytes> const& messages, Signature const& signature)
+{
+    if (public_keys.size() != messages.size()) {
+        return false;
+    }
+    std::optional<bls::G2Element> sig;
+    try {
+        sig = bls::G2Element::FromByteVector(utils::bytes_cast<Key::SIG_LEN>(signature));
+    } catch (std::exception const&) {
+        return false;
+    }
+    if (public_keys.empty()) {
+        return sig.value() == bls::G2Element();
+    }
+
+    std::vector<Bytes32> keys;
+    std::vector<std::optional<bls::GTElement>> pairings;
+    std::vector<std::size_t> missing;
+    keys.reserve(public_keys.size());
+    pairings.reserve(public_keys.size());
+    for (std::size_t i = 0; i < public_keys.size(); ++i) {
+        keys.push_back(
+            crypto_utils::MakeSHA256(utils::bytes_cast<Key::PUB_KEY_LEN>(public_keys[i]), messages[i]));
+        pairings.push_back(impl_->Get(keys.back()));
+        if (!pairings.back().has_value()) {
+            missing.push_back(i);
+        }
+    }
+
+    // Hashing to G2 and the Miller loop of each missing pairing are independent
+    std::string const& dst = bls::AugSchemeMPL::CIPHERSUITE_ID;
+    try {
+        ThreadPool::GetInstance().ParallelFor(missing.size(), [&](std::size_t n) {
+            std::size_t i = missing[n];
+            Bytes augmented_message = utils::bytes_cast<Key::PUB_KEY_LEN>(public_keys[i]);
+            augmented_message.insert(std::end(augmented_message), std::begin(messages[i]), std::end(messages[i]));
+            auto pk = bls::G1Element::FromByteVector(utils::bytes_cast<Key::PUB_KEY_LEN>(public_keys[i]));
+            auto hash = bls::G2Element::FromMessage(
+                augmented_message, reinterpret_cast<uint8_t const*>(dst.data()), static_cast<int>(dst.size()));
+            pairings[i] = pk.Pair(hash);
+        });
+    } catch (std::exception const&) {
+        // an invalid public key
+        return false;
+    }
+    for (std::size_t i : missing) {
+        impl_->Put(keys[i], pairings[i].value());
+    }
+
+    bls::GTElement product = pairings[0].value();
+    for (std::size_t i = 1; i < pairings.size(); ++i) {
+        product = product * pairings[i].value();
+    }
+    return product == sig->Pair(bls::G1Element::Generator());
+}
+
+std::size_t PairingCache::GetSize() const
+{
+    std::lock_guard<std::mutex> lg(impl_->mtx);
+    return impl_->entries.size();
+}
+
+std::size_t PairingCache::GetCapacity() const { return impl_->capacity; }
+
+void PairingCache::Clear()
+{
+    std::lock_guard<std::mutex> lg(impl_->mtx);
+    impl_->index.clear();
+    impl_->entries.clear();
+}
+
+} // namespace chia::wallet
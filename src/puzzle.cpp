@@ -10,6 +10,8 @@
 
 #include "condition_opcode.h"
 #include "key.h"
+#include "scalar.h"
+#include "thread_pool.h"
 
 namespace chia::puzzle
 {
@@ -42,46 +44,38 @@ PredefinedPrograms::PredefinedPrograms()
     progs_[Names::P2_CONDITIONS] = utils::BytesFromHex("ff04ffff0101ff0280");
 }
 
-wallet::Key KeyFromRawPrivateKey(Bytes const& bytes)
-{
-    if (bytes.size() < wallet::Key::PRIV_KEY_LEN) {
-        throw std::runtime_error("not enough number of bytes for a private-key");
-    }
-    auto private_key = utils::bytes_cast<wallet::Key::PRIV_KEY_LEN>(bytes);
-    return wallet::Key(private_key);
-}
-
-char const* SZ_GROUP_ORDER = "73EDA753299D7D483339D80809A1D80553BDA402FFFE5BFEFFFFFFFF00000001";
-
-Int GROUP_ORDER() { return Int(utils::BytesFromHex(SZ_GROUP_ORDER)); }
-
-Int calculate_synthetic_offset(PublicKey const& public_key, Bytes32 const& hidden_puzzle_hash)
+Scalar calculate_synthetic_offset(PublicKey const& public_key, Bytes32 const& hidden_puzzle_hash)
 {
     Bytes32 hash = crypto_utils::MakeSHA256(
         utils::bytes_cast<wallet::Key::PUB_KEY_LEN>(public_key), utils::HashToBytes(hidden_puzzle_hash));
-    Int offset(utils::bytes_cast<utils::HASH256_LEN>(hash));
-    offset %= GROUP_ORDER();
-    return offset;
+    // The offset is read as a signed number like `int_from_bytes` does
+    return Scalar::FromBytes(hash, true);
 }
 
 PublicKey calculate_synthetic_public_key(PublicKey const& public_key, Bytes32 const& hidden_puzzle_hash)
 {
-    Int offset = calculate_synthetic_offset(public_key, hidden_puzzle_hash);
-    auto bytes = offset.ToBytes();
-    wallet::Key synthetic_offset = KeyFromRawPrivateKey(bytes);
-    return wallet::Key::AggregatePublicKeys({ public_key, synthetic_offset.GetPublicKey() });
+    Scalar offset = calculate_synthetic_offset(public_key, hidden_puzzle_hash);
+    wallet::CachedKey synthetic_offset(offset.ToPrivateKey());
+    return wallet::CachedKey::AggregatePublicKeys(
+        { wallet::PublicKeyHandle(public_key), synthetic_offset.GetPublicKeyHandle() })
+        .GetPublicKey();
+}
+
+std::vector<PublicKey> calculate_synthetic_public_keys(
+    std::vector<PublicKey> const& public_keys, Bytes32 const& hidden_puzzle_hash)
+{
+    std::vector<PublicKey> synthetic_public_keys(public_keys.size());
+    ThreadPool::GetInstance().ParallelFor(public_keys.size(), [&](std::size_t i) {
+        synthetic_public_keys[i] = calculate_synthetic_public_key(public_keys[i], hidden_puzzle_hash);
+    });
+    return synthetic_public_keys;
 }
 
 PrivateKey calculate_synthetic_secret_key(PrivateKey const& private_key, Bytes32 const& hidden_puzzle_hash)
 {
-    Int secret_exponent = Int(utils::bytes_cast<wallet::Key::PRIV_KEY_LEN>(private_key));
-    wallet::Key key(private_key);
-    PublicKey public_key = key.GetPublicKey();
-    Int synthetic_offset = calculate_synthetic_offset(public_key, hidden_puzzle_hash);
-    Int synthetic_secret_exponent = (secret_exponent + synthetic_offset) % GROUP_ORDER();
-    auto bytes = synthetic_secret_exponent.ToBytes();
-    wallet::Key synthetic_secret_key = KeyFromRawPrivateKey(bytes);
-    return synthetic_secret_key.GetPrivateKey();
+    wallet::CachedKey key(private_key);
+    Scalar synthetic_offset = calculate_synthetic_offset(key.GetPublicKey(), hidden_puzzle_hash);
+    return (Scalar::FromPrivateKey(private_key) + synthetic_offset).ToPrivateKey();
 }
 
 Program puzzle_for_synthetic_public_key(PublicKey const& synthetic_public_key)
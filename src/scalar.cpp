@@ -0,0 +1,147 @@
+#include "scalar.h"
+
+namespace chia
+{
+
+namespace scalar
+{
+
+using Limbs = Scalar::Limbs;
+
+Limbs const R = { 0xFFFFFFFF00000001, 0x53BDA402FFFE5BFE, 0x3339D80809A1D805, 0x73EDA753299D7D48 };
+
+/// 2^256 mod r, which is 2^256 - 2r
+Limbs const R_256 = { 0x00000001FFFFFFFE, 0x5884B7FA00034802, 0x998C4FEFECBC4FF5, 0x1824B159ACC5056F };
+
+uint64_t add(Limbs& res, Limbs const& a, Limbs const& b)
+{
+    uint64_t carry = 0;
+    for (int i = 0; i < Scalar::NUM_LIMBS; ++i) {
+        uint64_t s = a[i] + carry;
+        uint64_t c1 = s < carry;
+        res[i] = s + b[i];
+        carry = c1 | (res[i] < s);
+    }
+    return carry;
+}
+
+uint64_t sub(Limbs& res, Limbs const& a, Limbs const& b)
+{
+    uint64_t borrow = 0;
+    for (int i = 0; i < Scalar::NUM_LIMBS; ++i) {
+        uint64_t d = a[i] - b[i];
+        uint64_t b1 = a[i] < b[i];
+        res[i] = d - borrow;
+        borrow = b1 | (d < borrow);
+    }
+    return borrow;
+}
+
+/// Take `a` when mask is all ones, `b` when it is zero
+void select(Limbs& res, uint64_t mask, Limbs const& a, Limbs const& b)
+{
+    for (int i = 0; i < Scalar::NUM_LIMBS; ++i) {
+        res[i] = (a[i] & mask) | (b[i] & ~mask);
+    }
+}
+
+/// Subtract r once when v >= r, `carry` is the bit above the top limb of v
+void reduce_once(Limbs& v, uint64_t carry)
+{
+    Limbs d;
+    uint64_t borrow = sub(d, v, R);
+    // keep v only when it is below r and there was no carry
+    uint64_t keep = (borrow & (carry ^ 1)) * ~uint64_t(0);
+    select(v, keep, v, d);
+}
+
+/// (a - b) mod r for reduced a and b
+void sub_mod(Limbs& res, Limbs const& a, Limbs const& b)
+{
+    uint64_t borrow = sub(res, a, b);
+    Limbs s;
+    add(s, res, R);
+    select(res, borrow * ~uint64_t(0), s, res);
+}
+
+} // namespace scalar
+
+Scalar::Limbs const& Scalar::GroupOrder() { return scalar::R; }
+
+Scalar Scalar::FromBytes(Bytes32 const& bytes, bool is_signed)
+{
+    Scalar res;
+    for (int i = 0; i < NUM_LIMBS; ++i) {
+        uint64_t limb = 0;
+        for (int j = 0; j < 8; ++j) {
+            limb = (limb << 8) | bytes[(NUM_LIMBS - 1 - i) * 8 + j];
+        }
+        res.limbs_[i] = limb;
+    }
+    // r < 2^256 < 3r, two subtractions reduce any 256-bit number
+    scalar::reduce_once(res.limbs_, 0);
+    scalar::reduce_once(res.limbs_, 0);
+    // a negative number is the unsigned value minus 2^256
+    uint64_t neg = (is_signed ? static_cast<uint64_t>(bytes[0] >> 7) : 0) * ~uint64_t(0);
+    Limbs d;
+    scalar::sub_mod(d, res.limbs_, scalar::R_256);
+    scalar::select(res.limbs_, neg, d, res.limbs_);
+    return res;
+}
+
+Scalar Scalar::FromPrivateKey(PrivateKey const& private_key) { return FromBytes(private_key); }
+
+Scalar::Scalar()
+    : limbs_ { 0, 0, 0, 0 }
+{
+}
+
+Scalar::Scalar(uint64_t val)
+    : limbs_ { val, 0, 0, 0 }
+{
+}
+
+bool Scalar::IsZero() const { return (limbs_[0] | limbs_[1] | limbs_[2] | limbs_[3]) == 0; }
+
+Bytes32 Scalar::ToBytes() const
+{
+    Bytes32 res;
+    for (int i = 0; i < NUM_LIMBS; ++i) {
+        for (int j = 0; j < 8; ++j) {
+            res[(NUM_LIMBS - 1 - i) * 8 + j] = static_cast<uint8_t>(limbs_[i] >> (56 - j * 8));
+        }
+    }
+    return res;
+}
+
+PrivateKey Scalar::ToPrivateKey() const { return ToBytes(); }
+
+Scalar Scalar::operator+(Scalar const& rhs) const
+{
+    Scalar res;
+    uint64_t carry = scalar::add(res.limbs_, limbs_, rhs.limbs_);
+    scalar::reduce_once(res.limbs_, carry);
+    return res;
+}
+
+Scalar Scalar::operator-(Scalar const& rhs) const
+{
+    Scalar res;
+    scalar::sub_mod(res.limbs_, limbs_, rhs.limbs_);
+    return res;
+}
+
+Scalar Scalar::operator-() const { return Scalar() - *this; }
+
+bool Scalar::operator==(Scalar const& rhs) const
+{
+    uint64_t diff = 0;
+    for (int i = 0; i < NUM_LIMBS; ++i) {
+        diff |= limbs_[i] ^ rhs.limbs_[i];
+    }
+    return diff == 0;
+}
+
+bool Scalar::operator!=(Scalar const& rhs) const { return !(*this == rhs); }
+
+} // namespace chia
@@ -1,9 +1,12 @@
 #include "sexp_prog.h"
 
 #include <algorithm>
+#include <cstring>
 #include <iostream>
 #include <memory>
 #include <stdexcept>
+#include <unordered_map>
+#include <unordered_set>
 
 #include <sstream>
 
@@ -19,6 +22,7 @@ namespace chia
 
 uint8_t const MAX_SINGLE_BYTE = 0x7F;
 uint8_t const CONS_BOX_MARKER = 0xFF;
+uint8_t const BACK_REFERENCE = 0xFE;
 
 std::string NodeTypeToString(NodeType type)
 {
@@ -78,7 +82,8 @@ CLVMObject_Atom::CLVMObject_Atom(long i)
 CLVMObject_Atom::CLVMObject_Atom(Int const& i)
     : CLVMObject(NodeType::Atom_Int)
 {
-    bytes_ = i.ToBytes(&neg_);
+    bytes_ = i.ToSignedBytes();
+    neg_ = !bytes_.empty() && (bytes_[0] & 0x80);
 }
 
 CLVMObject_Atom::CLVMObject_Atom(PublicKey const& g1_element)
@@ -93,8 +98,7 @@ bool CLVMObject_Atom::IsFalse() const
         return true;
     }
     if (GetNodeType() == NodeType::Atom_Int) {
-        Int i(bytes_, neg_);
-        return i == Int(0);
+        return bytes_.empty();
     }
     return false;
 }
@@ -115,9 +119,9 @@ Bytes CLVMObject_Atom::GetBytes() const { return bytes_; }
 
 std::string CLVMObject_Atom::AsString() const { return std::string(std::begin(bytes_), std::end(bytes_)); }
 
-long CLVMObject_Atom::AsLong() const { return Int(bytes_, neg_).ToInt(); }
+long CLVMObject_Atom::AsLong() const { return Int::FromSignedBytes(bytes_).ToInt(); }
 
-Int CLVMObject_Atom::AsInt() const { return Int(bytes_, neg_); }
+Int CLVMObject_Atom::AsInt() const { return Int::FromSignedBytes(bytes_); }
 
 PublicKey CLVMObject_Atom::AsG1Element() const { return utils::bytes_cast<wallet::Key::PUB_KEY_LEN>(bytes_); }
 
@@ -128,6 +132,26 @@ CLVMObject_Pair::CLVMObject_Pair(CLVMObjectPtr first, CLVMObjectPtr rest, NodeTy
 {
 }
 
+CLVMObject_Pair::~CLVMObject_Pair()
+{
+    // Move the pairs only owned by this node to a stack, so each of them is destroyed without children to release
+    std::vector<CLVMObjectPtr> nodes;
+    auto take = [&nodes](CLVMObjectPtr& node) {
+        if (node && node.use_count() == 1 && IsPair(node)) {
+            nodes.push_back(std::move(node));
+        }
+    };
+    take(first_);
+    take(rest_);
+    while (!nodes.empty()) {
+        CLVMObjectPtr node = std::move(nodes.back());
+        nodes.pop_back();
+        auto pair = static_cast<CLVMObject_Pair*>(node.get());
+        take(pair->first_);
+        take(pair->rest_);
+    }
+}
+
 CLVMObjectPtr CLVMObject_Pair::GetFirstNode() const { return first_; }
 
 CLVMObjectPtr CLVMObject_Pair::GetRestNode() const { return rest_; }
@@ -274,7 +298,11 @@ std::tuple<bool, Bytes, CLVMObjectPtr> ArgsNext(CLVMObjectPtr obj)
 
 std::tuple<Cost, CLVMObjectPtr> MallocCost(Cost cost, CLVMObjectPtr atom)
 {
-    return std::make_tuple(cost + ToBytes(atom).size() * MALLOC_COST_PER_BYTE, atom);
+    if (!IsAtom(atom)) {
+        throw std::runtime_error("it's not an ATOM");
+    }
+    auto size = static_cast<CLVMObject_Atom const*>(atom.get())->GetSize();
+    return std::make_tuple(cost + size * MALLOC_COST_PER_BYTE, atom);
 }
 
 std::vector<std::tuple<Int, int>> ListInts(CLVMObjectPtr args)
@@ -316,33 +344,7 @@ class OpStack : public Stack<Op>
 {
 };
 
-class StreamReader
-{
-public:
-    explicit StreamReader(Bytes const& bytes)
-        : bytes_(bytes)
-    {
-    }
-
-    Bytes operator()(int size) const
-    {
-        Bytes res;
-        int read_size = std::min<int>(size, static_cast<int>(bytes_.size() - pos_));
-        if (read_size == 0) {
-            return res;
-        }
-        res.resize(read_size);
-        memcpy(res.data(), bytes_.data() + pos_, read_size);
-        pos_ += read_size;
-        return res;
-    }
-
-private:
-    Bytes const& bytes_;
-    mutable int pos_ { 0 };
-};
-
-CLVMObjectPtr AtomFromStream(StreamReadFunc f, uint8_t b)
+CLVMObjectPtr AtomFromStream(StreamReadFunc& f, uint8_t b)
 {
     if (b == 0x80) {
         return ToSExp(MakeNull());
@@ -412,65 +414,348 @@ CLVMObjectPtr SExpFromStream(ReadStreamFunc f)
     return val_stack.Pop();
 }
 
-Bytes AtomToBytes(Bytes const& as_atom)
+class BufferReader
 {
-    uint64_t size = as_atom.size();
-    if (size == 0) {
-        return utils::ByteToBytes('\x80');
+public:
+    BufferReader(uint8_t const* data, std::size_t size)
+        : data_(data)
+        , size_(size)
+    {
     }
-    if (size == 1) {
-        if (as_atom[0] <= MAX_SINGLE_BYTE) {
-            return as_atom;
+
+    uint8_t ReadByte()
+    {
+        if (pos_ >= size_) {
+            throw std::runtime_error("bad encoding");
+        }
+        return data_[pos_++];
+    }
+
+    uint8_t const* Read(std::size_t size)
+    {
+        if (size > size_ - pos_) {
+            throw std::runtime_error("bad encoding");
+        }
+        uint8_t const* p = data_ + pos_;
+        pos_ += size;
+        return p;
+    }
+
+    std::size_t GetPos() const { return pos_; }
+
+    uint8_t const* GetCurrent() const { return data_ + pos_; }
+
+private:
+    uint8_t const* data_;
+    std::size_t size_;
+    std::size_t pos_ { 0 };
+};
+
+/// Read the bytes of an atom which starts with the byte `b`, the bytes are left in the buffer
+uint8_t const* ReadAtom(BufferReader& reader, uint8_t b, std::size_t& size)
+{
+    if (b == 0x80) {
+        size = 0;
+        return nullptr;
+    }
+    if (b <= MAX_SINGLE_BYTE) {
+        // The atom is the byte just read
+        size = 1;
+        return reader.GetCurrent() - 1;
+    }
+    int bit_count { 0 };
+    uint8_t bit_mask { 0x80 };
+    while (b & bit_mask) {
+        bit_count += 1;
+        b &= 0xff ^ bit_mask;
+        bit_mask >>= 1;
+    }
+    uint64_t atom_size = b;
+    if (bit_count > 1) {
+        uint8_t const* p = reader.Read(bit_count - 1);
+        for (int i = 0; i < bit_count - 1; ++i) {
+            atom_size = (atom_size << 8) | p[i];
         }
     }
-    Bytes size_blob;
+    if (atom_size >= 0x400000000) {
+        throw std::runtime_error("blob too large");
+    }
+    size = static_cast<std::size_t>(atom_size);
+    return reader.Read(size);
+}
+
+CLVMObjectPtr AtomFromBuffer(BufferReader& reader, uint8_t b)
+{
+    if (b == 0x80) {
+        return MakeNull();
+    }
+    std::size_t size;
+    uint8_t const* p = ReadAtom(reader, b, size);
+    return ToSExp(Bytes(p, p + size));
+}
+
+CLVMObjectPtr SExpFromBuffer(BufferReader& reader)
+{
+    enum class Op { READ, CONS };
+    std::vector<Op> ops { Op::READ };
+    std::vector<CLVMObjectPtr> vals;
+    while (!ops.empty()) {
+        Op op = ops.back();
+        ops.pop_back();
+        if (op == Op::CONS) {
+            auto right = std::move(vals.back());
+            vals.pop_back();
+            auto left = std::move(vals.back());
+            vals.pop_back();
+            vals.push_back(std::make_shared<CLVMObject_Pair>(std::move(left), std::move(right), NodeType::Tuple));
+            continue;
+        }
+        uint8_t b = reader.ReadByte();
+        if (b == CONS_BOX_MARKER) {
+            ops.push_back(Op::CONS);
+            ops.push_back(Op::READ);
+            ops.push_back(Op::READ);
+            continue;
+        }
+        vals.push_back(AtomFromBuffer(reader, b));
+    }
+    return vals.back();
+}
+
+/// Follow a path from the node, the bits are taken from the lowest one of the last byte, 0 goes to the first node and 1
+/// goes to the rest node, the highest set bit ends the path
+CLVMObjectPtr TraversePath(uint8_t const* path, std::size_t size, CLVMObjectPtr node)
+{
+    std::size_t end = 0;
+    while (end < size && path[end] == 0) {
+        ++end;
+    }
+    if (end == size) {
+        return MakeNull();
+    }
+    uint8_t end_mask = msb_mask(path[end]);
+    std::size_t i = size - 1;
+    uint8_t mask { 0x01 };
+    while (i > end || mask < end_mask) {
+        if (!IsPair(node)) {
+            throw std::runtime_error("path into atom");
+        }
+        auto pair = static_cast<CLVMObject_Pair const*>(node.get());
+        node = (path[i] & mask) ? pair->GetRestNode() : pair->GetFirstNode();
+        if (mask == 0x80) {
+            mask = 0x01;
+            --i;
+        } else {
+            mask <<= 1;
+        }
+    }
+    return node;
+}
+
+CLVMObjectPtr SExpFromBufferWithBackrefs(BufferReader& reader)
+{
+    // The values are kept in a list with the newest one first, a back reference is a path into that list
+    enum class Op { READ, CONS };
+    std::vector<Op> ops { Op::READ };
+    CLVMObjectPtr values = MakeNull();
+    auto push = [&values](CLVMObjectPtr node) {
+        values = std::make_shared<CLVMObject_Pair>(std::move(node), std::move(values), NodeType::Tuple);
+    };
+    auto pop = [&values]() {
+        auto pair = static_cast<CLVMObject_Pair const*>(values.get());
+        auto node = pair->GetFirstNode();
+        values = pair->GetRestNode();
+        return node;
+    };
+    while (!ops.empty()) {
+        Op op = ops.back();
+        ops.pop_back();
+        if (op == Op::CONS) {
+            auto right = pop();
+            auto left = pop();
+            push(std::make_shared<CLVMObject_Pair>(std::move(left), std::move(right), NodeType::Tuple));
+            continue;
+        }
+        uint8_t b = reader.ReadByte();
+        if (b == CONS_BOX_MARKER) {
+            ops.push_back(Op::CONS);
+            ops.push_back(Op::READ);
+            ops.push_back(Op::READ);
+        } else if (b == BACK_REFERENCE) {
+            std::size_t size;
+            uint8_t const* path = ReadAtom(reader, reader.ReadByte(), size);
+            push(TraversePath(path, size, values));
+        } else {
+            push(AtomFromBuffer(reader, b));
+        }
+    }
+    return First(values);
+}
+
+/// The size of the atom after it is serialized
+uint64_t SerializedAtomLength(uint8_t const* data, std::size_t size)
+{
+    if (size == 0 || (size == 1 && data[0] <= MAX_SINGLE_BYTE)) {
+        return 1;
+    }
     if (size < 0x40) {
-        size_blob = utils::ByteToBytes(static_cast<uint8_t>(0x80 | size));
-    } else if (size < 0x2000) {
-        size_blob.push_back(static_cast<uint8_t>(0xC0 | (size >> 8)));
-        size_blob.push_back(static_cast<uint8_t>((size >> 8) & 0xff));
-    } else if (size < 0x100000) {
-        size_blob.push_back(static_cast<uint8_t>(0xe0 | (size >> 16)));
-        size_blob.push_back(static_cast<uint8_t>((size >> 8) & 0xff));
-        size_blob.push_back(static_cast<uint8_t>((size >> 0) & 0xff));
-    } else if (size < 0x8000000) {
-        size_blob.push_back(static_cast<uint8_t>(0xF0 | (size >> 24)));
-        size_blob.push_back(static_cast<uint8_t>((size >> 16) & 0xFF));
-        size_blob.push_back(static_cast<uint8_t>((size >> 8) & 0xFF));
-        size_blob.push_back(static_cast<uint8_t>((size >> 0) & 0xFF));
-    } else if (size < 0x400000000) {
-        size_blob.push_back(static_cast<uint8_t>(0xF8 | (size >> 32)));
-        size_blob.push_back(static_cast<uint8_t>((size >> 24) & 0xFF));
-        size_blob.push_back(static_cast<uint8_t>((size >> 16) & 0xFF));
-        size_blob.push_back(static_cast<uint8_t>((size >> 8) & 0xFF));
-        size_blob.push_back(static_cast<uint8_t>((size >> 0) & 0xFF));
-    } else {
-        throw std::runtime_error("sexp too long");
+        return 1 + size;
+    }
+    if (size < 0x2000) {
+        return 2 + size;
+    }
+    if (size < 0x100000) {
+        return 3 + size;
     }
-    return utils::ConnectBuffers(size_blob, as_atom);
+    if (size < 0x8000000) {
+        return 4 + size;
+    }
+    return 5 + size;
 }
 
+/// Encode the size of an atom which isn't a single small byte, the number of bytes written to `prefix` is returned
+std::size_t AtomPrefix(uint64_t n, uint8_t (&prefix)[5])
+{
+    if (n < 0x40) {
+        prefix[0] = static_cast<uint8_t>(0x80 | n);
+        return 1;
+    }
+    if (n < 0x2000) {
+        prefix[0] = static_cast<uint8_t>(0xC0 | (n >> 8));
+        prefix[1] = static_cast<uint8_t>(n & 0xFF);
+        return 2;
+    }
+    if (n < 0x100000) {
+        prefix[0] = static_cast<uint8_t>(0xE0 | (n >> 16));
+        prefix[1] = static_cast<uint8_t>((n >> 8) & 0xFF);
+        prefix[2] = static_cast<uint8_t>(n & 0xFF);
+        return 3;
+    }
+    if (n < 0x8000000) {
+        prefix[0] = static_cast<uint8_t>(0xF0 | (n >> 24));
+        prefix[1] = static_cast<uint8_t>((n >> 16) & 0xFF);
+        prefix[2] = static_cast<uint8_t>((n >> 8) & 0xFF);
+        prefix[3] = static_cast<uint8_t>(n & 0xFF);
+        return 4;
+    }
+    if (n < 0x400000000) {
+        prefix[0] = static_cast<uint8_t>(0xF8 | (n >> 32));
+        prefix[1] = static_cast<uint8_t>((n >> 24) & 0xFF);
+        prefix[2] = static_cast<uint8_t>((n >> 16) & 0xFF);
+        prefix[3] = static_cast<uint8_t>((n >> 8) & 0xFF);
+        prefix[4] = static_cast<uint8_t>(n & 0xFF);
+        return 5;
+    }
+    throw std::runtime_error("sexp too long");
+}
+
+void WriteAtom(Bytes& out, uint8_t const* data, std::size_t size)
+{
+    if (size == 1 && data[0] <= MAX_SINGLE_BYTE) {
+        out.push_back(data[0]);
+        return;
+    }
+    uint8_t prefix[5];
+    out.insert(std::end(out), prefix, prefix + AtomPrefix(size, prefix));
+    out.insert(std::end(out), data, data + size);
+}
+
+/// Collect the writes into a fixed chunk and pass the chunk to the stream function when it is full, an atom which
+/// doesn't fit into the chunk is passed on its own
+class ChunkWriter
+{
+public:
+    explicit ChunkWriter(WriteStreamFunc const& f)
+        : f_(f)
+    {
+    }
+
+    void Write(uint8_t const* data, std::size_t size)
+    {
+        if (size > sizeof(chunk_) - used_) {
+            Flush();
+            if (size >= sizeof(chunk_)) {
+                f_(data, size);
+                return;
+            }
+        }
+        memcpy(chunk_ + used_, data, size);
+        used_ += size;
+    }
+
+    void WriteByte(uint8_t b)
+    {
+        if (used_ == sizeof(chunk_)) {
+            Flush();
+        }
+        chunk_[used_++] = b;
+    }
+
+    void WriteAtom(uint8_t const* data, std::size_t size)
+    {
+        if (size == 1 && data[0] <= MAX_SINGLE_BYTE) {
+            WriteByte(data[0]);
+            return;
+        }
+        uint8_t prefix[5];
+        Write(prefix, AtomPrefix(size, prefix));
+        Write(data, size);
+    }
+
+    void Flush()
+    {
+        if (used_ > 0) {
+            f_(chunk_, used_);
+            used_ = 0;
+        }
+    }
+
+private:
+    WriteStreamFunc const& f_;
+    uint8_t chunk_[4096];
+    std::size_t used_ { 0 };
+};
+
 Bytes SExpToStream(CLVMObjectPtr sexp)
 {
     Bytes res;
-    ValStack todo_stack;
-    todo_stack.Push(sexp);
-
-    while (!todo_stack.IsEmpty()) {
-        CLVMObjectPtr sexp = todo_stack.Pop();
-        if (IsPair(sexp)) {
+    std::vector<CLVMObject const*> todo_stack { sexp.get() };
+    while (!todo_stack.empty()) {
+        CLVMObject const* node = todo_stack.back();
+        todo_stack.pop_back();
+        if (node->GetNodeType() == NodeType::List || node->GetNodeType() == NodeType::Tuple) {
             res.push_back(CONS_BOX_MARKER);
-            CLVMObjectPtr first, rest;
-            std::tie(first, rest) = Pair(sexp);
-            todo_stack.Push(rest);
-            todo_stack.Push(first);
+            auto pair = static_cast<CLVMObject_Pair const*>(node);
+            todo_stack.push_back(pair->GetRestNode().get());
+            todo_stack.push_back(pair->GetFirstNode().get());
         } else {
-            res = utils::ConnectBuffers(res, AtomToBytes(ToBytes(sexp)));
+            auto atom = static_cast<CLVMObject_Atom const*>(node);
+            WriteAtom(res, atom->GetData(), atom->GetSize());
         }
     }
     return res;
 }
 
+void SExpToStream(CLVMObject const* root, WriteStreamFunc const& f)
+{
+    ChunkWriter writer(f);
+    std::vector<CLVMObject const*> todo_stack { root };
+    while (!todo_stack.empty()) {
+        CLVMObject const* node = todo_stack.back();
+        todo_stack.pop_back();
+        if (node->GetNodeType() == NodeType::List || node->GetNodeType() == NodeType::Tuple) {
+            writer.WriteByte(CONS_BOX_MARKER);
+            auto pair = static_cast<CLVMObject_Pair const*>(node);
+            todo_stack.push_back(pair->GetRestNode().get());
+            todo_stack.push_back(pair->GetFirstNode().get());
+        } else {
+            auto atom = static_cast<CLVMObject_Atom const*>(node);
+            writer.WriteAtom(atom->GetData(), atom->GetSize());
+        }
+    }
+    writer.Flush();
+}
+
 } // namespace stream
 
 /**
@@ -482,74 +767,533 @@ Bytes SExpToStream(CLVMObjectPtr sexp)
 namespace tree_hash
 {
 
-class OpStack;
-using Op = std::function<void(ValStack&, OpStack&)>;
+Bytes32 HashAtom(uint8_t const* data, std::size_t size)
+{
+    if (size == 0) {
+        // nil is the most common atom
+        static Bytes32 const NIL_HASH = crypto_utils::MakeSHA256(utils::ByteToBytes('\1'));
+        return NIL_HASH;
+    }
+    if (size == 1) {
+        // Opcodes and small numbers, the hashes of all single bytes are calculated once
+        static std::array<Bytes32, 256> const BYTE_HASHES = []() {
+            std::array<Bytes32, 256> hashes;
+            for (int i = 0; i < 256; ++i) {
+                hashes[i] = crypto_utils::MakeSHA256(utils::SerializeBytes(0x01, static_cast<uint8_t>(i)));
+            }
+            return hashes;
+        }();
+        return BYTE_HASHES[data[0]];
+    }
+    uint8_t const prefix { 1 };
+    crypto_utils::SHA256 sha;
+    sha.Add(&prefix, 1);
+    sha.Add(data, size);
+    return sha.Finish();
+}
 
-class OpStack : public Stack<Op>
+Bytes32 HashPair(Bytes32 const& first, Bytes32 const& rest)
 {
-};
+    uint8_t const prefix { 2 };
+    crypto_utils::SHA256 sha;
+    sha.Add(&prefix, 1);
+    sha.Add(first);
+    sha.Add(rest);
+    return sha.Finish();
+}
 
+/// An atom which equals one of `precalculated` is taken as a tree hash already
 Bytes32 SHA256TreeHash(CLVMObjectPtr sexp, std::vector<Bytes> const& precalculated = std::vector<Bytes>())
 {
-    Op handle_pair = [](ValStack& sexp_stack, OpStack& op_stack) {
-        auto p0 = sexp_stack.Pop();
-        auto p1 = sexp_stack.Pop();
-        Bytes prefix = utils::ByteToBytes('\2');
-        sexp_stack.Push(ToSExp(
-            utils::HashToBytes(crypto_utils::MakeSHA256(utils::ConnectBuffers(prefix, ToBytes(p0), ToBytes(p1))))));
-    };
+    // A pair is visited twice, the children are pushed first and then their hashes are combined
+    std::vector<std::pair<CLVMObject const*, bool>> stack { { sexp.get(), false } };
+    std::vector<Bytes32> hashes;
+    while (!stack.empty()) {
+        auto [node, children_done] = stack.back();
+        stack.pop_back();
+        if (node->GetNodeType() == NodeType::List || node->GetNodeType() == NodeType::Tuple) {
+            if (children_done) {
+                Bytes32 rest = hashes.back();
+                hashes.pop_back();
+                hashes.back() = HashPair(hashes.back(), rest);
+            } else {
+                auto pair = static_cast<CLVMObject_Pair const*>(node);
+                stack.push_back({ node, true });
+                stack.push_back({ pair->GetRestNode().get(), false });
+                stack.push_back({ pair->GetFirstNode().get(), false });
+            }
+            continue;
+        }
+        auto atom = static_cast<CLVMObject_Atom const*>(node);
+        if (!precalculated.empty()) {
+            Bytes bytes(atom->GetData(), atom->GetData() + atom->GetSize());
+            if (std::find(std::begin(precalculated), std::end(precalculated), bytes) != std::end(precalculated)) {
+                hashes.push_back(utils::BytesToHash(bytes));
+                continue;
+            }
+        }
+        hashes.push_back(HashAtom(atom->GetData(), atom->GetSize()));
+    }
+    assert(hashes.size() == 1);
+    return hashes.back();
+}
 
-    Op roll = [](ValStack& sexp_stack, OpStack& op_stack) {
-        auto p0 = sexp_stack.Pop();
-        auto p1 = sexp_stack.Pop();
-        sexp_stack.Push(p0);
-        sexp_stack.Push(p1);
-    };
+Bytes32 TreeHashFromBuffer(stream::BufferReader& reader)
+{
+    enum class Op { READ, CONS };
+    std::vector<Op> ops { Op::READ };
+    std::vector<Bytes32> hashes;
+    while (!ops.empty()) {
+        Op op = ops.back();
+        ops.pop_back();
+        if (op == Op::CONS) {
+            Bytes32 rest = hashes.back();
+            hashes.pop_back();
+            hashes.back() = HashPair(hashes.back(), rest);
+            continue;
+        }
+        uint8_t b = reader.ReadByte();
+        if (b == CONS_BOX_MARKER) {
+            ops.push_back(Op::CONS);
+            ops.push_back(Op::READ);
+            ops.push_back(Op::READ);
+            continue;
+        }
+        std::size_t size;
+        uint8_t const* p = stream::ReadAtom(reader, b, size);
+        hashes.push_back(HashAtom(p, size));
+    }
+    return hashes.back();
+}
+
+} // namespace tree_hash
+
+/**
+ * =============================================================================
+ * Back references
+ * =============================================================================
+ */
+
+namespace backrefs
+{
+
+struct NodeInfo {
+    Bytes32 tree_hash;
+    uint64_t serialized_length;
+};
+
+using NodeInfoMap = std::unordered_map<CLVMObject const*, NodeInfo>;
 
-    Op handle_sexp = [&handle_sexp, &handle_pair, &roll, &precalculated](ValStack& sexp_stack, OpStack& op_stack) {
-        auto sexp = sexp_stack.Pop();
-        if (IsPair(sexp)) {
-            CLVMObjectPtr p0, p1;
-            std::tie(p0, p1) = Pair(sexp);
-            sexp_stack.Push(p0);
-            sexp_stack.Push(p1);
-            op_stack.Push(handle_pair);
-            op_stack.Push(handle_sexp);
-            op_stack.Push(roll);
-            op_stack.Push(handle_sexp);
+/// The tree hash and the serialized length of every node under the root, a node shared by several parents is visited
+/// once
+NodeInfoMap CollectNodeInfo(CLVMObjectPtr const& root)
+{
+    NodeInfoMap infos;
+    std::vector<std::pair<CLVMObject const*, bool>> stack { { root.get(), false } };
+    while (!stack.empty()) {
+        auto [node, children_done] = stack.back();
+        stack.pop_back();
+        if (infos.find(node) != std::end(infos)) {
+            continue;
+        }
+        if (node->GetNodeType() != NodeType::List && node->GetNodeType() != NodeType::Tuple) {
+            auto atom = static_cast<CLVMObject_Atom const*>(node);
+            infos[node] = { tree_hash::HashAtom(atom->GetData(), atom->GetSize()),
+                stream::SerializedAtomLength(atom->GetData(), atom->GetSize()) };
+            continue;
+        }
+        auto pair = static_cast<CLVMObject_Pair const*>(node);
+        if (!children_done) {
+            stack.push_back({ node, true });
+            stack.push_back({ pair->GetRestNode().get(), false });
+            stack.push_back({ pair->GetFirstNode().get(), false });
+            continue;
+        }
+        auto const& first = infos.at(pair->GetFirstNode().get());
+        auto const& rest = infos.at(pair->GetRestNode().get());
+        infos[node] = { tree_hash::HashPair(first.tree_hash, rest.tree_hash),
+            1 + first.serialized_length + rest.serialized_length };
+    }
+    return infos;
+}
+
+/// Pack the directions of a path from the node up to the root into the path atom read by `TraversePath`
+Bytes ReversedPathToBytes(std::vector<uint8_t> const& path)
+{
+    std::size_t byte_count = (path.size() + 1 + 7) >> 3;
+    Bytes res(byte_count, 0);
+    std::size_t index = byte_count - 1;
+    uint8_t mask { 0x01 };
+    for (auto i = path.rbegin(); i != path.rend(); ++i) {
+        if (*i) {
+            res[index] |= mask;
+        }
+        if (mask == 0x80) {
+            mask = 0x01;
+            --index;
         } else {
-            Bytes atom = ToBytes(sexp);
-            auto i = std::find(std::begin(precalculated), std::end(precalculated), atom);
-            Bytes r;
-            if (i != std::end(precalculated)) {
-                r = atom;
-            } else {
-                Bytes prefix = utils::ByteToBytes('\1');
-                r = utils::HashToBytes(crypto_utils::MakeSHA256(utils::ConnectBuffers(prefix, atom)));
+            mask <<= 1;
+        }
+    }
+    res[index] |= mask;
+    return res;
+}
+
+/// Mirror of the value stack of the reader by tree hashes, it finds the paths which lead to a node already read
+class ReadCacheLookup
+{
+public:
+    ReadCacheLookup()
+        : root_hash_(tree_hash::HashAtom(nullptr, 0))
+    {
+        count_[root_hash_] = 1;
+    }
+
+    void Push(Bytes32 const& id)
+    {
+        Bytes32 new_root_hash = tree_hash::HashPair(id, root_hash_);
+        read_stack_.push_back({ id, root_hash_ });
+        ++count_[id];
+        ++count_[new_root_hash];
+        parent_lookup_[id].push_back({ new_root_hash, 0 });
+        parent_lookup_[root_hash_].push_back({ new_root_hash, 1 });
+        root_hash_ = new_root_hash;
+    }
+
+    Bytes32 Pop()
+    {
+        auto [id, old_root_hash] = read_stack_.back();
+        read_stack_.pop_back();
+        --count_[id];
+        --count_[root_hash_];
+        root_hash_ = old_root_hash;
+        return id;
+    }
+
+    void Pop2AndCons()
+    {
+        Bytes32 right = Pop();
+        Bytes32 left = Pop();
+        ++count_[left];
+        ++count_[right];
+        Bytes32 cons_hash = tree_hash::HashPair(left, right);
+        parent_lookup_[left].push_back({ cons_hash, 0 });
+        parent_lookup_[right].push_back({ cons_hash, 1 });
+        Push(cons_hash);
+    }
+
+    /// The shortest path to a node with the hash, an empty path is returned when no path is shorter than the node
+    Bytes FindPath(Bytes32 const& id, uint64_t serialized_length) const
+    {
+        // One byte for the back reference marker and one byte at least for the saving
+        if (serialized_length < 3) {
+            return {};
+        }
+        std::size_t const max_path_length = (serialized_length - 2) * 8 - 1;
+        std::unordered_set<Bytes32, utils::Bytes32Hash> seen { id };
+        std::vector<std::pair<Bytes32, std::vector<uint8_t>>> partial_paths { { id, {} } };
+        while (!partial_paths.empty()) {
+            std::vector<std::pair<Bytes32, std::vector<uint8_t>>> new_partial_paths;
+            for (auto const& [node, path] : partial_paths) {
+                if (node == root_hash_) {
+                    // A breadth first search, the first path found is one of the shortest
+                    return ReversedPathToBytes(path);
+                }
+                auto parents = parent_lookup_.find(node);
+                if (parents == std::end(parent_lookup_)) {
+                    continue;
+                }
+                for (auto const& [parent, direction] : parents->second) {
+                    auto count = count_.find(parent);
+                    if (count != std::end(count_) && count->second > 0 && seen.find(parent) == std::end(seen)) {
+                        if (path.size() + 1 > max_path_length) {
+                            return {};
+                        }
+                        auto new_path = path;
+                        new_path.push_back(direction);
+                        new_partial_paths.push_back({ parent, std::move(new_path) });
+                    }
+                    seen.insert(parent);
+                }
             }
-            sexp_stack.Push(ToSExp(r));
+            partial_paths = std::move(new_partial_paths);
         }
-    };
+        return {};
+    }
 
-    ValStack sexp_stack;
-    sexp_stack.Push(sexp);
-    OpStack op_stack;
-    op_stack.Push(handle_sexp);
+private:
+    Bytes32 root_hash_;
+    std::vector<std::pair<Bytes32, Bytes32>> read_stack_;
+    std::unordered_map<Bytes32, int, utils::Bytes32Hash> count_;
+    std::unordered_map<Bytes32, std::vector<std::pair<Bytes32, uint8_t>>, utils::Bytes32Hash> parent_lookup_;
+};
 
-    while (!op_stack.IsEmpty()) {
-        auto op = op_stack.Pop();
-        op(sexp_stack, op_stack);
+Bytes SExpToStreamWithBackrefs(CLVMObjectPtr sexp)
+{
+    enum class Op { PARSE, CONS };
+    auto infos = CollectNodeInfo(sexp);
+    ReadCacheLookup lookup;
+    std::vector<Op> ops { Op::PARSE };
+    std::vector<CLVMObject const*> write_stack { sexp.get() };
+    Bytes res;
+    while (!write_stack.empty()) {
+        CLVMObject const* node = write_stack.back();
+        write_stack.pop_back();
+        ops.pop_back();
+        auto const& info = infos.at(node);
+        Bytes path = lookup.FindPath(info.tree_hash, info.serialized_length);
+        if (!path.empty() && 1 + stream::SerializedAtomLength(path.data(), path.size()) < info.serialized_length) {
+            res.push_back(BACK_REFERENCE);
+            stream::WriteAtom(res, path.data(), path.size());
+            lookup.Push(info.tree_hash);
+        } else if (node->GetNodeType() == NodeType::List || node->GetNodeType() == NodeType::Tuple) {
+            res.push_back(CONS_BOX_MARKER);
+            auto pair = static_cast<CLVMObject_Pair const*>(node);
+            write_stack.push_back(pair->GetRestNode().get());
+            write_stack.push_back(pair->GetFirstNode().get());
+            ops.push_back(Op::CONS);
+            ops.push_back(Op::PARSE);
+            ops.push_back(Op::PARSE);
+        } else {
+            auto atom = static_cast<CLVMObject_Atom const*>(node);
+            stream::WriteAtom(res, atom->GetData(), atom->GetSize());
+            lookup.Push(info.tree_hash);
+        }
+        while (!ops.empty() && ops.back() == Op::CONS) {
+            ops.pop_back();
+            lookup.Pop2AndCons();
+        }
     }
+    return res;
+}
+
+} // namespace backrefs
+
+CLVMObjectPtr SExpFromStream(ReadStreamFunc f) { return stream::SExpFromStream(std::move(f)); }
 
-    assert(!sexp_stack.IsEmpty());
-    auto res = sexp_stack.Pop();
-    assert(sexp_stack.IsEmpty());
-    assert(IsAtom(res));
+void SExpToStream(CLVMObjectPtr const& sexp, WriteStreamFunc const& f) { stream::SExpToStream(sexp.get(), f); }
 
-    return utils::BytesToHash(ToBytes(res));
+CLVMObjectPtr SExpFromBuffer(uint8_t const* data, std::size_t size, std::size_t* consumed)
+{
+    stream::BufferReader reader(data, size);
+    auto sexp = stream::SExpFromBuffer(reader);
+    if (consumed) {
+        *consumed = reader.GetPos();
+    }
+    return sexp;
 }
 
-} // namespace tree_hash
+std::size_t SerializedLength(uint8_t const* data, std::size_t size)
+{
+    stream::BufferReader reader(data, size);
+    // The number of sexps left to read, a pair is replaced by its two children
+    std::size_t pending { 1 };
+    while (pending > 0) {
+        uint8_t b = reader.ReadByte();
+        if (b == CONS_BOX_MARKER) {
+            ++pending;
+            continue;
+        }
+        std::size_t atom_size;
+        stream::ReadAtom(reader, b, atom_size);
+        --pending;
+    }
+    return reader.GetPos();
+}
+
+Bytes32 TreeHashFromBytes(uint8_t const* data, std::size_t size, std::size_t* consumed)
+{
+    stream::BufferReader reader(data, size);
+    Bytes32 hash = tree_hash::TreeHashFromBuffer(reader);
+    if (consumed) {
+        *consumed = reader.GetPos();
+    }
+    return hash;
+}
+
+CLVMObjectPtr SExpFromBufferWithBackrefs(uint8_t const* data, std::size_t size, std::size_t* consumed)
+{
+    stream::BufferReader reader(data, size);
+    auto sexp = stream::SExpFromBufferWithBackrefs(reader);
+    if (consumed) {
+        *consumed = reader.GetPos();
+    }
+    return sexp;
+}
+
+Bytes SExpToBytesWithBackrefs(CLVMObjectPtr sexp) { return backrefs::SExpToStreamWithBackrefs(std::move(sexp)); }
+
+/**
+ * =============================================================================
+ * SExp Parser
+ * =============================================================================
+ */
+
+struct SExpParser::Impl {
+    enum class Op { READ, CONS };
+
+    std::size_t max_size;
+    std::size_t max_depth;
+
+    Status status { Status::NEED_MORE };
+    std::string error;
+    std::size_t consumed { 0 };
+    std::size_t total_size { 0 };
+
+    std::vector<Op> ops { Op::READ };
+    std::size_t depth { 0 };
+    std::vector<CLVMObjectPtr> vals;
+
+    // The atom being read, the size bytes come first and then the bytes of the atom
+    bool reading_atom { false };
+    int size_bytes_left { 0 };
+    uint64_t atom_size { 0 };
+    Bytes atom;
+
+    Impl(std::size_t max_size, std::size_t max_depth)
+        : max_size(max_size)
+        , max_depth(max_depth)
+    {
+    }
+
+    Status Fail(std::string message)
+    {
+        status = Status::ERROR;
+        error = std::move(message);
+        return status;
+    }
+
+    void PushValue(CLVMObjectPtr val)
+    {
+        vals.push_back(std::move(val));
+        while (!ops.empty() && ops.back() == Op::CONS) {
+            ops.pop_back();
+            --depth;
+            auto right = std::move(vals.back());
+            vals.pop_back();
+            auto left = std::move(vals.back());
+            vals.pop_back();
+            vals.push_back(std::make_shared<CLVMObject_Pair>(std::move(left), std::move(right), NodeType::Tuple));
+        }
+        if (ops.empty()) {
+            status = Status::DONE;
+        }
+    }
+
+    /// The size of the atom is known, the bytes of it are read next
+    Status StartAtom()
+    {
+        if (atom_size >= 0x400000000) {
+            return Fail("blob too large");
+        }
+        if (max_size && atom_size > max_size - total_size) {
+            return Fail("sexp too large");
+        }
+        size_bytes_left = 0;
+        atom.clear();
+        atom.reserve(static_cast<std::size_t>(atom_size));
+        if (atom_size == 0) {
+            reading_atom = false;
+            PushValue(MakeNull());
+        }
+        return status;
+    }
+
+    Status ReadHeader(uint8_t b)
+    {
+        if (b == CONS_BOX_MARKER) {
+            if (max_depth && depth == max_depth) {
+                return Fail("sexp too deep");
+            }
+            ++depth;
+            ops.push_back(Op::CONS);
+            ops.push_back(Op::READ);
+            ops.push_back(Op::READ);
+            return status;
+        }
+        if (b == 0x80) {
+            PushValue(MakeNull());
+            return status;
+        }
+        if (b <= MAX_SINGLE_BYTE) {
+            PushValue(ToSExp(utils::ByteToBytes(b)));
+            return status;
+        }
+        int bit_count { 0 };
+        uint8_t bit_mask { 0x80 };
+        while (b & bit_mask) {
+            bit_count += 1;
+            b &= 0xff ^ bit_mask;
+            bit_mask >>= 1;
+        }
+        reading_atom = true;
+        atom_size = b;
+        size_bytes_left = bit_count - 1;
+        if (size_bytes_left == 0) {
+            return StartAtom();
+        }
+        return status;
+    }
+
+    Status Feed(uint8_t const* data, std::size_t size)
+    {
+        consumed = 0;
+        while (status == Status::NEED_MORE && consumed < size) {
+            if (max_size && total_size == max_size) {
+                return Fail("sexp too large");
+            }
+            if (!reading_atom) {
+                ops.pop_back();
+                ++total_size;
+                ReadHeader(data[consumed++]);
+            } else if (size_bytes_left > 0) {
+                atom_size = (atom_size << 8) | data[consumed++];
+                ++total_size;
+                if (--size_bytes_left == 0) {
+                    StartAtom();
+                }
+            } else {
+                std::size_t n = std::min(static_cast<std::size_t>(atom_size) - atom.size(), size - consumed);
+                atom.insert(std::end(atom), data + consumed, data + consumed + n);
+                consumed += n;
+                total_size += n;
+                if (atom.size() == atom_size) {
+                    reading_atom = false;
+                    PushValue(ToSExp(std::move(atom)));
+                    atom = Bytes();
+                }
+            }
+        }
+        return status;
+    }
+};
+
+SExpParser::SExpParser(std::size_t max_size, std::size_t max_depth)
+    : m_pimpl(new Impl(max_size, max_depth))
+{
+}
+
+SExpParser::~SExpParser() { }
+
+SExpParser::Status SExpParser::Feed(uint8_t const* data, std::size_t size) { return m_pimpl->Feed(data, size); }
+
+SExpParser::Status SExpParser::GetStatus() const { return m_pimpl->status; }
+
+CLVMObjectPtr SExpParser::GetResult() const
+{
+    if (m_pimpl->status != Status::DONE) {
+        throw std::runtime_error("the sexp isn't parsed yet");
+    }
+    return m_pimpl->vals.back();
+}
+
+std::string const& SExpParser::GetError() const { return m_pimpl->error; }
+
+std::size_t SExpParser::GetConsumed() const { return m_pimpl->consumed; }
+
+std::size_t SExpParser::GetTotalSize() const { return m_pimpl->total_size; }
+
+void SExpParser::Reset() { m_pimpl.reset(new Impl(m_pimpl->max_size, m_pimpl->max_depth)); }
 
 /**
  * =============================================================================
@@ -560,7 +1304,14 @@ Bytes32 SHA256TreeHash(CLVMObjectPtr sexp, std::vector<Bytes> const& precalculat
 Program Program::ImportFromBytes(Bytes const& bytes)
 {
     Program prog;
-    prog.sexp_ = stream::SExpFromStream(stream::StreamReader(bytes));
+    prog.sexp_ = SExpFromBuffer(bytes.data(), bytes.size());
+    return prog;
+}
+
+Program Program::ImportFromBytesWithBackrefs(Bytes const& bytes)
+{
+    Program prog;
+    prog.sexp_ = SExpFromBufferWithBackrefs(bytes.data(), bytes.size());
     return prog;
 }
 
@@ -570,10 +1321,20 @@ Program Program::ImportFromHex(std::string hex)
     return ImportFromBytes(prog_bytes);
 }
 
-Program Program::ImportFromCompiledFile(std::string file_path)
+Program Program::ImportFromCompiledFile(std::string file_path) { return ImportFromFile(file_path, FileFormat::HEX); }
+
+Program Program::ImportFromFile(std::string const& file_path, FileFormat format, bool use_mmap)
 {
-    std::string hex = utils::LoadHexFromFile(file_path);
-    return ImportFromHex(hex);
+    utils::MappedFile file(file_path, use_mmap);
+    Program prog;
+    if (format == FileFormat::BINARY) {
+        prog.sexp_ = SExpFromBuffer(file.GetData(), file.GetSize());
+    } else {
+        Bytes bytes = utils::BytesFromHexText(
+            std::string_view(reinterpret_cast<char const*>(file.GetData()), file.GetSize()));
+        prog.sexp_ = SExpFromBuffer(bytes.data(), bytes.size());
+    }
+    return prog;
 }
 
 Program Program::ImportFromAssemble(std::string str)
@@ -592,6 +1353,10 @@ Bytes32 Program::GetTreeHash() const { return tree_hash::SHA256TreeHash(sexp_);
 
 Bytes Program::Serialize() const { return stream::SExpToStream(sexp_); }
 
+void Program::Serialize(WriteStreamFunc const& f) const { stream::SExpToStream(sexp_.get(), f); }
+
+Bytes Program::SerializeWithBackrefs() const { return backrefs::SExpToStreamWithBackrefs(sexp_); }
+
 uint8_t msb_mask(uint8_t byte)
 {
     byte |= byte >> 1;
@@ -783,7 +1548,10 @@ std::tuple<Cost, CLVMObjectPtr> run_program(CLVMObjectPtr program, CLVMObjectPtr
 
 } // namespace run
 
-std::tuple<Cost, CLVMObjectPtr> Program::Run(CLVMObjectPtr args) const { return run::run_program(sexp_, args); }
+std::tuple<Cost, CLVMObjectPtr> Program::Run(CLVMObjectPtr args, Cost max_cost) const
+{
+    return run::run_program(sexp_, args, OperatorLookup(), max_cost);
+}
 
 std::string CURRY_OBJ_CODE = "(a (q #a 4 (c 2 (c 5 (c 7 0)))) (c (q (c (q "
                              ". 2) (c (c (q . 1) 5) (c (a 6 "
@@ -0,0 +1,144 @@
+#include "thread_pool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <memory>
+
+namespace chia
+{
+
+ThreadPool& ThreadPool::GetInstance()
+{
+    static ThreadPool instance;
+    return instance;
+}
+
+ThreadPool::ThreadPool(int num_threads)
+{
+    if (num_threads <= 0) {
+        num_threads = std::max<int>(1, static_cast<int>(std::thread::hardware_concurrency()));
+    }
+    for (int i = 0; i < num_threads; ++i) {
+        threads_.emplace_back(&ThreadPool::Worker, this);
+    }
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lg(mtx_);
+        stop_ = true;
+    }
+    cv_.notify_all();
+    for (auto& thread : threads_) {
+        thread.join();
+    }
+}
+
+void ThreadPool::ParallelFor(std::size_t count, std::function<void(std::size_t)> const& f, int max_threads)
+{
+    int num_helpers = GetNumThreads();
+    if (max_threads > 0) {
+        // The calling thread works on the indices too
+        num_helpers = std::min(num_helpers, max_threads - 1);
+    }
+    num_helpers = static_cast<int>(std::min<std::size_t>(num_helpers, count > 0 ? count - 1 : 0));
+    if (num_helpers <= 0) {
+        for (std::size_t i = 0; i < count; ++i) {
+            f(i);
+        }
+        return;
+    }
+
+    struct State {
+        std::atomic<std::size_t> next { 0 };
+        std::atomic<bool> failed { false };
+        std::exception_ptr error;
+        std::mutex error_mtx;
+        int running { 0 };
+    };
+    auto state = std::make_shared<State>();
+    state->running = num_helpers;
+
+    auto run = [state, count, &f]() {
+        std::size_t i;
+        while (!state->failed && (i = state->next++) < count) {
+            try {
+                f(i);
+            } catch (...) {
+                std::lock_guard<std::mutex> lg(state->error_mtx);
+                if (!state->error) {
+                    state->error = std::current_exception();
+                }
+                state->failed = true;
+            }
+        }
+    };
+
+    {
+        std::lock_guard<std::mutex> lg(mtx_);
+        for (int i = 0; i < num_helpers; ++i) {
+            tasks_.push_back([this, state, run]() {
+                run();
+                std::lock_guard<std::mutex> lg(mtx_);
+                --state->running;
+                cv_.notify_all();
+            });
+        }
+    }
+    cv_.notify_all();
+
+    run();
+
+    // Help with the queued tasks while waiting, so a nested call from a worker cannot block the pool
+    std::unique_lock<std::mutex> lock(mtx_);
+    while (state->running > 0) {
+        if (!tasks_.empty()) {
+            lock.unlock();
+            RunPendingTask();
+            lock.lock();
+            continue;
+        }
+        cv_.wait(lock);
+    }
+    lock.unlock();
+
+    if (state->error) {
+        std::rethrow_exception(state->error);
+    }
+}
+
+void ThreadPool::Worker()
+{
+    while (1) {
+        Task task;
+        {
+            std::unique_lock<std::mutex> lock(mtx_);
+            cv_.wait(lock, [this]() { return stop_ || !tasks_.empty(); });
+            if (tasks_.empty()) {
+                return; // stop_ is set and nothing left to do
+            }
+            task = std::move(tasks_.front());
+            tasks_.pop_front();
+        }
+        task();
+    }
+}
+
+bool ThreadPool::RunPendingTask()
+{
+    Task task;
+    {
+        std::lock_guard<std::mutex> lg(mtx_);
+        if (tasks_.empty()) {
+            return false;
+        }
+        task = std::move(tasks_.front());
+        tasks_.pop_front();
+    }
+    task();
+    return true;
+}
+
+} // namespace chia
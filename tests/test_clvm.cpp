@@ -1,12 +1,20 @@
+#include <atomic>
 #include <fstream>
+#include <optional>
+#include <sstream>
 #include <string>
+#include <thread>
 
 #include "gtest/gtest.h"
 
 #include "clvm/assemble.h"
+#include "clvm/costs.h"
+#include "clvm/crypto_utils.h"
 #include "clvm/int.h"
+#include "clvm/more_opts.h"
 #include "clvm/operator_lookup.h"
 #include "clvm/sexp_prog.h"
+#include "clvm/thread_pool.h"
 #include "clvm/types.h"
 #include "clvm/utils.h"
 
@@ -39,6 +47,55 @@ TEST(Utilities, Bytes)
     EXPECT_EQ(chia::utils::ConnectBuffers(bytes, empty), chia::utils::BytesFromHex("abef"));
 }
 
+TEST(Utilities, HexKernels)
+{
+    // Sizes around the widths of the vector kernels and their scalar tails
+    for (int size : { 0, 1, 15, 16, 17, 31, 32, 33, 63, 64, 65, 1000 }) {
+        chia::Bytes bytes(size);
+        std::string expected;
+        for (int i = 0; i < size; ++i) {
+            bytes[i] = static_cast<uint8_t>(i * 37 + 11);
+            expected += chia::utils::Byte4bToHexChar(bytes[i] >> 4);
+            expected += chia::utils::Byte4bToHexChar(bytes[i] & 0x0f);
+        }
+        auto hex = chia::utils::BytesToHex(bytes);
+        EXPECT_EQ(hex, expected);
+        EXPECT_EQ(chia::utils::BytesFromHex(hex), bytes);
+        EXPECT_EQ(chia::utils::BytesFromHex(chia::utils::ToUpper(hex)), bytes);
+        if (!hex.empty()) {
+            hex[hex.size() / 2] = 'g';
+            EXPECT_THROW(chia::utils::BytesFromHex(hex), std::runtime_error);
+        }
+    }
+    EXPECT_EQ(chia::utils::BytesFromHex("abc"), chia::utils::SerializeBytes(0xab, 0x0c));
+    chia::Bytes32 hash;
+    hash.fill(0x5a);
+    EXPECT_EQ(chia::utils::HashFromHex(chia::utils::HashToHex(hash)), hash);
+}
+
+TEST(Utilities, ThreadPool)
+{
+    chia::ThreadPool pool(4);
+    std::vector<int> values(1000, 0);
+    pool.ParallelFor(values.size(), [&values](std::size_t i) { values[i] = static_cast<int>(i) * 2; });
+    for (std::size_t i = 0; i < values.size(); ++i) {
+        EXPECT_EQ(values[i], static_cast<int>(i) * 2);
+    }
+
+    EXPECT_THROW(pool.ParallelFor(100,
+                     [](std::size_t i) {
+                         if (i == 50) {
+                             throw std::runtime_error("failed");
+                         }
+                     }),
+        std::runtime_error);
+
+    // Nested calls from the workers must not block the pool
+    std::atomic<int> total { 0 };
+    pool.ParallelFor(8, [&pool, &total](std::size_t) { pool.ParallelFor(8, [&total](std::size_t) { ++total; }); });
+    EXPECT_EQ(total, 64);
+}
+
 TEST(Utilities, IntBigEndianConvertion)
 {
     EXPECT_EQ(chia::Int(chia::utils::SerializeBytes(0x01, 0x02)).ToInt(), 0x0102);
@@ -72,6 +129,123 @@ TEST(CLVM_SHA256_treehash, LoadAndVerify_s1)
     EXPECT_EQ(chia::utils::HashToBytes(prog.GetTreeHash()), treehash_bytes);
 }
 
+TEST(CLVM_SHA256_treehash, ImportFromFile)
+{
+    auto treehash_bytes = chia::utils::BytesFromHex(s1_treehash);
+    std::string bin_path = ::testing::TempDir() + "clvm_s1.bin";
+    std::string hex_path = ::testing::TempDir() + "clvm_s1.hex";
+    auto bytes = chia::utils::BytesFromHex(s1);
+    std::ofstream(bin_path, std::ios::binary).write(reinterpret_cast<char const*>(bytes.data()), bytes.size());
+    std::ofstream(hex_path) << s1.substr(0, 100) << "\n" << s1.substr(100) << "\n";
+
+    for (bool use_mmap : { true, false }) {
+        auto prog = chia::Program::ImportFromFile(bin_path, chia::Program::FileFormat::BINARY, use_mmap);
+        EXPECT_EQ(chia::utils::HashToBytes(prog.GetTreeHash()), treehash_bytes);
+        prog = chia::Program::ImportFromFile(hex_path, chia::Program::FileFormat::HEX, use_mmap);
+        EXPECT_EQ(chia::utils::HashToBytes(prog.GetTreeHash()), treehash_bytes);
+    }
+    EXPECT_EQ(chia::utils::HashToBytes(chia::Program::ImportFromCompiledFile(hex_path).GetTreeHash()), treehash_bytes);
+
+    std::size_t consumed;
+    chia::SExpFromBuffer(bytes.data(), bytes.size(), &consumed);
+    EXPECT_EQ(consumed, bytes.size());
+    EXPECT_THROW(chia::SExpFromBuffer(bytes.data(), bytes.size() - 1), std::runtime_error);
+    EXPECT_THROW(chia::Program::ImportFromFile(::testing::TempDir() + "clvm_not_exist.bin"), std::runtime_error);
+    EXPECT_EQ(chia::utils::BytesFromHexText(" ab\tef\n"), chia::utils::BytesFromHex("abef"));
+    EXPECT_THROW(chia::utils::BytesFromHex("zz"), std::runtime_error);
+}
+
+TEST(CLVM_SHA256_treehash, FromBytes)
+{
+    for (auto const& [hex, treehash] : { std::make_pair(s0, s0_treehash), std::make_pair(s1, s1_treehash) }) {
+        auto bytes = chia::utils::BytesFromHex(hex);
+        std::size_t const size = bytes.size();
+        bytes.push_back(0x80);
+        std::size_t consumed;
+        EXPECT_EQ(chia::utils::HashToHex(chia::TreeHashFromBytes(bytes.data(), bytes.size(), &consumed)), treehash);
+        EXPECT_EQ(consumed, size);
+        EXPECT_EQ(chia::SerializedLength(bytes.data(), bytes.size()), size);
+        EXPECT_THROW(chia::SerializedLength(bytes.data(), size - 1), std::runtime_error);
+        EXPECT_THROW(chia::TreeHashFromBytes(bytes.data(), size - 1), std::runtime_error);
+    }
+    chia::Program long_atom(chia::ToSExp(chia::Bytes(100, 0x5a)));
+    auto bytes = long_atom.Serialize();
+    EXPECT_EQ(chia::TreeHashFromBytes(bytes.data(), bytes.size()), long_atom.GetTreeHash());
+    EXPECT_EQ(chia::SerializedLength(bytes.data(), bytes.size()), bytes.size());
+}
+
+TEST(CLVM_SHA256_treehash, SExpParser)
+{
+    auto treehash_bytes = chia::utils::BytesFromHex(s1_treehash);
+    auto bytes = chia::utils::ConnectBuffers(chia::utils::BytesFromHex(s1), chia::Bytes(100, 0x5a));
+    std::size_t const size = chia::utils::BytesFromHex(s1).size();
+
+    for (std::size_t chunk : { 1, 7, 64, 10000 }) {
+        chia::SExpParser parser;
+        std::size_t pos { 0 };
+        auto status = chia::SExpParser::Status::NEED_MORE;
+        while (status == chia::SExpParser::Status::NEED_MORE) {
+            status = parser.Feed(bytes.data() + pos, std::min(chunk, bytes.size() - pos));
+            pos += parser.GetConsumed();
+        }
+        ASSERT_EQ(status, chia::SExpParser::Status::DONE);
+        EXPECT_EQ(pos, size);
+        EXPECT_EQ(parser.GetTotalSize(), size);
+        EXPECT_EQ(chia::utils::HashToBytes(chia::Program(parser.GetResult()).GetTreeHash()), treehash_bytes);
+    }
+
+    // An atom split across two chunks
+    auto atom = chia::Program(chia::ToSExp(chia::Bytes(100, 0x5a))).Serialize();
+    chia::SExpParser parser;
+    EXPECT_EQ(parser.Feed(atom.data(), 50), chia::SExpParser::Status::NEED_MORE);
+    EXPECT_THROW(parser.GetResult(), std::runtime_error);
+    EXPECT_EQ(parser.Feed(atom.data() + 50, atom.size() - 50), chia::SExpParser::Status::DONE);
+    EXPECT_EQ(chia::ToBytes(parser.GetResult()), chia::Bytes(100, 0x5a));
+
+    chia::SExpParser small_parser(size - 1);
+    EXPECT_EQ(small_parser.Feed(bytes.data(), bytes.size()), chia::SExpParser::Status::ERROR);
+    EXPECT_FALSE(small_parser.GetError().empty());
+    small_parser.Reset();
+    EXPECT_EQ(small_parser.Feed(atom.data(), atom.size()), chia::SExpParser::Status::DONE);
+    EXPECT_EQ(chia::SExpParser(50).Feed(atom.data(), 2), chia::SExpParser::Status::ERROR);
+
+    auto nested = chia::utils::BytesFromHex("ffff01ff02808080");
+    EXPECT_EQ(chia::SExpParser(0, 2).Feed(nested.data(), nested.size()), chia::SExpParser::Status::ERROR);
+    EXPECT_EQ(chia::SExpParser(0, 3).Feed(nested.data(), nested.size()), chia::SExpParser::Status::DONE);
+}
+
+TEST(CLVM_SHA256_treehash, Backrefs)
+{
+    // An atom with a size which takes two bytes to encode
+    chia::Program long_atom(chia::ToSExp(chia::Bytes(100, 0x5a)));
+    auto bytes = long_atom.Serialize();
+    EXPECT_EQ(bytes.size(), 102);
+    EXPECT_EQ(chia::ToBytes(chia::Program::ImportFromBytes(bytes).GetSExp()), chia::Bytes(100, 0x5a));
+
+    // (foobar . <the list read so far>) is (foobar foobar)
+    auto foobar = chia::Program::ImportFromBytesWithBackrefs(chia::utils::BytesFromHex("ff86666f6f626172fe01"));
+    EXPECT_EQ(foobar.Serialize(), chia::utils::BytesFromHex("ff86666f6f626172ff86666f6f62617280"));
+
+    chia::ListBuilder items;
+    auto item = chia::ToSExpList(chia::ToSExp(chia::Bytes(32, 0x11)), chia::ToSExp(chia::Bytes(48, 0x22)));
+    for (int i = 0; i < 10; ++i) {
+        items.Add(item);
+    }
+    chia::Program prog(items.GetRoot());
+    auto plain = prog.Serialize();
+    auto compressed = prog.SerializeWithBackrefs();
+    EXPECT_LT(compressed.size(), plain.size() / 5);
+
+    auto decoded = chia::Program::ImportFromBytesWithBackrefs(compressed);
+    EXPECT_EQ(decoded.GetTreeHash(), prog.GetTreeHash());
+    EXPECT_EQ(decoded.Serialize(), plain);
+    auto list = decoded.GetSExp();
+    EXPECT_EQ(chia::First(list).get(), chia::First(chia::Rest(list)).get());
+
+    EXPECT_EQ(chia::Program::ImportFromBytesWithBackrefs(plain).GetTreeHash(), prog.GetTreeHash());
+    EXPECT_THROW(chia::Program::ImportFromBytesWithBackrefs(chia::utils::BytesFromHex("ff01fe05")), std::runtime_error);
+}
+
 TEST(CLVM_BigInt, Initial100)
 {
     chia::Int i(100);
@@ -112,6 +286,28 @@ TEST(CLVM_BigInt, Sub)
     EXPECT_EQ((aa - bb).ToInt(), a - b);
 }
 
+TEST(CLVM_BigInt, SignedBytes)
+{
+    auto hex = [](long val) { return chia::utils::BytesToHex(chia::Int(val).ToSignedBytes()); };
+    EXPECT_EQ(hex(0), "");
+    EXPECT_EQ(hex(127), "7f");
+    EXPECT_EQ(hex(200), "00c8");
+    EXPECT_EQ(hex(1000000000000), "00e8d4a51000");
+    EXPECT_EQ(hex(-1), "ff");
+    EXPECT_EQ(hex(-128), "80");
+    EXPECT_EQ(hex(-129), "ff7f");
+    EXPECT_EQ(hex(-256), "ff00");
+    for (long val : { 0L, 1L, 127L, 128L, 200L, 65535L, -1L, -128L, -129L, -256L, -65537L }) {
+        EXPECT_EQ(chia::Int::FromSignedBytes(chia::Int(val).ToSignedBytes()).ToInt(), val);
+    }
+    // The atom of an integer is the canonical form and it reads back with its sign
+    auto atom = chia::ToSExp(chia::Int(200));
+    EXPECT_EQ(chia::ToBytes(atom), chia::utils::BytesFromHex("00c8"));
+    EXPECT_EQ(chia::ToInt(atom).ToInt(), 200);
+    EXPECT_EQ(chia::ToInt(chia::ToSExp(chia::Int(-200))).ToInt(), -200);
+    EXPECT_EQ(chia::Program(chia::ToSExp(chia::Int(-129))).Serialize(), chia::utils::BytesFromHex("82ff7f"));
+}
+
 TEST(CLVM_SExp, List)
 {
     auto sexp_list = chia::ToSExpList(10, 20, 30, 40);
@@ -155,6 +351,51 @@ TEST(CLVM, OperatorLookup)
     EXPECT_EQ(ol.KeywordToAtom("add"), 0x10);
 }
 
+TEST(CLVM, Assemble)
+{
+    auto f = chia::Assemble("(a ; comment\n (q . \"str\") 0x0102 #q -7 foo)");
+    chia::ArgsIter i(f);
+    EXPECT_EQ(chia::ToBytes(i.NextCLVMObj()), chia::utils::ByteToBytes(0x02));
+    EXPECT_TRUE(chia::IsPair(i.NextCLVMObj()));
+    EXPECT_EQ(chia::ToBytes(i.NextCLVMObj()), chia::Bytes({ 0x01, 0x02 }));
+    EXPECT_EQ(chia::ToBytes(i.NextCLVMObj()), chia::utils::ByteToBytes(0x01));
+    EXPECT_EQ(chia::ToInt(i.NextCLVMObj()).ToInt(), -7);
+    EXPECT_EQ(chia::ToBytes(i.NextCLVMObj()), chia::utils::StrToBytes("foo"));
+    EXPECT_TRUE(i.IsEof());
+
+    EXPECT_THROW(chia::Assemble("(1 2"), std::runtime_error);
+    EXPECT_THROW(chia::Assemble("(1 . 2 3)"), std::runtime_error);
+    EXPECT_THROW(chia::Assemble("\"abc"), std::runtime_error);
+    EXPECT_THROW(chia::Assemble("  ; nothing"), std::runtime_error);
+
+    // Deep nesting and long lists are read without recursion
+    int const N = 100000;
+    std::string deep = std::string(N, '(') + "1" + std::string(N, ')');
+    EXPECT_TRUE(chia::IsPair(chia::Assemble(deep)));
+    std::string list = "(";
+    for (int n = 0; n < N; ++n) {
+        list += "1 ";
+    }
+    list += ")";
+    EXPECT_EQ(chia::ListLen(chia::Assemble(list)), N);
+}
+
+TEST(CLVM, Disassemble)
+{
+    chia::Program prog(chia::Assemble("(a (q . 1) (+ 2 -5) \"hello\" (c . \"a'b\") 0xdeadbeef ())"));
+    EXPECT_EQ(chia::Disassemble(prog), "(a (q . 1) (+ 2 -5) \"hello\" (c . \"a'b\") 3735928559 ())");
+
+    // The atoms of a deserialized program are typed by their bytes like opd does
+    auto prog2 = chia::Program::ImportFromBytes(chia::utils::BytesFromHex("ff02ffff01ff8200ff80ff84deadbeefff83616263ff8180ff0080"));
+    EXPECT_EQ(chia::Disassemble(prog2), "(a (q 255) 0xdeadbeef \"abc\" -128 0x00)");
+
+    int const N = 100000;
+    std::string deep = std::string(N, '(') + "100" + std::string(N, ')');
+    std::ostringstream ss;
+    chia::Disassemble(chia::Assemble(deep), ss);
+    EXPECT_EQ(ss.str(), deep);
+}
+
 int calculate_number(std::string s)
 {
     auto f = chia::Assemble(s);
@@ -253,6 +494,63 @@ TEST(CLVM_RunProgram, Math)
     EXPECT_EQ(calculate_number("(+ (q . 0x000a) (q . 0x000b))"), 21);
 }
 
+TEST(CLVM_RunProgram, Sha256)
+{
+    chia::Cost cost;
+    chia::CLVMObjectPtr r;
+    std::tie(cost, r) = chia::op_sha256(chia::ToSExpList(std::string("a"), std::string("bc")));
+    EXPECT_EQ(chia::utils::BytesToHex(chia::ToBytes(r)),
+        "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad");
+    // Base cost, 2 arguments, 3 bytes and the 32 bytes result
+    EXPECT_EQ(cost,
+        chia::SHA256_BASE_COST + 2 * chia::SHA256_COST_PER_ARG + 3 * chia::SHA256_COST_PER_BYTE
+            + 32 * chia::MALLOC_COST_PER_BYTE);
+    // The reused digest contexts start over for each hash
+    std::tie(cost, r) = chia::op_sha256(chia::ToSExpList(std::string("abc")));
+    EXPECT_EQ(chia::utils::BytesToHex(chia::ToBytes(r)),
+        "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad");
+    EXPECT_THROW(chia::op_sha256(chia::ToSExpList(chia::ToSExpList(std::string("abc")))), std::runtime_error);
+}
+
+TEST(CLVM_RunProgram, Sha256AtThreadExit)
+{
+    // The holder is made before the pool of idle contexts, so its hash is destroyed after the pool at the exit
+    struct Holder {
+        std::optional<chia::crypto_utils::SHA256> sha256;
+    };
+    std::thread thread([]() {
+        thread_local Holder holder;
+        holder.sha256.emplace();
+        chia::crypto_utils::MakeSHA256(chia::Bytes { 1, 2, 3 });
+        holder.sha256->Add(chia::Bytes { 1, 2, 3 });
+    });
+    thread.join();
+}
+
+TEST(CLVM_RunProgram, ConcatSubstr)
+{
+    chia::Cost cost;
+    chia::CLVMObjectPtr r;
+    std::tie(cost, r) = chia::op_concat(chia::ToSExpList(std::string("ab"), chia::MakeNull(), std::string("cde")));
+    EXPECT_EQ(chia::ToBytes(r), chia::utils::StrToBytes("abcde"));
+    EXPECT_EQ(cost,
+        chia::CONCAT_BASE_COST + 3 * chia::CONCAT_COST_PER_ARG + 5 * chia::CONCAT_COST_PER_BYTE
+            + 5 * chia::MALLOC_COST_PER_BYTE);
+    std::tie(cost, r) = chia::op_concat(chia::MakeNull());
+    EXPECT_TRUE(chia::ToBytes(r).empty());
+
+    std::tie(cost, r) = chia::op_substr(chia::ToSExpList(std::string("abcde"), 1L, 3L));
+    EXPECT_EQ(chia::ToBytes(r), chia::utils::StrToBytes("bc"));
+    EXPECT_EQ(cost, 1);
+    std::tie(cost, r) = chia::op_substr(chia::ToSExpList(std::string("abcde"), 2L));
+    EXPECT_EQ(chia::ToBytes(r), chia::utils::StrToBytes("cde"));
+    std::tie(cost, r) = chia::op_substr(chia::ToSExpList(std::string("abcde"), 5L, 5L));
+    EXPECT_TRUE(chia::ToBytes(r).empty());
+    EXPECT_THROW(chia::op_substr(chia::ToSExpList(std::string("abcde"), 3L, 2L)), std::runtime_error);
+    EXPECT_THROW(chia::op_substr(chia::ToSExpList(std::string("abcde"), 1L, 6L)), std::runtime_error);
+    EXPECT_THROW(chia::op_substr(chia::ToSExpList(std::string("abcde"))), std::runtime_error);
+}
+
 TEST(CLVM_RunProgram, Bool)
 {
     EXPECT_TRUE(calculate_bool("(= (q . 5) (q . 5))"));
@@ -1,6 +1,16 @@
 #include <gtest/gtest.h>
 
+#include <filesystem>
+#include <fstream>
+
 #include "clvm/coin.h"
+#include "clvm/coin_store.h"
+#include "clvm/conditions.h"
+#include "clvm/costs.h"
+#include "clvm/crypto_utils.h"
+#include "clvm/generator.h"
+#include "clvm/mempool.h"
+#include "clvm/puzzle.h"
 #include "clvm/utils.h"
 
 chia::Bytes BytesFromPtr(char const* p)
@@ -11,6 +21,44 @@ chia::Bytes BytesFromPtr(char const* p)
     return result;
 }
 
+/// A hash with every byte set to `byte`
+chia::Bytes32 MakeHash(uint8_t byte)
+{
+    chia::Bytes32 hash;
+    hash.fill(byte);
+    return hash;
+}
+
+/// `((51 puzzle_hash amount))`, the conditions which create one coin
+chia::CLVMObjectPtr MakeCreateCoin(uint8_t puzzle_hash_byte, uint64_t amount)
+{
+    return chia::ToSExpList(chia::ToSExpList(chia::ConditionOpcode::ToBytes(chia::ConditionOpcode::CREATE_COIN),
+        chia::utils::HashToBytes(MakeHash(puzzle_hash_byte)), chia::Int(amount)));
+}
+
+/// `(q . conditions)`, a puzzle which returns the conditions whatever the solution is
+chia::Program MakeConditionPuzzle(chia::CLVMObjectPtr conditions)
+{
+    return chia::Program(chia::ToSExpPair(chia::utils::ByteToBytes(1), std::move(conditions)));
+}
+
+/// A spend of a coin whose puzzle is `(q . conditions)` and whose parent is `MakeHash(parent_byte)`, no signature is
+/// needed
+chia::CoinSpend MakeConditionSpend(uint8_t parent_byte, uint64_t amount, chia::CLVMObjectPtr conditions)
+{
+    chia::Program puzzle = MakeConditionPuzzle(std::move(conditions));
+    return chia::CoinSpend(
+        chia::Coin(MakeHash(parent_byte), puzzle.GetTreeHash(), amount), puzzle, chia::Program(chia::MakeNull()));
+}
+
+/// A coin whose parent starts with the index, the amount is `index + 1`
+chia::Coin MakeIndexedCoin(uint32_t index, uint8_t puzzle_hash_byte)
+{
+    chia::Bytes32 parent {};
+    memcpy(parent.data(), &index, sizeof(index));
+    return chia::Coin(parent, MakeHash(puzzle_hash_byte), index + 1);
+}
+
 TEST(Coin, Name_1)
 {
     char const* SZ_PARENT_COIN_INFO = "abababababababababababababababab";
@@ -71,3 +119,448 @@ TEST(Coin, CoinID3)
     chia::Coin coin(parent_id2, puzzle_hash1, 3);
     EXPECT_EQ(coin.GetName(), chia::utils::bytes_cast<chia::utils::HASH256_LEN>(coin_id));
 }
+
+/// `(q . ((parent puzzle amount solution)...))` with `count` spends of the same puzzle
+chia::Program MakeGenerator(int count)
+{
+    auto puzzle = MakeConditionPuzzle(MakeCreateCoin(0x11, 1000)).GetSExp();
+    chia::ListBuilder spends;
+    for (int i = 0; i < count; ++i) {
+        spends.Add(chia::ToSExpList(
+            chia::utils::HashToBytes(MakeHash(static_cast<uint8_t>(i))), puzzle, chia::Int(i + 1), chia::MakeNull()));
+    }
+    return MakeConditionPuzzle(chia::ToSExpList(spends.GetRoot()));
+}
+
+TEST(GeneratorRunner, Run)
+{
+    // The puzzles of the generator are the same node once it is read back with back references
+    auto generator = chia::Program::ImportFromBytesWithBackrefs(MakeGenerator(3).SerializeWithBackrefs());
+    chia::GeneratorRunner runner;
+    auto block = runner.Run(generator, {}, 0);
+    ASSERT_EQ(block.spends.size(), 3);
+
+    auto puzzle_hash = MakeConditionPuzzle(MakeCreateCoin(0x11, 1000)).GetTreeHash();
+    chia::Cost cost = block.generator_cost;
+    for (std::size_t i = 0; i < block.spends.size(); ++i) {
+        auto const& spend = block.spends[i];
+        EXPECT_EQ(spend.puzzle_hash, puzzle_hash);
+        EXPECT_EQ(spend.coin_spend.coin.GetAmount(), i + 1);
+        EXPECT_EQ(spend.coin_id, spend.coin_spend.coin.GetName());
+        auto create_coin = spend.conditions.find(chia::ConditionOpcode(chia::ConditionOpcode::CREATE_COIN));
+        ASSERT_NE(create_coin, std::end(spend.conditions));
+        EXPECT_EQ(create_coin->second.size(), 1);
+        cost += spend.cost;
+    }
+    EXPECT_EQ(block.condition_cost, 3 * chia::CREATE_COIN_COST);
+    EXPECT_EQ(block.cost, cost + block.condition_cost);
+    EXPECT_EQ(block.spends[0].coin_spend.puzzle_reveal->GetSExp(), block.spends[2].coin_spend.puzzle_reveal->GetSExp());
+
+    EXPECT_EQ(runner.Run(generator, {}, block.cost).spends.size(), 3);
+    EXPECT_THROW(runner.Run(generator, {}, block.cost - 1), std::runtime_error);
+    // The budget is spent by the conditions too, the cost of running the puzzles alone is not enough
+    EXPECT_THROW(runner.Run(generator, {}, block.cost - block.condition_cost), std::runtime_error);
+
+    // The ROM gets `(generator ((refs...)))` and runs the generator with its arguments
+    chia::GeneratorRunner rom_runner(chia::Program::ImportFromAssemble("(a 2 5)"));
+    auto rom_block = rom_runner.Run(generator, { chia::utils::ByteToBytes(7) }, 0);
+    EXPECT_EQ(rom_block.spends.size(), 3);
+    EXPECT_GT(rom_block.generator_cost, block.generator_cost);
+}
+
+TEST(Mempool, AddAndCreateBlock)
+{
+    chia::MempoolOptions options;
+    options.verify_signature = false;
+    chia::Mempool mempool(options);
+    auto make_bundle = [](uint8_t parent_byte, uint64_t amount, uint64_t output) {
+        return chia::SpendBundle(
+            { MakeConditionSpend(parent_byte, amount, MakeCreateCoin(0x11, output)) }, chia::Signature());
+    };
+
+    auto low = mempool.Add(make_bundle(1, 1100, 1000));
+    ASSERT_EQ(low.status, chia::Mempool::Status::ADDED);
+    EXPECT_EQ(low.item->fee, 100);
+    ASSERT_EQ(low.item->additions.size(), 1);
+    EXPECT_EQ(low.item->additions[0].GetAmount(), 1000);
+    auto high = mempool.Add(make_bundle(2, 1500, 1000));
+    ASSERT_EQ(high.status, chia::Mempool::Status::ADDED);
+    EXPECT_EQ(mempool.GetSize(), 2);
+    EXPECT_EQ(mempool.GetTotalCost(), low.item->cost + high.item->cost);
+
+    auto conflict = mempool.Add(make_bundle(1, 1100, 1000));
+    EXPECT_EQ(conflict.status, chia::Mempool::Status::CONFLICT);
+    EXPECT_EQ(conflict.conflicts, std::vector<uint64_t> { low.item->id });
+    EXPECT_EQ(mempool.Add(make_bundle(3, 900, 1000)).status, chia::Mempool::Status::INVALID);
+
+    auto block = mempool.CreateBlockCandidate(high.item->cost + low.item->cost);
+    ASSERT_EQ(block.size(), 2);
+    EXPECT_EQ(block[0]->id, high.item->id);
+    block = mempool.CreateBlockCandidate(high.item->cost);
+    ASSERT_EQ(block.size(), 1);
+    EXPECT_EQ(block[0]->id, high.item->id);
+
+    EXPECT_EQ(mempool.GetBySpentCoin(low.item->removals[0])->id, low.item->id);
+    EXPECT_EQ(mempool.RemoveConflicts(low.item->removals), 1);
+    EXPECT_EQ(mempool.GetBySpentCoin(low.item->removals[0]), nullptr);
+    EXPECT_EQ(mempool.Add(make_bundle(1, 1100, 1000)).status, chia::Mempool::Status::ADDED);
+    EXPECT_TRUE(mempool.Remove(high.item->id));
+    EXPECT_FALSE(mempool.Remove(high.item->id));
+    EXPECT_EQ(mempool.GetSize(), 1);
+
+    chia::MempoolOptions small_options = options;
+    small_options.max_bundle_cost = low.item->cost - 1;
+    EXPECT_EQ(chia::Mempool(small_options).Add(make_bundle(1, 1100, 1000)).status, chia::Mempool::Status::INVALID);
+}
+
+TEST(Mempool, AmountOverflow)
+{
+    chia::MempoolOptions options;
+    options.verify_signature = false;
+    chia::Mempool mempool(options);
+    auto add = [&mempool](uint8_t parent_byte, std::vector<chia::Bytes> const& amounts) {
+        chia::ListBuilder conditions;
+        for (auto const& amount : amounts) {
+            conditions.Add(chia::ToSExpList(chia::ConditionOpcode::ToBytes(chia::ConditionOpcode::CREATE_COIN),
+                chia::utils::HashToBytes(MakeHash(0x11)), amount));
+        }
+        return mempool.Add(
+            chia::SpendBundle({ MakeConditionSpend(parent_byte, 1000, conditions.GetRoot()) }, chia::Signature()));
+    };
+    // 2^63 has a leading zero to stay positive, two of them wrap a 64-bit sum to 0
+    chia::Bytes half = chia::utils::BytesFromHex("008000000000000000");
+    auto overflow = add(1, { half, half });
+    EXPECT_EQ(overflow.status, chia::Mempool::Status::INVALID);
+    EXPECT_EQ(overflow.error, "the outputs overflow");
+    EXPECT_EQ(add(2, { chia::utils::BytesFromHex("00000000000000000001") }).status, chia::Mempool::Status::INVALID);
+    EXPECT_EQ(add(3, { chia::utils::BytesFromHex("0100000000000000000000") }).status, chia::Mempool::Status::INVALID);
+    EXPECT_EQ(add(4, { chia::utils::BytesFromHex("ff") }).status, chia::Mempool::Status::INVALID);
+    EXPECT_EQ(add(5, { chia::utils::BytesFromHex("0000000000000003e8") }).status, chia::Mempool::Status::ADDED);
+}
+
+TEST(Mempool, WalletAmounts)
+{
+    // Both amounts have the top bit of their first byte set, the wallet conditions must keep them positive
+    auto make_spend = [](uint8_t parent_byte, uint64_t amount) {
+        return MakeConditionSpend(parent_byte, amount,
+            chia::ToSExpList(chia::puzzle::make_create_coin_condition(MakeHash(0x11), 1000000000000, {}),
+                chia::puzzle::make_reserve_fee_condition(200)));
+    };
+    chia::SpendBundle bundle({ make_spend(1, 1000000000200) }, chia::Signature());
+    auto additions = bundle.Additions();
+    ASSERT_EQ(additions.size(), 1);
+    EXPECT_EQ(additions[0].GetAmount(), 1000000000000);
+    EXPECT_EQ(bundle.Fees(), 200);
+
+    chia::MempoolOptions options;
+    options.verify_signature = false;
+    chia::Mempool mempool(options);
+    auto added = mempool.Add(bundle);
+    ASSERT_EQ(added.status, chia::Mempool::Status::ADDED);
+    EXPECT_EQ(added.item->fee, 200);
+    ASSERT_EQ(added.item->additions.size(), 1);
+    EXPECT_EQ(added.item->additions[0].GetAmount(), 1000000000000);
+    EXPECT_EQ(mempool.Add(chia::SpendBundle({ make_spend(2, 1000000000100) }, chia::Signature())).status,
+        chia::Mempool::Status::INVALID);
+}
+
+TEST(CoinStore, ApplyBlockAndRollback)
+{
+    chia::Bytes32 puzzle_hash_a = MakeHash(0xaa), puzzle_hash_b = MakeHash(0xbb);
+
+    chia::CoinStore store;
+    std::vector<chia::Coin> additions;
+    for (uint32_t i = 0; i < 1000; ++i) {
+        additions.push_back(MakeIndexedCoin(i, i % 4 ? 0xaa : 0xbb));
+    }
+    store.ApplyBlock(1, additions, {});
+    EXPECT_EQ(store.GetSize(), 1000);
+    EXPECT_EQ(store.GetByPuzzleHash(puzzle_hash_b).size(), 250);
+    auto record = store.Get(additions[7].GetName());
+    ASSERT_TRUE(record.has_value());
+    EXPECT_EQ(record->GetCoin().GetName(), additions[7].GetName());
+    EXPECT_EQ(record->confirmed_height, 1);
+    EXPECT_FALSE(record->IsSpent());
+
+    auto snapshot = store.Snapshot();
+    chia::Coin ephemeral = MakeIndexedCoin(5000, 0xaa);
+    store.ApplyBlock(2, { MakeIndexedCoin(1000, 0xbb), ephemeral },
+        { additions[0].GetName(), additions[1].GetName(), ephemeral.GetName() });
+    EXPECT_EQ(store.Get(additions[0].GetName())->spent_height, 2);
+    EXPECT_EQ(store.GetByPuzzleHash(puzzle_hash_b).size(), 250);
+    EXPECT_EQ(store.GetByPuzzleHash(puzzle_hash_b, true).size(), 251);
+    EXPECT_EQ(store.GetByPuzzleHash(puzzle_hash_a).size(), 749);
+    EXPECT_FALSE(snapshot.Get(additions[0].GetName())->IsSpent());
+    EXPECT_EQ(snapshot.GetSize(), 1000);
+
+    // A bad block leaves the store as it is
+    EXPECT_THROW(store.ApplyBlock(3, { MakeIndexedCoin(2000, 0xaa) }, { additions[0].GetName() }), std::runtime_error);
+    EXPECT_THROW(store.ApplyBlock(3, { additions[5] }, {}), std::runtime_error);
+    EXPECT_THROW(store.ApplyBlock(2, {}, {}), std::runtime_error);
+    EXPECT_FALSE(store.Get(MakeIndexedCoin(2000, 0xaa).GetName()).has_value());
+
+    store.Rollback(1);
+    EXPECT_EQ(store.GetHeight(), 1);
+    EXPECT_EQ(store.GetSize(), 1000);
+    EXPECT_FALSE(store.Get(additions[0].GetName())->IsSpent());
+    EXPECT_FALSE(store.Get(ephemeral.GetName()).has_value());
+    EXPECT_EQ(store.GetByPuzzleHash(puzzle_hash_b, true).size(), 250);
+    for (auto const& coin : additions) {
+        ASSERT_TRUE(store.Get(coin.GetName()).has_value());
+    }
+
+    store.ApplyBlock(2, {}, { additions[2].GetName() });
+    store.PruneUndo(2);
+    EXPECT_THROW(store.Rollback(1), std::runtime_error);
+    store.Rollback(2);
+    EXPECT_EQ(store.GetHeight(), 2);
+    EXPECT_TRUE(store.Get(additions[2].GetName())->IsSpent());
+}
+
+TEST(CoinStore, OpenAndCheckpoint)
+{
+    chia::Bytes32 puzzle_hash_a = MakeHash(0xaa);
+    std::string dir_path = (std::filesystem::temp_directory_path() / "clvm_test_coin_store").string();
+    std::filesystem::remove_all(dir_path);
+
+    std::vector<chia::Coin> additions;
+    for (uint32_t i = 0; i < 100; ++i) {
+        additions.push_back(MakeIndexedCoin(i, i % 2 ? 0xaa : 0xbb));
+    }
+    {
+        auto store = chia::CoinStore::Open(dir_path);
+        store.ApplyBlock(1, additions, {});
+        store.ApplyBlock(2, { MakeIndexedCoin(100, 0xbb) }, { additions[0].GetName() });
+        store.ApplyBlock(3, { MakeIndexedCoin(101, 0xaa) }, { additions[1].GetName() });
+        store.Rollback(2);
+    }
+    {
+        // The blocks are replayed from the log
+        auto store = chia::CoinStore::Open(dir_path);
+        EXPECT_EQ(store.GetHeight(), 2);
+        EXPECT_EQ(store.GetSize(), 101);
+        EXPECT_EQ(store.Get(additions[0].GetName())->spent_height, 2);
+        EXPECT_FALSE(store.Get(additions[1].GetName())->IsSpent());
+        EXPECT_FALSE(store.Get(MakeIndexedCoin(101, 0xaa).GetName()).has_value());
+        store.Checkpoint();
+        EXPECT_THROW(store.Rollback(1), std::runtime_error);
+        store.ApplyBlock(
+            3, { MakeIndexedCoin(102, 0xbb) }, { additions[3].GetName(), MakeIndexedCoin(100, 0xbb).GetName() });
+    }
+    // A record torn by a crash is dropped
+    std::ofstream(std::filesystem::path(dir_path) / "coins.log", std::ios::binary | std::ios::app) << "torn";
+    {
+        auto store = chia::CoinStore::Open(dir_path);
+        EXPECT_EQ(store.GetHeight(), 3);
+        EXPECT_EQ(store.GetSize(), 102);
+        EXPECT_EQ(store.GetMemoryUsage(), chia::CoinStore().GetMemoryUsage());
+        EXPECT_EQ(store.Get(additions[50].GetName())->GetCoin().GetName(), additions[50].GetName());
+        EXPECT_EQ(store.Get(additions[3].GetName())->spent_height, 3);
+        EXPECT_EQ(store.GetByPuzzleHash(puzzle_hash_a).size(), 49);
+        EXPECT_EQ(store.GetByPuzzleHash(puzzle_hash_a, true).size(), 50);
+
+        auto snapshot = store.Snapshot();
+        store.Rollback(2);
+        EXPECT_FALSE(store.Get(additions[3].GetName())->IsSpent());
+        EXPECT_FALSE(store.Get(MakeIndexedCoin(102, 0xbb).GetName()).has_value());
+        EXPECT_EQ(store.GetSize(), 101);
+        EXPECT_TRUE(snapshot.Get(additions[3].GetName())->IsSpent());
+        EXPECT_THROW(snapshot.Checkpoint(), std::runtime_error);
+        store.ApplyBlock(3, {}, { additions[5].GetName() });
+    }
+    {
+        auto store = chia::CoinStore::Open(dir_path);
+        EXPECT_EQ(store.GetHeight(), 3);
+        EXPECT_TRUE(store.Get(additions[5].GetName())->IsSpent());
+        EXPECT_FALSE(store.Get(additions[3].GetName())->IsSpent());
+    }
+    std::filesystem::remove_all(dir_path);
+}
+
+TEST(Conditions, ValidateBundleConditions)
+{
+    using chia::ConditionOpcode;
+    using Code = chia::ConditionFailure::Code;
+    auto op = [](uint8_t(&opcode)[1]) { return ConditionOpcode::ToBytes(opcode); };
+
+    auto announcer = MakeConditionSpend(1, 1000,
+        chia::ToSExpList(chia::ToSExpList(op(ConditionOpcode::CREATE_COIN_ANNOUNCEMENT), chia::utils::StrToBytes("hi")),
+            chia::ToSExpList(op(ConditionOpcode::ASSERT_MY_AMOUNT), chia::Int(1000)),
+            chia::ToSExpList(op(ConditionOpcode::ASSERT_HEIGHT_ABSOLUTE), chia::Int(10))));
+    chia::Bytes32 announcer_id = announcer.coin.GetName();
+    auto announcement_id = chia::crypto_utils::MakeSHA256(announcer_id, chia::utils::StrToBytes("hi"));
+    chia::Bytes32 asserter_parent = MakeHash(2);
+    auto make_asserter = [&](chia::Bytes32 const& asserted, long seconds) {
+        return MakeConditionSpend(2, 500,
+            chia::ToSExpList(
+                chia::ToSExpList(op(ConditionOpcode::ASSERT_COIN_ANNOUNCEMENT), chia::utils::HashToBytes(asserted)),
+                chia::ToSExpList(op(ConditionOpcode::ASSERT_MY_PARENT_ID), chia::utils::HashToBytes(asserter_parent)),
+                chia::ToSExpList(op(ConditionOpcode::ASSERT_SECONDS_RELATIVE), chia::Int(seconds))));
+    };
+
+    chia::ChainState state;
+    state.prev_transaction_block_height = 10;
+    state.timestamp = 1000;
+    state.get_coin_confirmation = [](chia::Bytes32 const&) { return chia::CoinConfirmation { 5, 900 }; };
+    auto validate = [&](chia::CoinSpend asserter, chia::ChainState const& state) {
+        return chia::ValidateBundleConditions(chia::SpendBundle({ announcer, asserter }, chia::Signature()), state);
+    };
+    EXPECT_FALSE(validate(make_asserter(announcement_id, 100), state).has_value());
+
+    auto failure = validate(make_asserter(announcer_id, 100), state);
+    ASSERT_TRUE(failure.has_value());
+    EXPECT_EQ(failure->code, Code::ASSERT_ANNOUNCE_CONSUMED_FAILED);
+    EXPECT_EQ(failure->spend_index, 1);
+    EXPECT_EQ(failure->opcode, ConditionOpcode::ASSERT_COIN_ANNOUNCEMENT[0]);
+    EXPECT_EQ(failure->condition_index, 0);
+
+    EXPECT_EQ(validate(make_asserter(announcement_id, 101), state)->code, Code::ASSERT_SECONDS_RELATIVE_FAILED);
+    chia::ChainState early_state = state;
+    early_state.prev_transaction_block_height = 9;
+    failure = validate(make_asserter(announcement_id, 100), early_state);
+    ASSERT_TRUE(failure.has_value());
+    EXPECT_EQ(failure->code, Code::ASSERT_HEIGHT_ABSOLUTE_FAILED);
+    EXPECT_EQ(failure->spend_index, 0);
+    chia::ChainState unknown_state = state;
+    unknown_state.get_coin_confirmation = nullptr;
+    EXPECT_EQ(validate(make_asserter(announcement_id, 100), unknown_state)->code, Code::UNKNOWN_UNSPENT);
+
+    // The coins are confirmed at 5, a relative height is counted up to the previous transaction block
+    auto validate_height_relative = [&](long blocks, chia::ChainState const& state) {
+        auto spend = MakeConditionSpend(3, 100,
+            chia::ToSExpList(chia::ToSExpList(op(ConditionOpcode::ASSERT_HEIGHT_RELATIVE), chia::Int(blocks))));
+        return chia::ValidateBundleConditions(chia::SpendBundle({ spend }, chia::Signature()), state);
+    };
+    EXPECT_FALSE(validate_height_relative(5, state).has_value());
+    EXPECT_EQ(validate_height_relative(6, state)->code, Code::ASSERT_HEIGHT_RELATIVE_FAILED);
+    EXPECT_EQ(validate_height_relative(5, early_state)->code, Code::ASSERT_HEIGHT_RELATIVE_FAILED);
+    // A relative timelock of 0 passes without a confirmation
+    EXPECT_FALSE(validate_height_relative(0, unknown_state).has_value());
+}
+
+TEST(Conditions, HighBitValues)
+{
+    using chia::ConditionOpcode;
+    using Code = chia::ConditionFailure::Code;
+
+    // 200 is c8, the atom of `Int` keeps it positive with a leading zero
+    chia::ChainState state;
+    state.prev_transaction_block_height = 200;
+    state.timestamp = 200;
+    state.get_coin_confirmation = [](chia::Bytes32 const&) { return chia::CoinConfirmation { 0, 0 }; };
+    auto validate = [](uint8_t(&opcode)[1], uint64_t amount, chia::ChainState const& state) {
+        auto spend = MakeConditionSpend(4, amount,
+            chia::ToSExpList(chia::ToSExpList(ConditionOpcode::ToBytes(opcode), chia::Int(200))));
+        return chia::ValidateBundleConditions(chia::SpendBundle({ spend }, chia::Signature()), state);
+    };
+    EXPECT_FALSE(validate(ConditionOpcode::ASSERT_MY_AMOUNT, 200, state).has_value());
+    EXPECT_EQ(validate(ConditionOpcode::ASSERT_MY_AMOUNT, 201, state)->code, Code::ASSERT_MY_AMOUNT_FAILED);
+
+    chia::ChainState early_state = state;
+    early_state.prev_transaction_block_height = 199;
+    early_state.timestamp = 199;
+    std::pair<uint8_t(&)[1], Code> timelocks[] = {
+        { ConditionOpcode::ASSERT_HEIGHT_ABSOLUTE, Code::ASSERT_HEIGHT_ABSOLUTE_FAILED },
+        { ConditionOpcode::ASSERT_SECONDS_ABSOLUTE, Code::ASSERT_SECONDS_ABSOLUTE_FAILED },
+        { ConditionOpcode::ASSERT_HEIGHT_RELATIVE, Code::ASSERT_HEIGHT_RELATIVE_FAILED },
+        { ConditionOpcode::ASSERT_SECONDS_RELATIVE, Code::ASSERT_SECONDS_RELATIVE_FAILED },
+    };
+    for (auto& [opcode, code] : timelocks) {
+        EXPECT_FALSE(validate(opcode, 1000, state).has_value());
+        EXPECT_EQ(validate(opcode, 1000, early_state)->code, code);
+    }
+}
+
+TEST(SpendBundle, NameAndEphemeral)
+{
+    // The second spend spends the coin created by the first one
+    chia::CoinSpend spend_a = MakeConditionSpend(1, 1000, MakeCreateCoin(0x22, 500));
+    chia::Coin coin_a = spend_a.coin;
+    chia::Coin coin_b(coin_a.GetName(), MakeHash(0x22), 500);
+    chia::Signature signature;
+    signature.fill(0xcc);
+    chia::CoinSpend spend_b(coin_b, MakeConditionPuzzle(MakeCreateCoin(0x33, 400)), chia::Program(chia::MakeNull()));
+    chia::SpendBundle bundle({ spend_a, spend_b }, signature);
+
+    ASSERT_EQ(bundle.Additions().size(), 2);
+    auto additions = bundle.NotEphemeralAdditions();
+    ASSERT_EQ(additions.size(), 1);
+    EXPECT_EQ(additions[0].GetAmount(), 400);
+    EXPECT_EQ(additions[0].GetParentCoinInfo(), coin_b.GetName());
+    auto removals = bundle.NotEphemeralRemovals();
+    ASSERT_EQ(removals.size(), 1);
+    EXPECT_EQ(removals[0].GetName(), coin_a.GetName());
+    EXPECT_EQ(bundle.Fees(), 1000 + 500 - 500 - 400);
+
+    // The streamable bytes: the number of spends, each coin, puzzle and solution, then the signature
+    chia::Bytes streamable { 0, 0, 0, 2 };
+    for (auto const& coin_spend : bundle.CoinSolutions()) {
+        streamable = chia::utils::ConnectBuffers(streamable,
+            chia::utils::HashToBytes(coin_spend.coin.GetParentCoinInfo()),
+            chia::utils::HashToBytes(coin_spend.coin.GetPuzzleHash()),
+            chia::utils::IntToBEBytes(coin_spend.coin.GetAmount()), coin_spend.puzzle_reveal->Serialize(),
+            coin_spend.solution->Serialize());
+    }
+    streamable = chia::utils::ConnectBuffers(streamable, chia::Bytes(std::begin(signature), std::end(signature)));
+    EXPECT_EQ(bundle.Name(), chia::crypto_utils::MakeSHA256(streamable));
+    chia::SpendBundle copy = bundle;
+    EXPECT_EQ(copy.Name(), bundle.Name());
+    chia::SpendBundle moved = std::move(copy);
+    EXPECT_EQ(moved.Name(), bundle.Name());
+    EXPECT_EQ(copy.Name(), chia::crypto_utils::MakeSHA256(copy.Serialize()));
+}
+
+TEST(SpendBundle, StreamAndFromBytes)
+{
+    chia::Program puzzle = MakeConditionPuzzle(MakeCreateCoin(0x22, 500));
+    // An atom larger than the chunk of the stream writer and a list which spans many chunks
+    chia::Bytes memo(10000, 0x5a);
+    chia::CLVMObjectPtr items = chia::ToSExp(chia::MakeNull());
+    for (int i = 0; i < 2000; ++i) {
+        items = chia::ToSExpPair(chia::ToSExp(chia::Int(i)), items);
+    }
+    chia::Program solution(chia::ToSExpPair(chia::ToSExp(memo), items));
+    chia::Coin coin_a(MakeHash(1), puzzle.GetTreeHash(), 1000);
+    chia::Coin coin_b(coin_a.GetName(), puzzle.GetTreeHash(), 0xfedcba9876543210);
+    chia::Signature signature;
+    signature.fill(0xcc);
+    chia::SpendBundle bundle(
+        { chia::CoinSpend(coin_a, puzzle, solution), chia::CoinSpend(coin_b, puzzle, chia::Program(chia::MakeNull())) },
+        signature);
+
+    chia::Bytes coin_bytes = coin_b.Serialize();
+    ASSERT_EQ(coin_bytes.size(), 72);
+    EXPECT_EQ(chia::Bytes(std::begin(coin_bytes) + 64, std::end(coin_bytes)),
+        chia::utils::BytesFromHex("fedcba9876543210"));
+    EXPECT_EQ(chia::Coin::FromBytes(coin_bytes.data(), coin_bytes.size()).GetName(), coin_b.GetName());
+
+    chia::Bytes bytes = bundle.Serialize();
+    chia::Bytes expected { 0, 0, 0, 2 };
+    for (auto const& coin_spend : bundle.CoinSolutions()) {
+        expected = chia::utils::ConnectBuffers(expected, coin_spend.coin.Serialize(),
+            coin_spend.puzzle_reveal->Serialize(), coin_spend.solution->Serialize());
+    }
+    expected = chia::utils::ConnectBuffers(expected, chia::Bytes(std::begin(signature), std::end(signature)));
+    ASSERT_EQ(bytes, expected);
+    EXPECT_EQ(bundle.Name(), chia::crypto_utils::MakeSHA256(bytes));
+
+    // The bundle is read from the front of the buffer and the bytes after it are left
+    chia::Bytes buffer = chia::utils::ConnectBuffers(bytes, chia::Bytes { 1, 2, 3 });
+    std::size_t consumed { 0 };
+    auto parsed = chia::SpendBundle::FromBytes(buffer.data(), buffer.size(), &consumed);
+    EXPECT_EQ(consumed, bytes.size());
+    ASSERT_EQ(parsed.CoinSolutions().size(), 2);
+    EXPECT_EQ(parsed.CoinSolutions()[0].coin.GetName(), coin_a.GetName());
+    EXPECT_EQ(parsed.CoinSolutions()[1].coin.GetAmount(), 0xfedcba9876543210);
+    EXPECT_EQ(parsed.CoinSolutions()[0].solution->GetTreeHash(), solution.GetTreeHash());
+    EXPECT_EQ(parsed.GetAggregatedSignature(), signature);
+    EXPECT_EQ(parsed.Name(), bundle.Name());
+    EXPECT_EQ(parsed.Serialize(), bytes);
+
+    for (std::size_t size : { std::size_t(0), std::size_t(3), std::size_t(80), bytes.size() - 1 }) {
+        EXPECT_THROW(chia::SpendBundle::FromBytes(bytes.data(), size), std::runtime_error);
+    }
+    // A count which is larger than the buffer is stopped at the end of the buffer
+    chia::Bytes huge_count { 0xff, 0xff, 0xff, 0xff };
+    EXPECT_THROW(chia::SpendBundle::FromBytes(huge_count.data(), huge_count.size()), std::runtime_error);
+}
@@ -16,9 +16,9 @@ TEST(CoinSpend, encode_and_decode)
     char const* SZ_PUBLIC_KEY = "82077bcb6cfa4f1def38538284bf37a37f2f6fa44b3aca2d4885e97fd9eec58c53e851a3784057f0cf1a6de7ad03eb6e";
 
     chia::PublicKey public_key = chia::utils::bytes_cast<chia::wallet::Key::PUB_KEY_LEN>(chia::utils::BytesFromHex(SZ_PUBLIC_KEY));
-    auto puzzle_hash = chia::utils::HashToBytes(chia::puzzle::puzzle_for_public_key(public_key).GetTreeHash());
+    auto puzzle_hash = chia::puzzle::puzzle_for_public_key(public_key).GetTreeHash();
 
-    std::string address = chia::bech32::EncodePuzzleHash(chia::utils::BytesToInts(puzzle_hash), "txch");
+    std::string address = chia::bech32::EncodePuzzleHash(puzzle_hash, "txch");
     EXPECT_EQ(SZ_ADDRESS, address);
 
     // chia::Payment pay1;
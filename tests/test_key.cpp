@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <iostream>
 
 #include <gtest/gtest.h>
@@ -5,6 +6,7 @@
 #include "clvm/bech32.h"
 #include "clvm/key.h"
 #include "clvm/puzzle.h"
+#include "clvm/scalar.h"
 #include "clvm/utils.h"
 
 char const* SZ_PUBLIC_KEY = "aea444ca6508d64855735a89491679daec4303e104d62b83d0e4d4c5280edd2b2480740031f68b374e4cd5d4aa6544e7";
@@ -14,15 +16,39 @@ chia::Bytes PUZZLE_HASH_BYTES = { 0x2e, 0xd4, 0x62, 0xe1, 0xa9, 0xc9, 0x1a, 0x8f
 
 TEST(Key, EncodePuzzleHash)
 {
-    std::string address = chia::bech32::EncodePuzzleHash(chia::utils::BytesToInts(PUZZLE_HASH_BYTES), "xch");
+    std::string address = chia::bech32::EncodePuzzleHash(chia::utils::bytes_cast<32>(PUZZLE_HASH_BYTES), "xch");
     EXPECT_EQ(address, SZ_ADDRESS);
 }
 
 TEST(Key, DecodePuzzleHash)
 {
-    auto puzzle_hash_ints = chia::bech32::DecodePuzzleHash(SZ_ADDRESS);
+    auto puzzle_hash = chia::bech32::DecodePuzzleHash(SZ_ADDRESS);
 
-    EXPECT_EQ(chia::utils::IntsToBytes(puzzle_hash_ints), PUZZLE_HASH_BYTES);
+    EXPECT_EQ(chia::utils::HashToBytes(puzzle_hash), PUZZLE_HASH_BYTES);
+
+    // wrong checksum, mixed case and the legacy bech32 checksum are rejected
+    std::string address(SZ_ADDRESS);
+    address.back() = address.back() == 'q' ? 'p' : 'q';
+    EXPECT_THROW(chia::bech32::DecodePuzzleHash(address), std::runtime_error);
+    EXPECT_THROW(chia::bech32::DecodePuzzleHash("Xch19m2x9cdfeydgl4ua5ur48tvsd32mw779etfcyxjn0qwqnem22nwshhqjw5"), std::runtime_error);
+    auto data = chia::bech32::ConvertBits(PUZZLE_HASH_BYTES, 8, 5);
+    EXPECT_THROW(chia::bech32::DecodePuzzleHash(chia::bech32::Encode("xch", data, chia::bech32::Encoding::BECH32)), std::runtime_error);
+    EXPECT_EQ(chia::bech32::DecodePuzzleHash(chia::utils::ToUpper(SZ_ADDRESS)), puzzle_hash);
+}
+
+TEST(Key, EncodeDecodeMany)
+{
+    std::vector<chia::Bytes32> puzzle_hashes;
+    for (int i = 0; i < 1000; ++i) {
+        chia::Bytes32 puzzle_hash;
+        puzzle_hash.fill(static_cast<uint8_t>(i));
+        puzzle_hash[0] = static_cast<uint8_t>(i >> 8);
+        puzzle_hashes.push_back(puzzle_hash);
+    }
+    auto addresses = chia::bech32::EncodeMany(puzzle_hashes, "txch");
+    ASSERT_EQ(addresses.size(), puzzle_hashes.size());
+    EXPECT_EQ(addresses[7], chia::bech32::EncodePuzzleHash(puzzle_hashes[7], "txch"));
+    EXPECT_EQ(chia::bech32::DecodeMany(addresses), puzzle_hashes);
 }
 
 TEST(Key, PublicKeyToPuzzleHash)
@@ -33,3 +59,63 @@ TEST(Key, PublicKeyToPuzzleHash)
     auto puzzle_hash_bytes = chia::utils::HashToBytes(chia::puzzle::public_key_to_puzzle_hash(public_key));
     EXPECT_EQ(puzzle_hash_bytes, PUZZLE_HASH_BYTES);
 }
+
+TEST(Key, CachedKey)
+{
+    chia::Bytes32 seed;
+    seed.fill(1);
+    chia::wallet::Key key(chia::utils::bytes_cast<32>(seed));
+    chia::wallet::CachedKey cached_key(key);
+
+    EXPECT_EQ(cached_key.GetPrivateKey(), key.GetPrivateKey());
+    EXPECT_EQ(cached_key.GetPublicKey(), key.GetPublicKey());
+
+    auto msg = chia::utils::MakeBytes("msg");
+    auto signature = cached_key.Sign(msg);
+    EXPECT_EQ(signature, key.Sign(msg));
+    EXPECT_TRUE(chia::wallet::CachedKey::VerifySignature(cached_key.GetPublicKeyHandle(), msg, signature));
+
+    chia::wallet::PublicKeyHandle handle(key.GetPublicKey());
+    EXPECT_EQ(handle.GetPublicKey(), key.GetPublicKey());
+    EXPECT_TRUE(chia::wallet::CachedKey::AggregateVerifySignature({ handle }, { msg }, signature));
+    EXPECT_FALSE(chia::wallet::CachedKey::VerifySignature(handle, chia::utils::MakeBytes("other"), signature));
+}
+
+TEST(Key, Scalar)
+{
+    chia::Bytes32 max;
+    max.fill(0xff);
+    // 2^256 - 1 mod r
+    EXPECT_EQ(chia::Scalar::FromBytes(max).ToBytes(),
+        chia::utils::bytes_cast<32>(
+            chia::utils::BytesFromHex("1824b159acc5056f998c4fefecbc4ff55884b7fa0003480200000001fffffffd")));
+    // -1 mod r
+    EXPECT_EQ(chia::Scalar::FromBytes(max, true), -chia::Scalar(1));
+    EXPECT_EQ(chia::Scalar::FromBytes(max, true) + chia::Scalar(1), chia::Scalar());
+
+    // small values are left padded
+    auto bytes = chia::Scalar(0x1234).ToBytes();
+    EXPECT_EQ(bytes[30], 0x12);
+    EXPECT_EQ(bytes[31], 0x34);
+    EXPECT_EQ(std::count(std::begin(bytes), std::end(bytes), 0), 30);
+}
+
+TEST(Key, SyntheticPublicKeys)
+{
+    chia::Bytes32 seed;
+    seed.fill(2);
+    chia::wallet::Key key(chia::utils::bytes_cast<32>(seed));
+    auto hidden_puzzle_hash = chia::puzzle::PredefinedPrograms::GetInstance()[chia::puzzle::PredefinedPrograms::Names::DEFAULT_HIDDEN_PUZZLE].GetTreeHash();
+
+    std::vector<chia::PublicKey> public_keys;
+    for (uint32_t i = 0; i < 8; ++i) {
+        public_keys.push_back(key.GetWalletKey(i).GetPublicKey());
+    }
+    auto synthetic_public_keys = chia::puzzle::calculate_synthetic_public_keys(public_keys, hidden_puzzle_hash);
+    ASSERT_EQ(synthetic_public_keys.size(), public_keys.size());
+    for (uint32_t i = 0; i < 8; ++i) {
+        EXPECT_EQ(synthetic_public_keys[i], chia::puzzle::calculate_synthetic_public_key(public_keys[i], hidden_puzzle_hash));
+        auto synthetic_secret_key = chia::puzzle::calculate_synthetic_secret_key(key.GetWalletKey(i).GetPrivateKey(), hidden_puzzle_hash);
+        EXPECT_EQ(chia::wallet::Key(synthetic_secret_key).GetPublicKey(), synthetic_public_keys[i]);
+    }
+}
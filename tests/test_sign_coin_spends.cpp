@@ -10,6 +10,7 @@ using std::placeholders::_1;
 #include "clvm/utils.h"
 
 #include "clvm/coin.h"
+#include "clvm/pairing_cache.h"
 #include "clvm/puzzle.h"
 
 #define HIDDEN_PUZZLE_HASH (chia::puzzle::PredefinedPrograms::GetInstance()[chia::puzzle::PredefinedPrograms::Names::DEFAULT_HIDDEN_PUZZLE].GetTreeHash())
@@ -138,3 +139,58 @@ TEST_F(SignCoinSpendsTest, TestCoinSpends)
 
     EXPECT_EQ(spend_bundle.GetAggregatedSignature(), signature);
 }
+
+TEST_F(SignCoinSpendsTest, TestSignOptions)
+{
+    auto derive_f_list = std::vector<chia::puzzle::DeriveFunc> { std::bind(&SignCoinSpendsTest::derive_ph, this, _1) };
+
+    chia::puzzle::SignOptions options;
+    auto spend_bundle = chia::puzzle::sign_coin_spends({ spend_h }, std::bind(&SignCoinSpendsTest::pk_to_sk, this, _1),
+        std::bind(&SignCoinSpendsTest::ph_to_sk, this, _1), additional_data, 1000000000, derive_f_list, options);
+
+    options.verify_each_signature = true;
+    options.verify_aggregated_signature = false;
+    options.parallel = false;
+    auto spend_bundle_2 = chia::puzzle::sign_coin_spends({ spend_h },
+        std::bind(&SignCoinSpendsTest::pk_to_sk, this, _1), std::bind(&SignCoinSpendsTest::ph_to_sk, this, _1),
+        additional_data, 1000000000, derive_f_list, options);
+
+    EXPECT_EQ(spend_bundle.GetAggregatedSignature(), spend_bundle_2.GetAggregatedSignature());
+}
+
+TEST_F(SignCoinSpendsTest, TestVerifySpendBundles)
+{
+    auto spend_bundle = chia::puzzle::sign_coin_spends({ spend_h }, std::bind(&SignCoinSpendsTest::pk_to_sk, this, _1),
+        std::bind(&SignCoinSpendsTest::ph_to_sk, this, _1), additional_data, 1000000000,
+        { std::bind(&SignCoinSpendsTest::derive_ph, this, _1) });
+    chia::SpendBundle bad_bundle(spend_bundle.CoinSolutions(), sk1_h.Sign(chia::utils::MakeBytes(msg1)));
+
+    auto results = chia::puzzle::verify_spend_bundles(
+        { spend_bundle, bad_bundle, spend_bundle, spend_bundle }, additional_data, 1000000000);
+    EXPECT_EQ(results, std::vector<bool>({ true, false, true, true }));
+
+    results = chia::puzzle::verify_spend_bundles({ spend_bundle, spend_bundle }, additional_data, 1000000000);
+    EXPECT_EQ(results, std::vector<bool>({ true, true }));
+}
+
+TEST_F(SignCoinSpendsTest, TestPairingCache)
+{
+    auto spend_bundle = chia::puzzle::sign_coin_spends({ spend_h }, std::bind(&SignCoinSpendsTest::pk_to_sk, this, _1),
+        std::bind(&SignCoinSpendsTest::ph_to_sk, this, _1), additional_data, 1000000000,
+        { std::bind(&SignCoinSpendsTest::derive_ph, this, _1) });
+    chia::SpendBundle bad_bundle(spend_bundle.CoinSolutions(), sk1_h.Sign(chia::utils::MakeBytes(msg1)));
+    auto num_pairs = chia::puzzle::pkm_pairs_for_spend_bundle(spend_bundle, additional_data, 1000000000).size();
+
+    chia::wallet::PairingCache cache(num_pairs);
+    EXPECT_TRUE(chia::puzzle::validate_spend_bundle_signature(spend_bundle, additional_data, cache, 1000000000));
+    EXPECT_EQ(cache.GetSize(), num_pairs);
+    // The second time all pairings are taken from the cache
+    EXPECT_TRUE(chia::puzzle::validate_spend_bundle_signature(spend_bundle, additional_data, cache, 1000000000));
+    EXPECT_FALSE(chia::puzzle::validate_spend_bundle_signature(bad_bundle, additional_data, cache, 1000000000));
+    EXPECT_EQ(cache.GetSize(), num_pairs);
+
+    cache.Clear();
+    EXPECT_EQ(cache.GetSize(), 0);
+    EXPECT_FALSE(chia::wallet::PairingCache(0).AggregateVerify({ pk1_h }, { chia::utils::MakeBytes(msg1) },
+        sk2_h.Sign(chia::utils::MakeBytes(msg1))));
+}